@@ -0,0 +1,434 @@
+//
+// Benchmark suite: step throughput and time-to-target of algos::PSO on the standard
+// landscapes, written as JSON so runs from different commits can be compared.
+//
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "pso.h"
+#include "objectives.h"
+
+// Format version of the JSON report, bump when fields change meaning.
+static constexpr int REPORT_VERSION = 1;
+
+struct Case {
+    const char* objective;
+    int particles;
+    int dimensions;
+    int threads;
+    int iterations;
+};
+
+struct CaseResult {
+    int iterations = 0;
+    // Per repeat seconds spent in step(), the median is what gets compared.
+    double median_seconds = 0;
+    double min_seconds = 0;
+    double best_fitness = 0;
+    // First iteration whose global best reached the target, -1 if none did.
+    int target_iteration = -1;
+    double target_seconds = -1;
+};
+
+struct Settings {
+    std::uint64_t seed = 0;
+    int repeats = 3;
+    // Iterations per case are evaluation_budget / particles, clamped to [min_iterations, max_iterations].
+    double evaluation_budget = 2e6;
+    int min_iterations = 5;
+    int max_iterations = 1000;
+    // Cases whose swarm holds more coordinates than this are skipped.
+    double max_coordinates = 1e7;
+    double target = 1e-3;
+};
+
+/*
+ * Runs one case repeats times from the same seed. Only step() is timed, construction
+ * and the initial evaluation are not. Every repeat takes the same path, so the target
+ * is taken from the first.
+ */
+template<typename Objective>
+static CaseResult run_case(const Case& c, const Settings& settings, int bound) {
+    algos::pso::PSOConfig config;
+    config.n_particles = c.particles;
+    config.dimensions = c.dimensions;
+    config.n_threads = c.threads;
+    config.max_iterations = c.iterations;
+    config.seed = settings.seed;
+    config.min_x = config.min_y = -bound;
+    config.max_x = config.max_y = bound;
+
+    CaseResult result;
+    result.iterations = c.iterations;
+    std::vector<double> seconds;
+    for (int repeat = 0; repeat < settings.repeats; repeat++) {
+        algos::BasicPSO<Objective> pso(Objective(), config);
+        bool reached = pso.get_config().global_best_fitness <= settings.target;
+        if (repeat == 0 && reached) {
+            result.target_iteration = 0;
+            result.target_seconds = 0;
+        }
+        auto start = std::chrono::steady_clock::now();
+        while (pso.get_iteration() < c.iterations) {
+            pso.step();
+            if (repeat == 0 && !reached && pso.get_config().global_best_fitness <= settings.target) {
+                reached = true;
+                result.target_iteration = pso.get_iteration();
+                result.target_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            }
+        }
+        seconds.push_back(std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+        result.best_fitness = pso.get_config().global_best_fitness;
+    }
+    std::sort(seconds.begin(), seconds.end());
+    result.min_seconds = seconds.front();
+    result.median_seconds = seconds[seconds.size() / 2];
+    return result;
+}
+
+struct Landscape {
+    const char* name;
+    // Every dimension searches [-bound, bound].
+    int bound;
+    CaseResult (*run)(const Case&, const Settings&, int);
+};
+
+static const Landscape LANDSCAPES[] = {
+        {"sphere", 100, &run_case<algos::objectives::Sphere>},
+        {"rastrigin", 5, &run_case<algos::objectives::Rastrigin>},
+        {"rosenbrock", 5, &run_case<algos::objectives::Rosenbrock>},
+        {"ackley", 32, &run_case<algos::objectives::Ackley>},
+        {"griewank", 600, &run_case<algos::objectives::Griewank>},
+};
+
+static const Landscape* find_landscape(const std::string& name) {
+    for (const Landscape& landscape : LANDSCAPES) {
+        if (name == landscape.name) {
+            return &landscape;
+        }
+    }
+    return nullptr;
+}
+
+static std::string case_name(const Case& c) {
+    return std::string(c.objective) + "/n" + std::to_string(c.particles) + "/d" + std::to_string(c.dimensions) + "/t" +
+           std::to_string(c.threads);
+}
+
+static const char* update_kernel() {
+#if defined(PSO_SCALAR_KERNEL)
+    return "scalar";
+#elif defined(__AVX2__)
+    return "avx2";
+#elif defined(__SSE2__) || defined(_M_X64)
+    return "sse2";
+#else
+    return "scalar";
+#endif
+}
+
+static std::string compiler() {
+#if defined(__clang__)
+    return "clang " __clang_version__;
+#elif defined(__GNUC__)
+    return "gcc " __VERSION__;
+#elif defined(_MSC_VER)
+    return "msvc " + std::to_string(_MSC_VER);
+#else
+    return "unknown";
+#endif
+}
+
+// JSON string escaping for the few strings the report holds.
+static std::string quoted(const std::string& text) {
+    std::string out = "\"";
+    for (char ch : text) {
+        if (ch == '"' || ch == '\\') {
+            out += '\\';
+            out += ch;
+        } else if ((unsigned char) ch < 0x20) {
+            char escaped[8];
+            snprintf(escaped, sizeof(escaped), "\\u%04x", ch);
+            out += escaped;
+        } else {
+            out += ch;
+        }
+    }
+    return out + "\"";
+}
+
+static std::string number(double value) {
+    char text[32];
+    snprintf(text, sizeof(text), "%.17g", value);
+    return text;
+}
+
+/*
+ * One result per line, so the report diffs cleanly and read_baseline can pick the
+ * fields back out without a JSON parser.
+ */
+static std::string result_json(const Case& c, const CaseResult& r) {
+    double evaluations = (double) r.iterations * c.particles;
+    std::string out = "{\"name\":" + quoted(case_name(c));
+    out += ",\"objective\":" + quoted(c.objective);
+    out += ",\"particles\":" + std::to_string(c.particles);
+    out += ",\"dimensions\":" + std::to_string(c.dimensions);
+    out += ",\"threads\":" + std::to_string(c.threads);
+    out += ",\"iterations\":" + std::to_string(r.iterations);
+    out += ",\"median_seconds\":" + number(r.median_seconds);
+    out += ",\"min_seconds\":" + number(r.min_seconds);
+    out += ",\"steps_per_sec\":" + number(r.median_seconds > 0 ? r.iterations / r.median_seconds : 0.0);
+    out += ",\"evaluations_per_sec\":" + number(r.median_seconds > 0 ? evaluations / r.median_seconds : 0.0);
+    out += ",\"best_fitness\":" + number(r.best_fitness);
+    if (r.target_iteration >= 0) {
+        out += ",\"target_iteration\":" + std::to_string(r.target_iteration);
+        out += ",\"target_seconds\":" + number(r.target_seconds);
+    } else {
+        out += ",\"target_iteration\":null,\"target_seconds\":null";
+    }
+    return out + "}";
+}
+
+static std::string string_field(const std::string& line, const std::string& key) {
+    std::string pattern = "\"" + key + "\":\"";
+    std::size_t begin = line.find(pattern);
+    if (begin == std::string::npos) {
+        return "";
+    }
+    begin += pattern.size();
+    std::size_t end = line.find('"', begin);
+    return end == std::string::npos ? "" : line.substr(begin, end - begin);
+}
+
+static double number_field(const std::string& line, const std::string& key) {
+    std::string pattern = "\"" + key + "\":";
+    std::size_t begin = line.find(pattern);
+    return begin == std::string::npos ? -1 : std::strtod(line.c_str() + begin + pattern.size(), nullptr);
+}
+
+struct BaselineEntry {
+    std::string name;
+    double evaluations_per_sec;
+};
+
+// Reads the results of an earlier report. Returns false if the file cannot be opened.
+static bool read_baseline(const std::string& filename, std::vector<BaselineEntry>* out) {
+    std::ifstream file(filename);
+    if (!file.is_open()) {
+        return false;
+    }
+    std::string line;
+    while (std::getline(file, line)) {
+        std::string name = string_field(line, "name");
+        double rate = number_field(line, "evaluations_per_sec");
+        if (!name.empty() && rate > 0) {
+            out->push_back({name, rate});
+        }
+    }
+    return true;
+}
+
+static std::vector<int> parse_int_list(const std::string& text) {
+    std::vector<int> values;
+    std::stringstream stream(text);
+    std::string item;
+    while (std::getline(stream, item, ',')) {
+        if (!item.empty()) {
+            values.push_back((int) std::strtod(item.c_str(), nullptr));
+        }
+    }
+    return values;
+}
+
+static std::vector<std::string> parse_list(const std::string& text) {
+    std::vector<std::string> values;
+    std::stringstream stream(text);
+    std::string item;
+    while (std::getline(stream, item, ',')) {
+        if (!item.empty()) {
+            values.push_back(item);
+        }
+    }
+    return values;
+}
+
+static void print_usage(const char* name) {
+    printf("Usage: %s [options]\n", name);
+    printf("  --output <file>         Write the JSON report here instead of stdout\n");
+    printf("  --baseline <file>       Compare against an earlier report, exit 2 on a regression\n");
+    printf("  --tolerance <f>         Allowed evaluations/sec drop against the baseline (default 0.1)\n");
+    printf("  --objectives <a,b,..>   Landscapes: sphere, rastrigin, rosenbrock, ackley, griewank\n");
+    printf("  --particles <n,..>      Swarm sizes (default 10,100,1000,10000,100000,1000000)\n");
+    printf("  --dimensions <n,..>     Dimensions (default 2,10,30)\n");
+    printf("  --threads <n,..>        Thread counts (default 1 and every hardware thread)\n");
+    printf("  --budget <n>            Evaluations per case, sets its iteration count (default 2e6)\n");
+    printf("  --min-iterations <n>    Fewest iterations per case (default 5)\n");
+    printf("  --max-iterations <n>    Most iterations per case (default 1000)\n");
+    printf("  --max-coordinates <n>   Skip cases with more particles * dimensions (default 1e7)\n");
+    printf("  --repeats <n>           Timed runs per case, the median is reported (default 3)\n");
+    printf("  --target <f>            Fitness that counts as reaching the optimum (default 1e-3)\n");
+    printf("  --seed <n>              Seed for the random number generator\n");
+    printf("  --quick                 Small matrix for a smoke test\n");
+}
+
+int main(int argc, char** argv) {
+    Settings settings;
+    std::vector<std::string> objectives;
+    for (const Landscape& landscape : LANDSCAPES) {
+        objectives.push_back(landscape.name);
+    }
+    std::vector<int> particles = {10, 100, 1000, 10000, 100000, 1000000};
+    std::vector<int> dimensions = {2, 10, 30};
+    int hardware_threads = (int) std::max(1u, std::thread::hardware_concurrency());
+    std::vector<int> threads = {1};
+    if (hardware_threads > 1) {
+        threads.push_back(hardware_threads);
+    }
+    std::string output_filename;
+    std::string baseline_filename;
+    double tolerance = 0.1;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        if (arg == "--help" || arg == "-h") {
+            print_usage(argv[0]);
+            return 0;
+        } else if (arg == "--output" && has_value) {
+            output_filename = argv[++i];
+        } else if (arg == "--baseline" && has_value) {
+            baseline_filename = argv[++i];
+        } else if (arg == "--tolerance" && has_value) {
+            tolerance = std::strtod(argv[++i], nullptr);
+        } else if (arg == "--objectives" && has_value) {
+            objectives = parse_list(argv[++i]);
+        } else if (arg == "--particles" && has_value) {
+            particles = parse_int_list(argv[++i]);
+        } else if (arg == "--dimensions" && has_value) {
+            dimensions = parse_int_list(argv[++i]);
+        } else if (arg == "--threads" && has_value) {
+            threads = parse_int_list(argv[++i]);
+        } else if (arg == "--budget" && has_value) {
+            settings.evaluation_budget = std::strtod(argv[++i], nullptr);
+        } else if (arg == "--min-iterations" && has_value) {
+            settings.min_iterations = std::atoi(argv[++i]);
+        } else if (arg == "--max-iterations" && has_value) {
+            settings.max_iterations = std::atoi(argv[++i]);
+        } else if (arg == "--max-coordinates" && has_value) {
+            settings.max_coordinates = std::strtod(argv[++i], nullptr);
+        } else if (arg == "--repeats" && has_value) {
+            settings.repeats = std::atoi(argv[++i]);
+        } else if (arg == "--target" && has_value) {
+            settings.target = std::strtod(argv[++i], nullptr);
+        } else if (arg == "--seed" && has_value) {
+            settings.seed = std::strtoull(argv[++i], nullptr, 10);
+        } else if (arg == "--quick") {
+            particles = {10, 1000, 100000};
+            dimensions = {2, 10};
+            settings.evaluation_budget = 2e5;
+            settings.repeats = 1;
+        } else {
+            printf("Unknown or incomplete option: %s\n", arg.c_str());
+            print_usage(argv[0]);
+            return 1;
+        }
+    }
+
+    for (const std::string& name : objectives) {
+        if (find_landscape(name) == nullptr) {
+            printf("Unknown objective: %s\n", name.c_str());
+            return 1;
+        }
+    }
+    auto positive = [](const std::vector<int>& values) {
+        return !values.empty() && std::all_of(values.begin(), values.end(), [](int v) { return v > 0; });
+    };
+    if (!positive(particles) || !positive(dimensions) || !positive(threads) || settings.repeats <= 0 ||
+        settings.min_iterations <= 0 || settings.max_iterations < settings.min_iterations) {
+        printf("particles, dimensions, threads, repeats and iterations must be positive\n");
+        return 1;
+    }
+
+    std::vector<BaselineEntry> baseline;
+    if (!baseline_filename.empty() && !read_baseline(baseline_filename, &baseline)) {
+        printf("Error opening file\n");
+        return 1;
+    }
+
+    std::vector<std::string> results;
+    int regressions = 0;
+    for (const std::string& name : objectives) {
+        const Landscape* landscape = find_landscape(name);
+        for (int n : particles) {
+            for (int d : dimensions) {
+                if ((double) n * d > settings.max_coordinates) {
+                    fprintf(stderr, "%s/n%d/d%d skipped, more than %.0f coordinates\n", name.c_str(), n, d,
+                            settings.max_coordinates);
+                    continue;
+                }
+                int iterations = (int) std::min<double>(settings.max_iterations,
+                                                        std::max<double>(settings.min_iterations,
+                                                                         settings.evaluation_budget / n));
+                for (int t : threads) {
+                    Case c = {landscape->name, n, d, t, iterations};
+                    CaseResult result = landscape->run(c, settings, landscape->bound);
+                    results.push_back(result_json(c, result));
+
+                    double rate = result.median_seconds > 0 ? (double) iterations * n / result.median_seconds : 0.0;
+                    std::string label = case_name(c);
+                    fprintf(stderr, "%-32s %14.0f evals/s  best %.6g\n", label.c_str(), rate,
+                            result.best_fitness);
+                    for (const BaselineEntry& entry : baseline) {
+                        if (entry.name == label && rate < entry.evaluations_per_sec * (1 - tolerance)) {
+                            fprintf(stderr, "regression %s: %.0f evals/s, baseline %.0f\n", label.c_str(), rate,
+                                    entry.evaluations_per_sec);
+                            regressions++;
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    std::string report = "{\n\"benchmark\":\"pso_bench\",\n\"version\":" + std::to_string(REPORT_VERSION) + ",\n";
+    report += "\"build\":{\"compiler\":" + quoted(compiler()) + ",\"update_kernel\":" + quoted(update_kernel()) +
+#ifdef NDEBUG
+              ",\"optimised\":true},\n";
+#else
+              ",\"optimised\":false},\n";
+#endif
+    report += "\"hardware_threads\":" + std::to_string(hardware_threads) + ",\n";
+    report += "\"settings\":{\"seed\":" + std::to_string(settings.seed) + ",\"repeats\":" +
+              std::to_string(settings.repeats) + ",\"evaluation_budget\":" + number(settings.evaluation_budget) +
+              ",\"target\":" + number(settings.target) + "},\n";
+    report += "\"results\":[\n";
+    for (std::size_t i = 0; i < results.size(); i++) {
+        report += results[i] + (i + 1 < results.size() ? ",\n" : "\n");
+    }
+    report += "]\n}\n";
+
+    if (output_filename.empty()) {
+        fputs(report.c_str(), stdout);
+    } else {
+        std::ofstream file(output_filename);
+        if (!file.is_open()) {
+            printf("Error opening file\n");
+            return 1;
+        }
+        file << report;
+    }
+
+    if (regressions > 0) {
+        fprintf(stderr, "%d case(s) slower than the baseline by more than %.0f%%\n", regressions, 100 * tolerance);
+        return 2;
+    }
+    return 0;
+}
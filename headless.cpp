@@ -0,0 +1,604 @@
+//
+// Headless batch runner: drives algos::PSO as fast as possible without SDL/ImGui.
+//
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#ifdef __linux__
+#include <unistd.h>
+#endif
+
+#include "pso.h"
+#include "async_pso.h"
+#include "islands.h"
+#include "sweep.h"
+#include "objectives.h"
+#include "plugin.h"
+#include "worker_pool.h"
+
+// Resident set size in MB, or -1 where it cannot be read.
+static double resident_set_mb() {
+#ifdef __linux__
+    long pages = 0, resident = 0;
+    FILE* statm = fopen("/proc/self/statm", "r");
+    if (statm == nullptr) {
+        return -1;
+    }
+    int read = fscanf(statm, "%ld %ld", &pages, &resident);
+    fclose(statm);
+    return read == 2 ? resident * (double) sysconf(_SC_PAGESIZE) / (1024.0 * 1024.0) : -1;
+#else
+    return -1;
+#endif
+}
+
+// Time per phase and the counters, when built with PSO_PROFILE.
+static void print_profile() {
+    for (const algos::profile::SiteStats& site : algos::profile::Profiler::instance().report()) {
+        if (site.kind == algos::profile::SITE_COUNTER) {
+            printf("profile %-22s %llu\n", site.name, (unsigned long long) site.count);
+        } else {
+            printf("profile %-22s %llu calls, %f ms total, %f us mean, %f us max\n", site.name,
+                   (unsigned long long) site.count, site.total_ns / 1e6,
+                   site.count > 0 ? site.total_ns / 1e3 / site.count : 0.0, site.max_ns / 1e3);
+        }
+    }
+}
+
+/*
+ * Wraps an objective to stand in for an expensive one: each point takes an extra
+ * mean_microseconds on average, anywhere from none to twice that, fixed by its fitness.
+ */
+template<typename Inner>
+struct DelayedObjective {
+    Inner inner;
+    double mean_microseconds;
+
+    void operator()(algos::Points points, algos::Span<double> fitness, algos::AppConfig* config) const {
+        inner(points, fitness, config);
+        for (std::size_t i = 0; i < fitness.size(); i++) {
+            double scaled = fitness[i] * 4096.0;
+            double fraction = scaled - std::floor(scaled);
+            std::this_thread::sleep_for(std::chrono::duration<double, std::micro>(2.0 * mean_microseconds * fraction));
+        }
+    }
+};
+
+/*
+ * Runs the swarm until max_iterations or a stopping criterion and reports throughput. Engine is BasicPSO or
+ * BasicAsyncPSO; objective_call names how Objective is called, an inlined functor
+ * or the std::function that PSO uses, to compare the two.
+ */
+template<typename Engine, typename Objective>
+static int run(Objective objective, algos::pso::PSOConfig config, const char* objective_call,
+               const std::string& load_filename, const std::string& record_filename, const std::string& save_filename,
+               const std::string& checkpoint_filename, int checkpoint_interval) {
+    Engine pso(std::move(objective), config);
+    if (!load_filename.empty()) {
+        auto load_start = std::chrono::steady_clock::now();
+        pso.load_from_file(load_filename);
+        printf("load_seconds:        %f\n", std::chrono::duration<double>(std::chrono::steady_clock::now() - load_start).count());
+        config = pso.get_pso_config();
+    }
+    int first_iteration = pso.get_iteration();
+    if (!record_filename.empty() && !pso.start_recording(record_filename)) {
+        return 1;
+    }
+    if (!checkpoint_filename.empty()) {
+        pso.start_checkpointing(checkpoint_filename, checkpoint_interval);
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    while (pso.get_stop_reason() == algos::convergence::STOP_NONE) {
+        pso.step();
+    }
+    auto end = std::chrono::steady_clock::now();
+    // The last checkpoint holds the finished run, so resuming from it reproduces the result.
+    if (pso.is_checkpointing()) {
+        pso.checkpoint_now();
+        pso.stop_checkpointing();
+    }
+
+    double seconds = std::chrono::duration<double>(end - start).count();
+    int iterations = pso.get_iteration();
+    double evaluations = (double) (iterations - first_iteration) * config.n_particles;
+    algos::AppConfig result = pso.get_config();
+
+    printf("particles:           %d\n", config.n_particles);
+    printf("dimensions:          %d\n", config.dimensions);
+    printf("threads:             %d\n", config.n_threads);
+    printf("neighbourhood:       %s", algos::neighbourhood::topology_name(config.topology));
+    printf(config.topology == algos::neighbourhood::TOPOLOGY_NEAREST ? " (%d)\n" : "\n", config.neighbours);
+    printf("update:              %s\n", std::is_base_of<algos::BasicAsyncPSO<Objective>, Engine>::value ? "async" : "sync");
+    printf("objective_call:      %s\n", objective_call);
+    printf("seed:                %llu\n", (unsigned long long) config.seed);
+    printf("iterations:          %d\n", iterations);
+    const algos::convergence::Status& convergence = pso.get_convergence_status();
+    printf("stop_reason:         %s\n", algos::convergence::stop_reason_name(pso.get_stop_reason()));
+    printf("evaluations:         %llu\n", (unsigned long long) convergence.evaluations);
+    printf("swarm_diameter:      %.17g (rms radius %.17g)\n", convergence.diameter, convergence.radius);
+    printf("best_fitness:        %.17g\n", result.global_best_fitness);
+    // Long positions are cut short, the full one is in a saved file.
+    const std::vector<double>& best_position = pso.get_pso_config().global_best_position;
+    printf("best_position:      ");
+    for (std::size_t d = 0; d < best_position.size() && d < 8; d++) {
+        printf(" %.17g%s", best_position[d], d + 1 < best_position.size() ? "," : "");
+    }
+    printf("%s\n", best_position.size() > 8 ? " ..." : "");
+    printf("elapsed_seconds:     %f\n", seconds);
+    printf("iterations_per_sec:  %f\n", seconds > 0 ? (iterations - first_iteration) / seconds : 0.0);
+    printf("evaluations_per_sec: %f\n", seconds > 0 ? evaluations / seconds : 0.0);
+    algos::pso::WorkStats work = pso.get_work_stats();
+    printf("core_utilisation:    %f (%d threads busy %f of %f s stepping)\n", work.utilisation(), work.threads,
+           work.busy_seconds, work.wall_seconds);
+    printf("swarm_buffers:       %zu fresh of %zu used\n", pso.get_swarms_allocated(), pso.get_swarms_acquired());
+
+    // History footprint and the cost of random access into it.
+    algos::pso::HistoryStats history = pso.get_history_stats();
+    int stored = pso.get_stored_cycle_count();
+    int seeks = std::min(stored, 64);
+    double seek_total = 0, seek_max = 0;
+    algos::pso::StoredCycle cycle{};
+    for (int i = 0; i < seeks; i++) {
+        int index = (int) ((std::uint64_t) (i + 1) * 2654435761u % stored);
+        auto seek_start = std::chrono::steady_clock::now();
+        pso.get_stored_cycle(index, &cycle);
+        double seek_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - seek_start).count();
+        seek_total += seek_seconds;
+        seek_max = std::max(seek_max, seek_seconds);
+    }
+    printf("history_entries:     %zu (%zu keyframes)\n", history.entries, history.keyframes);
+    printf("history_mb:          %f\n", history.bytes / (1024.0 * 1024.0));
+    printf("spilled_mb:          %f (%zu entries, %zu segments)\n", history.spilled_bytes / (1024.0 * 1024.0),
+           history.spilled_entries, history.segments);
+    printf("full_copy_mb:        %f\n", history.full_copy_bytes / (1024.0 * 1024.0));
+    printf("seek_ms_avg:         %f\n", seeks > 0 ? 1000.0 * seek_total / seeks : 0.0);
+    printf("seek_ms_max:         %f\n", 1000.0 * seek_max);
+    printf("resident_set_mb:     %f\n", resident_set_mb());
+
+    pso.stop_recording();
+    if (!save_filename.empty()) {
+        auto save_start = std::chrono::steady_clock::now();
+        pso.save_to_file(save_filename);
+        printf("save_seconds:        %f\n", std::chrono::duration<double>(std::chrono::steady_clock::now() - save_start).count());
+    }
+    return 0;
+}
+
+// Runs the island model to max_iterations and reports throughput.
+template<typename Objective>
+static int run_islands(Objective objective, const algos::pso::PSOConfig& config,
+                       const algos::islands::IslandConfig& island_config) {
+    algos::BasicIslandPSO<Objective> islands(std::move(objective), config, island_config);
+
+    auto start = std::chrono::steady_clock::now();
+    islands.run();
+    auto end = std::chrono::steady_clock::now();
+
+    double seconds = std::chrono::duration<double>(end - start).count();
+    int iterations = islands.get_iteration();
+    algos::pso::PSOConfig result = islands.get_pso_config();
+    double evaluations = (double) iterations * result.n_particles;
+
+    printf("islands:             %d (%s, every %d iterations, %d migrants)\n", islands.size(),
+           algos::islands::topology_name(island_config.topology), island_config.migration_interval,
+           island_config.n_migrants);
+    printf("particles:           %d\n", result.n_particles);
+    printf("dimensions:          %d\n", config.dimensions);
+    printf("threads:             %d\n", config.n_threads);
+    printf("seed:                %llu\n", (unsigned long long) config.seed);
+    printf("iterations:          %d\n", iterations);
+    printf("best_fitness:        %.17g\n", result.global_best_fitness);
+    printf("best_island:         %d\n", islands.best_island());
+    printf("elapsed_seconds:     %f\n", seconds);
+    printf("iterations_per_sec:  %f\n", seconds > 0 ? iterations / seconds : 0.0);
+    printf("evaluations_per_sec: %f\n", seconds > 0 ? evaluations / seconds : 0.0);
+    printf("resident_set_mb:     %f\n", resident_set_mb());
+    return 0;
+}
+
+/*
+ * Parses name=v1,v2,... (grid values) or name=min:max (random search range).
+ * Returns false on an unknown field or a malformed value list.
+ */
+static bool parse_sweep_parameter(const std::string& text, algos::sweep::Parameter* out) {
+    std::size_t equals = text.find('=');
+    if (equals == std::string::npos || algos::sweep::find_field(text.substr(0, equals)) == nullptr) {
+        return false;
+    }
+    out->name = text.substr(0, equals);
+    std::string values = text.substr(equals + 1);
+    std::size_t colon = values.find(':');
+    if (colon != std::string::npos) {
+        return algos::cycles_csv::parse_number(std::string_view(values).substr(0, colon), &out->min) &&
+               algos::cycles_csv::parse_number(std::string_view(values).substr(colon + 1), &out->max);
+    }
+    std::size_t begin = 0;
+    while (begin <= values.size()) {
+        std::size_t end = std::min(values.find(',', begin), values.size());
+        double value;
+        if (!algos::cycles_csv::parse_number(std::string_view(values).substr(begin, end - begin), &value)) {
+            return false;
+        }
+        out->values.push_back(value);
+        begin = end + 1;
+    }
+    return true;
+}
+
+// Runs a sweep around config and prints or writes its summary table.
+template<typename Objective>
+static int run_sweep(Objective objective, const algos::pso::PSOConfig& config, algos::sweep::SweepSpec spec,
+                     const std::string& output_filename) {
+    for (const algos::sweep::Parameter& parameter : spec.parameters) {
+        if (spec.random_samples > 0 ? parameter.max < parameter.min : parameter.values.empty()) {
+            printf("%s needs %s\n", parameter.name.c_str(),
+                   spec.random_samples > 0 ? "a min:max range for --sweep-samples" : "grid values without --sweep-samples");
+            return 1;
+        }
+    }
+    spec.n_threads = config.n_threads;
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<algos::sweep::Summary> summaries = algos::sweep::run(objective, config, spec);
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::string table = algos::sweep::format_table(spec, summaries);
+
+    if (output_filename.empty()) {
+        fputs(table.c_str(), stdout);
+    } else {
+        FILE* file = fopen(output_filename.c_str(), "w");
+        if (file == nullptr) {
+            printf("Error opening file\n");
+            return 1;
+        }
+        bool ok = fwrite(table.data(), 1, table.size(), file) == table.size();
+        if (fclose(file) != 0 || !ok) {
+            printf("Error writing file\n");
+            return 1;
+        }
+    }
+    printf("configurations:      %zu x %d seeds\n", summaries.size(), std::max(1, spec.n_seeds));
+    double evaluations = 0;
+    for (const algos::sweep::Summary& summary : summaries) {
+        evaluations += summary.mean_evaluations * summary.runs;
+    }
+    printf("evaluations:         %.0f\n", evaluations);
+    printf("elapsed_seconds:     %f\n", seconds);
+    printf("resident_set_mb:     %f\n", resident_set_mb());
+    return 0;
+}
+
+static void print_worker_stats(algos::workers::WorkerPool& pool) {
+    algos::workers::WorkerStats stats = pool.get_stats();
+    printf("worker_requests:     %llu\n", (unsigned long long) stats.requests);
+    printf("worker_restarts:     %llu (%llu timed out), %llu requests sent again, %llu points failed\n",
+           (unsigned long long) stats.restarts, (unsigned long long) stats.timeouts,
+           (unsigned long long) stats.retries, (unsigned long long) stats.failed_points);
+}
+
+static void print_usage(const char* name) {
+    printf("Usage: %s [options]\n", name);
+    printf("  --config <file>      Read the config header of a cycles.csv file\n");
+    printf("  --particles <n>      Number of particles\n");
+    printf("  --dimensions <n>     Search space dimensions\n");
+    printf("  --iterations <n>     Maximum iterations\n");
+    printf("  --cognitive <f>      Cognitive factor\n");
+    printf("  --social <f>         Social factor\n");
+    printf("  --inertia <f>        Inertia weight\n");
+    printf("  --goal <x> <y>       Goal position for the euclidean objective\n");
+    printf("  --threads <n>        Threads used to step the swarm\n");
+    printf("  --seed <n>           Seed for the random number generator\n");
+    printf("  --history-budget-mb <n>  RAM for the history before it spills to disk (0 = unlimited)\n");
+    printf("  --spill-dir <dir>    Directory for spilled history segments\n");
+    printf("  --islands <n>        Run n swarms of --particles each, migrating between them\n");
+    printf("  --migration-interval <n>  Iterations between migrations\n");
+    printf("  --migrants <n>       Best particles each island sends per migration\n");
+    printf("  --topology <ring|full>    Where migrants go\n");
+    printf("  --neighbourhood <global|ring|von-neumann|nearest>  Whose best each particle follows\n");
+    printf("  --neighbours <n>     Neighbourhood size for --neighbourhood nearest\n");
+    printf("  --stop-fitness <f>   Stop once the global best is at or below f\n");
+    printf("  --stop-stagnation <n> [tol]  Stop after n iterations without the global best improving by more than tol\n");
+    printf("  --stop-diameter <f>  Stop once the swarm's bounding box diagonal is at or below f\n");
+    printf("  --stop-evaluations <n>  Stop after n objective evaluations\n");
+    printf("  --stop-seconds <f>   Stop after f seconds of stepping\n");
+    printf("  --sweep <field>=<a,b,..|min:max>  Sweep a config field over values or a range, repeatable\n");
+    printf("  --sweep-samples <n>  Draw n random configurations from the ranges instead of a grid\n");
+    printf("  --sweep-seeds <n>    Seeds each sweep configuration runs with, starting at --seed\n");
+    printf("  --threshold <f>      Fitness a sweep run counts as reaching the goal\n");
+    printf("  --sweep-output <file>     Write the sweep table here instead of stdout\n");
+    printf("  --async              Update each particle as soon as its evaluation finishes, no barrier per iteration\n");
+    printf("  --eval-delay-us <f>  Add a varying delay averaging this many microseconds to each evaluation\n");
+    printf("  --profile            Print time per phase (needs a PSO_PROFILE build)\n");
+    printf("  --trace <file>       Write a Chrome trace-event file of the run (needs a PSO_PROFILE build)\n");
+    printf("  --plugin <file>      Load the objective from a plugin library (see include/pso_plugin.h)\n");
+    printf("  --workers <n>        Evaluate in n worker processes started with --worker-command (see include/pso_worker.h)\n");
+    printf("  --worker-command <cmd>    Worker program and its arguments, e.g. \"./pso_sample_worker --delay-us 100\"\n");
+    printf("  --worker-batch <n>   Most points per worker request (0 = split each batch evenly over the workers)\n");
+    printf("  --worker-timeout <f> Restart a worker that takes more than f seconds over one request\n");
+    printf("  --objective-call <inline|function>  Call the objective as an inlined functor or through std::function\n");
+    printf("  --load <file>        Continue from a saved run (.psoc, .psot or cycles.csv), its config replaces the options\n");
+    printf("  --record <file>      Stream every iteration to a binary trajectory file while running\n");
+    printf("  --save <file>        Save the run when done (.psot for binary, .psoc for a checkpoint, otherwise cycles.csv text)\n");
+    printf("  --checkpoint <file>  Checkpoint the full state in the background while running, resume with --load\n");
+    printf("  --checkpoint-every <n>  Iterations between checkpoints\n");
+}
+
+int main(int argc, char** argv) {
+    algos::pso::PSOConfig config;
+    std::string save_filename;
+    std::string record_filename;
+    std::string load_filename;
+    std::string objective_call = "inline";
+    algos::islands::IslandConfig island_config;
+    island_config.n_islands = 0;
+    algos::sweep::SweepSpec sweep_spec;
+    std::string sweep_output;
+    bool async = false;
+    double eval_delay_us = 0;
+    std::string plugin_filename;
+    algos::workers::WorkerPoolConfig worker_config;
+    worker_config.n_workers = 0;
+    std::string worker_command;
+    bool profile = false;
+    std::string trace_filename;
+    std::string checkpoint_filename;
+    int checkpoint_interval = 100;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        if (arg == "--help" || arg == "-h") {
+            print_usage(argv[0]);
+            return 0;
+        } else if (arg == "--config" && has_value) {
+            std::ifstream file(argv[++i]);
+            if (!file.is_open()) {
+                printf("Error opening file\n");
+                return 1;
+            }
+            algos::pso::read_config(file, &config);
+        } else if (arg == "--particles" && has_value) {
+            config.n_particles = std::atoi(argv[++i]);
+        } else if (arg == "--dimensions" && has_value) {
+            config.dimensions = std::atoi(argv[++i]);
+        } else if (arg == "--iterations" && has_value) {
+            config.max_iterations = std::atoi(argv[++i]);
+        } else if (arg == "--cognitive" && has_value) {
+            config.cognitive_factor = std::strtof(argv[++i], nullptr);
+        } else if (arg == "--social" && has_value) {
+            config.social_factor = std::strtof(argv[++i], nullptr);
+        } else if (arg == "--inertia" && has_value) {
+            config.inertia_weight = std::strtof(argv[++i], nullptr);
+        } else if (arg == "--goal" && i + 2 < argc) {
+            config.goal_x = std::strtod(argv[++i], nullptr);
+            config.goal_y = std::strtod(argv[++i], nullptr);
+        } else if (arg == "--threads" && has_value) {
+            config.n_threads = std::atoi(argv[++i]);
+        } else if (arg == "--seed" && has_value) {
+            config.seed = std::strtoull(argv[++i], nullptr, 10);
+        } else if (arg == "--history-budget-mb" && has_value) {
+            config.history_memory_budget_mb = std::atoi(argv[++i]);
+        } else if (arg == "--spill-dir" && has_value) {
+            config.history_spill_directory = argv[++i];
+        } else if (arg == "--islands" && has_value) {
+            island_config.n_islands = std::atoi(argv[++i]);
+        } else if (arg == "--migration-interval" && has_value) {
+            island_config.migration_interval = std::atoi(argv[++i]);
+        } else if (arg == "--migrants" && has_value) {
+            island_config.n_migrants = std::atoi(argv[++i]);
+        } else if (arg == "--topology" && has_value) {
+            if (!algos::islands::parse_topology(argv[++i], &island_config.topology)) {
+                printf("--topology takes ring or full\n");
+                return 1;
+            }
+        } else if (arg == "--neighbourhood" && has_value) {
+            if (!algos::neighbourhood::parse_topology(argv[++i], &config.topology)) {
+                printf("--neighbourhood takes global, ring, von-neumann or nearest\n");
+                return 1;
+            }
+        } else if (arg == "--neighbours" && has_value) {
+            config.neighbours = std::atoi(argv[++i]);
+        } else if (arg == "--stop-fitness" && has_value) {
+            config.stopping.target_fitness = std::strtod(argv[++i], nullptr);
+        } else if (arg == "--stop-stagnation" && has_value) {
+            config.stopping.stagnation_iterations = std::atoi(argv[++i]);
+            // The tolerance is optional, anything after that is not a number is the next option.
+            char* end = nullptr;
+            if (i + 1 < argc) {
+                double tolerance = std::strtod(argv[i + 1], &end);
+                if (end != argv[i + 1] && *end == '\0') {
+                    config.stopping.stagnation_tolerance = tolerance;
+                    i++;
+                }
+            }
+        } else if (arg == "--stop-diameter" && has_value) {
+            config.stopping.min_diameter = std::strtod(argv[++i], nullptr);
+        } else if (arg == "--stop-evaluations" && has_value) {
+            config.stopping.max_evaluations = std::strtoull(argv[++i], nullptr, 10);
+        } else if (arg == "--stop-seconds" && has_value) {
+            config.stopping.max_seconds = std::strtod(argv[++i], nullptr);
+        } else if (arg == "--sweep" && has_value) {
+            algos::sweep::Parameter parameter;
+            if (!parse_sweep_parameter(argv[++i], &parameter)) {
+                printf("--sweep takes <field>=<a,b,..> or <field>=<min>:<max>, fields:");
+                for (const algos::sweep::Field& field : algos::sweep::FIELDS) {
+                    printf(" %s", field.name);
+                }
+                printf("\n");
+                return 1;
+            }
+            sweep_spec.parameters.push_back(parameter);
+        } else if (arg == "--sweep-samples" && has_value) {
+            sweep_spec.random_samples = std::atoi(argv[++i]);
+        } else if (arg == "--sweep-seeds" && has_value) {
+            sweep_spec.n_seeds = std::atoi(argv[++i]);
+        } else if (arg == "--threshold" && has_value) {
+            sweep_spec.threshold = std::strtod(argv[++i], nullptr);
+        } else if (arg == "--sweep-output" && has_value) {
+            sweep_output = argv[++i];
+        } else if (arg == "--async") {
+            async = true;
+        } else if (arg == "--eval-delay-us" && has_value) {
+            eval_delay_us = std::strtod(argv[++i], nullptr);
+        } else if (arg == "--profile") {
+            profile = true;
+        } else if (arg == "--trace" && has_value) {
+            trace_filename = argv[++i];
+        } else if (arg == "--plugin" && has_value) {
+            plugin_filename = argv[++i];
+        } else if (arg == "--workers" && has_value) {
+            worker_config.n_workers = std::atoi(argv[++i]);
+        } else if (arg == "--worker-command" && has_value) {
+            worker_command = argv[++i];
+        } else if (arg == "--worker-batch" && has_value) {
+            worker_config.batch_size = std::atoi(argv[++i]);
+        } else if (arg == "--worker-timeout" && has_value) {
+            worker_config.timeout_seconds = std::atof(argv[++i]);
+        } else if (arg == "--objective-call" && has_value) {
+            objective_call = argv[++i];
+            if (objective_call != "inline" && objective_call != "function") {
+                printf("--objective-call takes inline or function\n");
+                return 1;
+            }
+        } else if (arg == "--load" && has_value) {
+            load_filename = argv[++i];
+        } else if (arg == "--record" && has_value) {
+            record_filename = argv[++i];
+        } else if (arg == "--save" && has_value) {
+            save_filename = argv[++i];
+        } else if (arg == "--checkpoint" && has_value) {
+            checkpoint_filename = argv[++i];
+        } else if (arg == "--checkpoint-every" && has_value) {
+            checkpoint_interval = std::atoi(argv[++i]);
+        } else {
+            printf("Unknown or incomplete option: %s\n", arg.c_str());
+            print_usage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (config.n_particles <= 0 || config.dimensions <= 0 || config.max_iterations < 0) {
+        printf("n_particles and dimensions must be positive and max_iterations non-negative\n");
+        return 1;
+    }
+
+    if ((profile || !trace_filename.empty()) && !algos::profile::ENABLED) {
+        printf("--profile and --trace need a build with PSO_PROFILE (cmake -DBETTER_PSO_PROFILE=ON)\n");
+        return 1;
+    }
+    algos::profile::Profiler::instance().set_tracing(!trace_filename.empty());
+
+    algos::plugin::PluginObjective plugin_objective;
+    if (!plugin_filename.empty()) {
+        std::string error;
+        if (!algos::plugin::open_objective(plugin_filename, &plugin_objective, &error)) {
+            printf("%s: %s\n", plugin_filename.c_str(), error.c_str());
+            return 1;
+        }
+        printf("objective:           %s\n", plugin_objective.plugin->name().c_str());
+        objective_call = "plugin";
+    }
+
+    algos::workers::WorkerObjective worker_objective;
+    if (worker_config.n_workers > 0) {
+        worker_config.command = algos::workers::split_command(worker_command);
+        if (worker_config.command.empty() || plugin_objective.plugin) {
+            printf("--workers needs a --worker-command and cannot be combined with --plugin\n");
+            return 1;
+        }
+        std::string error;
+        if (!algos::workers::open_objective(worker_config, &worker_objective, &error)) {
+            printf("%s: %s\n", worker_command.c_str(), error.c_str());
+            return 1;
+        }
+        printf("objective:           %d worker processes running %s\n", worker_config.n_workers, worker_command.c_str());
+        objective_call = "workers";
+    }
+
+    if (!sweep_spec.parameters.empty() || sweep_spec.random_samples > 0) {
+        if (island_config.n_islands > 0 || !load_filename.empty() || !record_filename.empty() || !save_filename.empty() ||
+            !checkpoint_filename.empty()) {
+            printf("--islands, --load, --record, --save and --checkpoint cannot be combined with a sweep\n");
+            return 1;
+        }
+        sweep_spec.first_seed = config.seed;
+        if (plugin_objective.plugin) {
+            return run_sweep(plugin_objective, config, sweep_spec, sweep_output);
+        }
+        if (worker_objective.pool) {
+            int status = run_sweep(worker_objective, config, sweep_spec, sweep_output);
+            print_worker_stats(*worker_objective.pool);
+            return status;
+        }
+        if (objective_call == "function") {
+            return run_sweep(algos::BatchFitnessFunction(algos::objectives::euclidean_batch), config, sweep_spec,
+                             sweep_output);
+        }
+        return run_sweep(algos::objectives::Euclidean(), config, sweep_spec, sweep_output);
+    }
+
+    if (island_config.n_islands > 0) {
+        if (!load_filename.empty() || !record_filename.empty() || !save_filename.empty() || !checkpoint_filename.empty()) {
+            printf("--load, --record, --save and --checkpoint work on a single swarm, not with --islands\n");
+            return 1;
+        }
+        if (plugin_objective.plugin) {
+            return run_islands(plugin_objective, config, island_config);
+        }
+        if (worker_objective.pool) {
+            int status = run_islands(worker_objective, config, island_config);
+            print_worker_stats(*worker_objective.pool);
+            return status;
+        }
+        if (objective_call == "function") {
+            return run_islands(algos::BatchFitnessFunction(algos::objectives::euclidean_batch), config, island_config);
+        }
+        return run_islands(algos::objectives::Euclidean(), config, island_config);
+    }
+
+    auto launch = [&](auto objective) {
+        using Objective = decltype(objective);
+        int status = async ? run<algos::BasicAsyncPSO<Objective>>(std::move(objective), config, objective_call.c_str(),
+                                                                  load_filename, record_filename, save_filename,
+                                                                  checkpoint_filename, checkpoint_interval)
+                           : run<algos::BasicPSO<Objective>>(std::move(objective), config, objective_call.c_str(),
+                                                             load_filename, record_filename, save_filename,
+                                                             checkpoint_filename, checkpoint_interval);
+        if (profile) {
+            print_profile();
+        }
+        if (!trace_filename.empty() && !algos::profile::Profiler::instance().write_chrome_trace(trace_filename)) {
+            return 1;
+        }
+        return status;
+    };
+    auto launch_delayed = [&](auto objective) {
+        if (eval_delay_us > 0) {
+            return launch(DelayedObjective<decltype(objective)>{std::move(objective), eval_delay_us});
+        }
+        return launch(std::move(objective));
+    };
+    if (plugin_objective.plugin) {
+        return launch_delayed(plugin_objective);
+    }
+    if (worker_objective.pool) {
+        int status = launch_delayed(worker_objective);
+        print_worker_stats(*worker_objective.pool);
+        return status;
+    }
+    if (objective_call == "function") {
+        return launch_delayed(algos::BatchFitnessFunction(algos::objectives::euclidean_batch));
+    }
+    return launch_delayed(algos::objectives::Euclidean());
+}
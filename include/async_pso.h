@@ -0,0 +1,223 @@
+//
+// Asynchronous PSO: particles move as soon as their own evaluation is done, with no
+// barrier between iterations.
+//
+#ifndef ASYNC_PSO_H
+#define ASYNC_PSO_H
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+#include "pso.h"
+
+namespace algos {
+    /*
+     * BasicPSO with the synchronous step swapped for an asynchronous one. Up to
+     * n_threads particles are in flight at once, one per worker; the others wait in
+     * a queue in the order they finished. A worker takes the particle at the front,
+     * moves it towards the global best as it stands right then, evaluates it, folds
+     * it into the bests and sends it to the back of the queue. A slow evaluation
+     * therefore holds up only its own particle, not the whole swarm.
+     *
+     * One iteration is n_particles updates. Fast particles may be updated more than
+     * once in it and slow ones not at all, so only update counts, not iterations, are
+     * per particle. History, saving and recording work on iterations as before.
+     * With n_threads > 1 the order of updates, and so the run, depends on timing.
+     */
+    template<typename Objective>
+    class BasicAsyncPSO : public BasicPSO<Objective> {
+    private:
+        using Base = BasicPSO<Objective>;
+
+        /*
+         * Particles waiting for their next update, a ring of ready_count from
+         * ready_front, the front one goes next. Every particle is either queued or in
+         * flight, so n_particles slots always suffice.
+         */
+        std::vector<int> ready;
+        std::size_t ready_front = 0;
+        std::size_t ready_count = 0;
+        // Updates each particle has had, its counter for the random coefficients.
+        std::vector<std::uint32_t> updates;
+        // Reused between advances: the config the objective sees and each worker's copy of the global best.
+        pso::PSOConfig objective_config;
+        std::vector<double> worker_best;
+
+        void reset_queue() {
+            int n = this->config.n_particles;
+            ready.resize(n);
+            for (int i = 0; i < n; i++) {
+                ready[i] = i;
+            }
+            ready_front = 0;
+            ready_count = n;
+            updates.assign(n, 0);
+        }
+
+        int pop_ready() {
+            int i = ready[ready_front];
+            ready_front = ready_front + 1 == ready.size() ? 0 : ready_front + 1;
+            ready_count--;
+            return i;
+        }
+
+        void push_ready(int i) {
+            std::size_t back = ready_front + ready_count;
+            ready[back < ready.size() ? back : back - ready.size()] = i;
+            ready_count++;
+        }
+
+    public:
+        BasicAsyncPSO(Objective func, pso::PSOConfig cfg) : Base(std::move(func), cfg) {
+            reset_queue();
+        }
+
+        void step() override {
+            advance(1);
+        }
+
+        /*
+         * Runs iterations * n_particles updates without stopping in between and stores
+         * the result as one iteration, iterations later. Stops at max_iterations, and the
+         * stopping criteria are checked once at the end.
+         */
+        void advance(int iterations) {
+            iterations = std::min(iterations, this->config.max_iterations - this->cycles.top().iterations);
+            if (iterations <= 0 || this->monitor.get_status().reason != convergence::STOP_NONE) {
+                return;
+            }
+            PSO_PROFILE_SCOPE("async.advance");
+            auto start = std::chrono::steady_clock::now();
+            pso::StoredCycle next_cycle = {this->swarm_pool->acquire_copy(this->cycles.top().swarm),
+                                           this->cycles.top().iterations + iterations, this->config.n_particles};
+            pso::Swarm& swarm = next_cycle.swarm;
+            int n = swarm.size();
+            this->apply_migrants(swarm);
+            if ((int) updates.size() != n) {
+                reset_queue();
+            }
+            this->r1.resize(n);
+            this->r2.resize(n);
+            this->fitness.resize(n);
+
+            // The objective gets a copy, workers change the global best in config while others evaluate.
+            objective_config = this->config;
+            int workers = std::max(1, std::min(this->config.n_threads, n));
+            worker_best.resize((std::size_t) workers * swarm.dimensions);
+            pso::UpdateParams params = {this->config.cognitive_factor, this->config.social_factor,
+                                        this->config.inertia_weight, nullptr};
+            std::uint64_t budget = (std::uint64_t) iterations * n;
+            std::uint64_t started = 0;
+            // Guards ready, updates, started and the global best in config.
+            std::mutex mutex;
+            std::condition_variable finished;
+            std::atomic<std::int64_t> busy_nanoseconds{0};
+
+            auto worker = [&](int, int, int chunk) {
+                double* global_best = worker_best.data() + (std::size_t) chunk * swarm.dimensions;
+                std::unique_lock<std::mutex> lock(mutex);
+                while (true) {
+                    // An empty queue with updates left means every particle is in flight, one will come back.
+                    finished.wait(lock, [&] { return started == budget || ready_count > 0; });
+                    if (started == budget) {
+                        return;
+                    }
+                    int i = pop_ready();
+                    if (++started == budget) {
+                        finished.notify_all();
+                    }
+                    std::uint32_t update = updates[i]++;
+                    std::copy_n(this->config.global_best_position.begin(),
+                                std::min<std::size_t>(swarm.dimensions, this->config.global_best_position.size()),
+                                global_best);
+                    lock.unlock();
+
+                    // Particle i is this worker's alone until it is queued again.
+                    auto update_start = std::chrono::steady_clock::now();
+                    {
+                        PSO_PROFILE_SCOPE("async.update");
+                        rng::uniform2(pso::random_counter(i, (int) update, pso::RANDOM_ASYNC_STEP_COEFFICIENTS,
+                                                          this->epoch),
+                                      this->config.seed, &this->r1[i], &this->r2[i]);
+                        pso::UpdateParams particle_params = params;
+                        particle_params.global_best = global_best;
+                        pso::update_positions(particle_params, this->r1.data(), this->r2.data(), swarm, i, i + 1);
+                    }
+                    {
+                        PSO_PROFILE_SCOPE("async.evaluate");
+                        this->evaluate(swarm, i, i + 1, &objective_config);
+                    }
+                    double new_fitness = this->fitness[i];
+                    if (new_fitness < swarm.best_fitness[i]) {
+                        for (int d = 0; d < swarm.dimensions; d++) {
+                            swarm.best_column(d)[i] = swarm.column(d)[i];
+                        }
+                        swarm.best_fitness[i] = new_fitness;
+                    }
+                    busy_nanoseconds.fetch_add(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                            std::chrono::steady_clock::now() - update_start).count(), std::memory_order_relaxed);
+
+                    lock.lock();
+                    if (new_fitness < this->config.global_best_fitness) {
+                        pso::set_global_best(&this->config, swarm, i, false);
+                        this->config.global_best_fitness = new_fitness;
+                    }
+                    push_ready(i);
+                    finished.notify_one();
+                }
+            };
+            this->for_each_chunk(workers, 1, worker);
+
+            // Positions keep changing until the last worker is done, so the spread is measured once here.
+            this->diversity.clear(swarm.dimensions);
+            this->diversity.add(swarm, 0, n);
+            double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            this->work_stats.evaluations += budget;
+            this->work_stats.busy_seconds += busy_nanoseconds.load() * 1e-9;
+            this->work_stats.wall_seconds += seconds;
+            this->work_stats.threads = workers;
+            PSO_PROFILE_COUNT("evaluations", budget);
+            this->monitor.update(next_cycle.iterations, this->config.global_best_fitness, this->diversity, budget, seconds);
+
+            this->cycles.push(std::move(next_cycle));
+            this->record_top();
+            this->checkpoint_if_due(this->cycles.top().iterations - iterations);
+        }
+
+        void reset() override {
+            Base::reset();
+            reset_queue();
+        }
+
+    protected:
+        void capture_update_state(checkpoint::State* state) const override {
+            state->updates = updates;
+            state->ready.resize(ready_count);
+            for (std::size_t k = 0; k < ready_count; k++) {
+                std::size_t slot = ready_front + k;
+                state->ready[k] = ready[slot < ready.size() ? slot : slot - ready.size()];
+            }
+        }
+
+        void restore_update_state(const checkpoint::State* state) override {
+            int n = this->config.n_particles;
+            bool valid = state != nullptr && (int) state->updates.size() == n && (int) state->ready.size() == n &&
+                         std::all_of(state->ready.begin(), state->ready.end(), [n](int i) { return i >= 0 && i < n; });
+            if (!valid) {
+                reset_queue();
+                return;
+            }
+            updates = state->updates;
+            ready.assign(state->ready.begin(), state->ready.end());
+            ready_front = 0;
+            ready_count = n;
+        }
+    };
+
+    using AsyncPSO = BasicAsyncPSO<BatchFitnessFunction>;
+}
+#endif //ASYNC_PSO_H
@@ -0,0 +1,336 @@
+//
+// Exact-state checkpoints: everything a run needs to carry on as if it had never
+// stopped, written in the background while it keeps stepping.
+//
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <mutex>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "swarm.h"
+#include "convergence.h"
+
+namespace algos {
+    namespace checkpoint {
+        /*
+         * Layout, all integers little-endian, sections back to back:
+         *
+         *   FileHeader            64 bytes
+         *   config block          config_size bytes of "key,value" lines (the cycles.csv header)
+         *   global best position  dimensions doubles
+         *   MonitorBlock          the stopping criteria state
+         *   positions             dimensions columns of n_particles doubles
+         *   best positions        dimensions columns of n_particles doubles
+         *   best fitness          n_particles doubles
+         *   update counters       n_updates uint32, then the update queue, n_updates int32
+         *   migrants              n_migrants of fitness then dimensions doubles
+         *
+         * The random numbers are counter based, keyed by the seed in the config block and
+         * counted by iteration, epoch and, for the asynchronous update, the update counters,
+         * so those restore them exactly. Files are written whole under a temporary name and
+         * renamed over the old one, so a checkpoint on disk is never half written.
+         */
+        constexpr char MAGIC[8] = {'P', 'S', 'O', 'C', 'K', 'P', 'T', '\0'};
+        constexpr std::uint32_t VERSION = 1;
+        constexpr std::uint32_t ENDIAN_CHECK = 0x01020304;
+
+        struct FileHeader {
+            char magic[8];
+            std::uint32_t version;
+            std::uint32_t endian_check;
+            std::uint32_t n_particles;
+            std::uint32_t dimensions;
+            std::int32_t iteration;
+            std::uint32_t epoch;
+            std::uint64_t config_size;
+            double global_best_fitness;
+            std::uint32_t n_updates;
+            std::uint32_t n_migrants;
+            std::uint8_t reserved[8];
+        };
+        static_assert(sizeof(FileHeader) == 64, "checkpoint header must stay 64 bytes");
+
+        struct MonitorBlock {
+            std::int32_t reason;
+            std::int32_t iteration;
+            std::int32_t last_improvement;
+            std::uint32_t reserved;
+            double best_fitness;
+            double diameter;
+            double radius;
+            std::uint64_t evaluations;
+            double seconds;
+            double stagnation_best;
+        };
+
+        // Everything in a checkpoint. Reused between checkpoints, so filling one seldom allocates.
+        struct State {
+            std::string config_block;
+            int iteration = 0;
+            std::uint32_t epoch = 0;
+            double global_best_fitness = 0;
+            std::vector<double> global_best_position;
+            pso::Swarm swarm;
+            convergence::Status status;
+            double stagnation_best = 0;
+            // Per particle update counts and the queue order of the asynchronous update, empty otherwise.
+            std::vector<std::uint32_t> updates;
+            std::vector<std::int32_t> ready;
+            // Migrants not yet taken in, fitness then position for each.
+            std::vector<double> migrants;
+        };
+
+        inline bool is_checkpoint_file(const std::string& filename) {
+            FILE* file = fopen(filename.c_str(), "rb");
+            if (file == nullptr) {
+                return false;
+            }
+            char magic[sizeof(MAGIC)] = {};
+            bool match = fread(magic, 1, sizeof(magic), file) == sizeof(magic) && std::memcmp(magic, MAGIC, sizeof(MAGIC)) == 0;
+            fclose(file);
+            return match;
+        }
+
+        inline bool write(const std::string& filename, const State& state) {
+            const pso::Swarm& swarm = state.swarm;
+            std::size_t n = swarm.size();
+            std::size_t dimensions = swarm.dimensions;
+            std::string temporary = filename + ".tmp";
+            FILE* file = fopen(temporary.c_str(), "wb");
+            if (file == nullptr) {
+                printf("Error opening file\n");
+                return false;
+            }
+            setvbuf(file, nullptr, _IOFBF, 1 << 20);
+
+            FileHeader header{};
+            std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+            header.version = VERSION;
+            header.endian_check = ENDIAN_CHECK;
+            header.n_particles = (std::uint32_t) n;
+            header.dimensions = (std::uint32_t) dimensions;
+            header.iteration = state.iteration;
+            header.epoch = state.epoch;
+            header.config_size = state.config_block.size();
+            header.global_best_fitness = state.global_best_fitness;
+            header.n_updates = (std::uint32_t) state.updates.size();
+            header.n_migrants = (std::uint32_t) (state.migrants.size() / (dimensions + 1));
+            MonitorBlock monitor{};
+            monitor.reason = state.status.reason;
+            monitor.iteration = state.status.iteration;
+            monitor.last_improvement = state.status.last_improvement;
+            monitor.best_fitness = state.status.best_fitness;
+            monitor.diameter = state.status.diameter;
+            monitor.radius = state.status.radius;
+            monitor.evaluations = state.status.evaluations;
+            monitor.seconds = state.status.seconds;
+            monitor.stagnation_best = state.stagnation_best;
+            std::vector<double> global_best = state.global_best_position;
+            global_best.resize(dimensions);
+
+            bool ok = fwrite(&header, sizeof(header), 1, file) == 1 &&
+                      fwrite(state.config_block.data(), 1, state.config_block.size(), file) == state.config_block.size() &&
+                      fwrite(global_best.data(), sizeof(double), dimensions, file) == dimensions &&
+                      fwrite(&monitor, sizeof(monitor), 1, file) == 1;
+            for (std::size_t d = 0; d < dimensions && ok; d++) {
+                ok = fwrite(swarm.column((int) d), sizeof(double), n, file) == n;
+            }
+            for (std::size_t d = 0; d < dimensions && ok; d++) {
+                ok = fwrite(swarm.best_column((int) d), sizeof(double), n, file) == n;
+            }
+            ok = ok && fwrite(swarm.best_fitness.data(), sizeof(double), n, file) == n &&
+                 fwrite(state.updates.data(), sizeof(std::uint32_t), state.updates.size(), file) == state.updates.size() &&
+                 fwrite(state.ready.data(), sizeof(std::int32_t), state.ready.size(), file) == state.ready.size() &&
+                 fwrite(state.migrants.data(), sizeof(double), state.migrants.size(), file) == state.migrants.size();
+            if (fclose(file) != 0 || !ok) {
+                printf("Error writing file\n");
+                std::error_code ec;
+                std::filesystem::remove(temporary, ec);
+                return false;
+            }
+            std::error_code ec;
+            std::filesystem::rename(temporary, filename, ec);
+            if (ec) {
+                printf("Error writing file\n");
+                std::filesystem::remove(temporary, ec);
+                return false;
+            }
+            return true;
+        }
+
+        // Takes count items of size bytes from remaining, false if they do not fit.
+        inline bool take(std::uint64_t* remaining, std::uint64_t size, std::uint64_t count) {
+            if (count > 0 && size > *remaining / count) {
+                return false;
+            }
+            *remaining -= size * count;
+            return true;
+        }
+
+        // Whether a file of file_size bytes holds every section header describes, checked before anything is sized from it.
+        inline bool fits(const FileHeader& header, std::uint64_t file_size) {
+            std::uint64_t n = header.n_particles;
+            std::uint64_t dimensions = header.dimensions;
+            std::uint64_t remaining = file_size;
+            return take(&remaining, sizeof(FileHeader), 1) && take(&remaining, 1, header.config_size) &&
+                   take(&remaining, sizeof(double), dimensions) && take(&remaining, sizeof(MonitorBlock), 1) &&
+                   take(&remaining, sizeof(double) * (2 * dimensions + 1), n) &&
+                   take(&remaining, sizeof(std::uint32_t) + sizeof(std::int32_t), header.n_updates) &&
+                   take(&remaining, sizeof(double) * (dimensions + 1), header.n_migrants);
+        }
+
+        inline bool read(const std::string& filename, State* state) {
+            FILE* file = fopen(filename.c_str(), "rb");
+            if (file == nullptr) {
+                printf("Error opening file\n");
+                return false;
+            }
+            std::error_code ec;
+            std::uint64_t file_size = std::filesystem::file_size(filename, ec);
+            FileHeader header{};
+            bool ok = !ec && fread(&header, sizeof(header), 1, file) == 1 &&
+                      std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) == 0 && header.version == VERSION &&
+                      header.endian_check == ENDIAN_CHECK && header.n_particles > 0 &&
+                      header.n_particles <= (std::uint32_t) INT32_MAX && header.dimensions > 0 &&
+                      header.dimensions <= (std::uint32_t) INT32_MAX &&
+                      (header.n_updates == 0 || header.n_updates == header.n_particles) && fits(header, file_size);
+            std::size_t n = header.n_particles;
+            std::size_t dimensions = header.dimensions;
+            MonitorBlock monitor{};
+            if (ok) {
+                state->config_block.resize(header.config_size);
+                state->global_best_position.resize(dimensions);
+                state->swarm.resize((int) n, (int) dimensions);
+                state->updates.resize(header.n_updates);
+                state->ready.resize(header.n_updates);
+                state->migrants.resize(header.n_migrants * (dimensions + 1));
+                ok = fread(&state->config_block[0], 1, header.config_size, file) == header.config_size &&
+                     fread(state->global_best_position.data(), sizeof(double), dimensions, file) == dimensions &&
+                     fread(&monitor, sizeof(monitor), 1, file) == 1;
+            }
+            for (std::size_t d = 0; d < dimensions && ok; d++) {
+                ok = fread(state->swarm.column((int) d), sizeof(double), n, file) == n;
+            }
+            for (std::size_t d = 0; d < dimensions && ok; d++) {
+                ok = fread(state->swarm.best_column((int) d), sizeof(double), n, file) == n;
+            }
+            ok = ok && fread(state->swarm.best_fitness.data(), sizeof(double), n, file) == n &&
+                 fread(state->updates.data(), sizeof(std::uint32_t), state->updates.size(), file) == state->updates.size() &&
+                 fread(state->ready.data(), sizeof(std::int32_t), state->ready.size(), file) == state->ready.size() &&
+                 fread(state->migrants.data(), sizeof(double), state->migrants.size(), file) == state->migrants.size();
+            fclose(file);
+            if (!ok) {
+                printf("Error reading file\n");
+                return false;
+            }
+            state->iteration = header.iteration;
+            state->epoch = header.epoch;
+            state->global_best_fitness = header.global_best_fitness;
+            state->status.reason = (convergence::StopReason) monitor.reason;
+            state->status.iteration = monitor.iteration;
+            state->status.last_improvement = monitor.last_improvement;
+            state->status.best_fitness = monitor.best_fitness;
+            state->status.diameter = monitor.diameter;
+            state->status.radius = monitor.radius;
+            state->status.evaluations = monitor.evaluations;
+            state->status.seconds = monitor.seconds;
+            state->stagnation_best = monitor.stagnation_best;
+            return true;
+        }
+
+        /*
+         * Writes checkpoints on a thread of its own so stepping carries on meanwhile.
+         * Only the latest submitted state is kept: if the disk falls behind, states it
+         * never started on are replaced rather than queued.
+         */
+        class Writer {
+        private:
+            std::string filename;
+            std::mutex mutex;
+            std::condition_variable changed;
+            State pending;
+            bool has_pending = false;
+            bool writing = false;
+            bool stopping = false;
+            int written = 0;
+            int failed = 0;
+            std::thread thread;
+
+            void run() {
+                State state;
+                std::unique_lock<std::mutex> lock(mutex);
+                while (true) {
+                    changed.wait(lock, [this] { return has_pending || stopping; });
+                    if (!has_pending) {
+                        return;
+                    }
+                    std::swap(state, pending);
+                    has_pending = false;
+                    writing = true;
+                    lock.unlock();
+                    bool ok = write(filename, state);
+                    lock.lock();
+                    writing = false;
+                    (ok ? written : failed)++;
+                    changed.notify_all();
+                }
+            }
+
+        public:
+            explicit Writer(std::string file) : filename(std::move(file)), thread([this] { run(); }) {}
+
+            // Writes out anything still pending, then stops.
+            ~Writer() {
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    stopping = true;
+                }
+                changed.notify_all();
+                thread.join();
+            }
+
+            Writer(const Writer&) = delete;
+            Writer& operator=(const Writer&) = delete;
+
+            // Takes state for writing, handing back buffers from an earlier state to fill next time.
+            void submit(State* state) {
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    std::swap(*state, pending);
+                    has_pending = true;
+                }
+                changed.notify_all();
+            }
+
+            // Blocks until every submitted state is on disk, or failed to get there.
+            void wait() {
+                std::unique_lock<std::mutex> lock(mutex);
+                changed.wait(lock, [this] { return !has_pending && !writing; });
+            }
+
+            const std::string& file() const {
+                return filename;
+            }
+
+            int written_count() {
+                std::lock_guard<std::mutex> lock(mutex);
+                return written;
+            }
+
+            int failed_count() {
+                std::lock_guard<std::mutex> lock(mutex);
+                return failed;
+            }
+        };
+    }
+}
+#endif //CHECKPOINT_H
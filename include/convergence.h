@@ -0,0 +1,232 @@
+//
+// Stopping criteria: ends a run once it has converged or used up its budget, rather
+// than always running to max_iterations, and says which rule ended it.
+//
+#ifndef CONVERGENCE_H
+#define CONVERGENCE_H
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+#include "swarm.h"
+
+namespace algos {
+    namespace convergence {
+        enum StopReason {
+            STOP_NONE = 0,
+            STOP_MAX_ITERATIONS = 1,
+            STOP_TARGET_FITNESS = 2,
+            STOP_STAGNATION = 3,
+            STOP_DIAMETER = 4,
+            STOP_EVALUATIONS = 5,
+            STOP_WALL_CLOCK = 6,
+        };
+
+        inline const char* stop_reason_name(StopReason reason) {
+            switch (reason) {
+                case STOP_MAX_ITERATIONS: return "max-iterations";
+                case STOP_TARGET_FITNESS: return "target-fitness";
+                case STOP_STAGNATION: return "stagnation";
+                case STOP_DIAMETER: return "diameter";
+                case STOP_EVALUATIONS: return "evaluations";
+                case STOP_WALL_CLOCK: return "wall-clock";
+                default: return "none";
+            }
+        }
+
+        // Rules besides max_iterations that end a run, each off at its default.
+        struct StoppingCriteria {
+            // Stop once the global best is at or below this.
+            double target_fitness = -std::numeric_limits<double>::infinity();
+            // Stop after this many iterations without the global best improving by more than the tolerance.
+            int stagnation_iterations = 0;
+            double stagnation_tolerance = 0;
+            // Stop once the bounding box of the positions has a diagonal at or below this.
+            double min_diameter = 0;
+            // Stop once this many objective evaluations, the initial ones included, have been made.
+            std::uint64_t max_evaluations = 0;
+            // Stop once this much time has been spent stepping, pauses in between do not count.
+            double max_seconds = 0;
+        };
+
+        /*
+         * Spread of the positions, accumulated range by range as a step finishes with
+         * them, so measuring it needs no pass of its own. Per-chunk accumulators are
+         * merged in chunk order.
+         */
+        struct Diversity {
+            int dimensions = 0;
+            std::size_t count = 0;
+            std::vector<double> min;
+            std::vector<double> max;
+            std::vector<double> sum;
+            std::vector<double> sum_squares;
+
+            void clear(int dims) {
+                dimensions = dims;
+                count = 0;
+                min.assign(dims, std::numeric_limits<double>::infinity());
+                max.assign(dims, -std::numeric_limits<double>::infinity());
+                sum.assign(dims, 0.0);
+                sum_squares.assign(dims, 0.0);
+            }
+
+            void add(const pso::Swarm& swarm, int begin, int end) {
+                for (int d = 0; d < dimensions; d++) {
+                    const double* x = swarm.column(d);
+                    double low = min[d], high = max[d], total = 0, squares = 0;
+                    for (int i = begin; i < end; i++) {
+                        low = std::min(low, x[i]);
+                        high = std::max(high, x[i]);
+                        total += x[i];
+                        squares += x[i] * x[i];
+                    }
+                    min[d] = low;
+                    max[d] = high;
+                    sum[d] += total;
+                    sum_squares[d] += squares;
+                }
+                count += std::max(0, end - begin);
+            }
+
+            void merge(const Diversity& other) {
+                for (int d = 0; d < dimensions && d < other.dimensions; d++) {
+                    min[d] = std::min(min[d], other.min[d]);
+                    max[d] = std::max(max[d], other.max[d]);
+                    sum[d] += other.sum[d];
+                    sum_squares[d] += other.sum_squares[d];
+                }
+                count += other.count;
+            }
+
+            // Diagonal of the bounding box, at least the largest distance between two particles.
+            double diameter() const {
+                if (count == 0) {
+                    return std::numeric_limits<double>::infinity();
+                }
+                double total = 0;
+                for (int d = 0; d < dimensions; d++) {
+                    total += (max[d] - min[d]) * (max[d] - min[d]);
+                }
+                return std::sqrt(total);
+            }
+
+            // Root mean square distance of the particles from their centroid.
+            double radius() const {
+                if (count == 0) {
+                    return 0;
+                }
+                double total = 0;
+                for (int d = 0; d < dimensions; d++) {
+                    double mean = sum[d] / count;
+                    total += std::max(0.0, sum_squares[d] / count - mean * mean);
+                }
+                return std::sqrt(total);
+            }
+        };
+
+        // Where a run stands against its stopping criteria.
+        struct Status {
+            StopReason reason = STOP_NONE;
+            int iteration = 0;
+            // Last iteration the global best improved by more than the stagnation tolerance.
+            int last_improvement = 0;
+            double best_fitness = 0;
+            double diameter = std::numeric_limits<double>::infinity();
+            double radius = 0;
+            std::uint64_t evaluations = 0;
+            double seconds = 0;
+        };
+
+        /*
+         * Checks the criteria after every step. Once a rule fires the run stays stopped,
+         * until resume() or a new start().
+         */
+        class Monitor {
+        private:
+            StoppingCriteria criteria;
+            Status status;
+            // Global best the stagnation window counts from.
+            double stagnation_best = 0;
+
+            void check() {
+                if (status.reason != STOP_NONE) {
+                    return;
+                }
+                if (status.best_fitness <= criteria.target_fitness) {
+                    status.reason = STOP_TARGET_FITNESS;
+                } else if (criteria.min_diameter > 0 && status.diameter <= criteria.min_diameter) {
+                    status.reason = STOP_DIAMETER;
+                } else if (criteria.stagnation_iterations > 0 &&
+                           status.iteration - status.last_improvement >= criteria.stagnation_iterations) {
+                    status.reason = STOP_STAGNATION;
+                } else if (criteria.max_evaluations > 0 && status.evaluations >= criteria.max_evaluations) {
+                    status.reason = STOP_EVALUATIONS;
+                } else if (criteria.max_seconds > 0 && status.seconds >= criteria.max_seconds) {
+                    status.reason = STOP_WALL_CLOCK;
+                }
+            }
+
+        public:
+            // Starts counting afresh from a new or loaded swarm that took evaluations to get to.
+            void start(const StoppingCriteria& stopping, int iteration, double best_fitness,
+                       std::uint64_t evaluations) {
+                criteria = stopping;
+                status = Status();
+                status.iteration = iteration;
+                status.last_improvement = iteration;
+                status.best_fitness = best_fitness;
+                status.evaluations = evaluations;
+                stagnation_best = best_fitness;
+                check();
+            }
+
+            // Takes in one step's outcome and returns the rule that fired, if any.
+            StopReason update(int iteration, double best_fitness, const Diversity& diversity,
+                              std::uint64_t evaluations, double seconds) {
+                status.iteration = iteration;
+                status.best_fitness = best_fitness;
+                status.diameter = diversity.diameter();
+                status.radius = diversity.radius();
+                status.evaluations += evaluations;
+                status.seconds += seconds;
+                if (best_fitness < stagnation_best - criteria.stagnation_tolerance) {
+                    stagnation_best = best_fitness;
+                    status.last_improvement = iteration;
+                }
+                check();
+                return status.reason;
+            }
+
+            // Swaps in new criteria, keeping the counts so far.
+            void set_criteria(const StoppingCriteria& stopping) {
+                criteria = stopping;
+                status.reason = STOP_NONE;
+                check();
+            }
+
+            // Lets a stopped run step again, e.g. after stepping back.
+            void resume() {
+                status.reason = STOP_NONE;
+            }
+
+            const Status& get_status() const {
+                return status;
+            }
+
+            double get_stagnation_best() const {
+                return stagnation_best;
+            }
+
+            // Carries on from a saved status, e.g. a checkpoint's.
+            void restore(const StoppingCriteria& stopping, const Status& saved, double saved_stagnation_best) {
+                criteria = stopping;
+                status = saved;
+                stagnation_best = saved_stagnation_best;
+            }
+        };
+    }
+}
+#endif //CONVERGENCE_H
@@ -0,0 +1,145 @@
+//
+// Text helpers for the cycles.csv format built on std::to_chars / std::from_chars.
+//
+#ifndef CYCLES_CSV_H
+#define CYCLES_CSV_H
+#include <charconv>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <vector>
+
+namespace algos {
+    namespace cycles_csv {
+        /*
+         * Layout: "key,value" config lines, a blank line (the saver writes four),
+         * then one row per stored iteration holding every coordinate of particle 0,
+         * then of particle 1 and so on; in two dimensions x0,y0,x1,y1,... Files
+         * without a dimensions key are two-dimensional. Numbers are written
+         * with the shortest text that reads back to the same double, and parsed
+         * without the locale, so a save/load round trip is exact.
+         */
+
+        // Shortest round-trip text for value, appended to out.
+        template<typename T>
+        inline void append_number(std::string& out, T value) {
+            char text[32];
+            std::to_chars_result result = std::to_chars(text, text + sizeof(text), value);
+            out.append(text, result.ptr - text);
+        }
+
+        /*
+         * The coordinates of every particle in [begin, end), comma separated with no
+         * trailing comma. Coordinate d of particle i is positions[d * stride + i].
+         */
+        inline void append_points(std::string& out, const double* positions, std::size_t stride, int dimensions,
+                                  int begin, int end) {
+            char text[32];
+            for (int i = begin; i < end; i++) {
+                for (int d = 0; d < dimensions; d++) {
+                    if (i != begin || d != 0) {
+                        out += ',';
+                    }
+                    char* p = std::to_chars(text, text + sizeof(text), positions[d * stride + i]).ptr;
+                    out.append(text, p - text);
+                }
+            }
+        }
+
+        inline std::string_view trim(std::string_view text) {
+            while (!text.empty() && (text.front() == ' ' || text.front() == '\t')) {
+                text.remove_prefix(1);
+            }
+            while (!text.empty() && (text.back() == ' ' || text.back() == '\t' || text.back() == '\r')) {
+                text.remove_suffix(1);
+            }
+            return text;
+        }
+
+        // Parses the whole of text as a number, leaving out untouched on failure.
+        template<typename T>
+        inline bool parse_number(std::string_view text, T* out) {
+            text = trim(text);
+            if (!text.empty() && text.front() == '+') {
+                text.remove_prefix(1);
+            }
+            T value;
+            std::from_chars_result result = std::from_chars(text.data(), text.data() + text.size(), value);
+            if (result.ec != std::errc() || result.ptr != text.data() + text.size()) {
+                return false;
+            }
+            *out = value;
+            return true;
+        }
+
+        // Line starting at begin, without its "\n" or "\r\n".
+        inline std::string_view line_at(const char* begin, const char* end) {
+            const char* newline = static_cast<const char*>(std::memchr(begin, '\n', end - begin));
+            const char* line_end = newline != nullptr ? newline : end;
+            if (line_end > begin && line_end[-1] == '\r') {
+                line_end--;
+            }
+            return std::string_view(begin, line_end - begin);
+        }
+
+        inline const char* next_line(const char* begin, const char* end) {
+            const char* newline = static_cast<const char*>(std::memchr(begin, '\n', end - begin));
+            return newline != nullptr ? newline + 1 : end;
+        }
+
+        inline bool is_blank(std::string_view line) {
+            return trim(line).empty();
+        }
+
+        // The non-blank lines in [begin, end).
+        inline std::vector<std::string_view> split_rows(const char* begin, const char* end) {
+            std::vector<std::string_view> rows;
+            while (begin < end) {
+                std::string_view line = line_at(begin, end);
+                if (!is_blank(line)) {
+                    rows.push_back(line);
+                }
+                begin = next_line(begin, end);
+            }
+            return rows;
+        }
+
+        /*
+         * Reads a row of exactly n_particles points into positions, laid out as for
+         * append_points(). Returns false if a value does not parse or the row holds a
+         * different number of values.
+         */
+        inline bool parse_row(std::string_view row, double* positions, std::size_t stride, int dimensions,
+                              int n_particles) {
+            const char* p = row.data();
+            const char* end = p + row.size();
+            int values = dimensions * n_particles;
+            for (int i = 0; i < values; i++) {
+                while (p < end && (*p == ' ' || *p == '\t')) {
+                    p++;
+                }
+                if (p < end && *p == '+') {
+                    p++;
+                }
+                double* out = &positions[(i % dimensions) * stride + i / dimensions];
+                std::from_chars_result result = std::from_chars(p, end, *out);
+                if (result.ec != std::errc()) {
+                    return false;
+                }
+                p = result.ptr;
+                while (p < end && (*p == ' ' || *p == '\t')) {
+                    p++;
+                }
+                if (i != values - 1) {
+                    if (p == end || *p != ',') {
+                        return false;
+                    }
+                    p++;
+                }
+            }
+            return p == end;
+        }
+    }
+}
+#endif //CYCLES_CSV_H
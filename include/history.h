@@ -0,0 +1,570 @@
+//
+// Iteration history stored as periodic keyframes plus compact per-step deltas.
+//
+#ifndef HISTORY_H
+#define HISTORY_H
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <functional>
+#include <list>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "swarm.h"
+#include "mapped_file.h"
+
+namespace algos {
+    namespace pso {
+        struct StoredCycle {
+            Swarm swarm;
+            int iterations;
+            int n_particles;
+        };
+
+        struct HistoryStats {
+            std::size_t entries = 0;
+            std::size_t keyframes = 0;
+            // Held in RAM.
+            std::size_t bytes = 0;
+            // Spilled to segment files on disk.
+            std::size_t spilled_bytes = 0;
+            std::size_t spilled_entries = 0;
+            std::size_t segments = 0;
+            // What the same history would take as one full swarm copy per entry.
+            std::size_t full_copy_bytes = 0;
+        };
+
+        struct HistoryOptions {
+            int keyframe_interval = 32;
+            // Resident byte budget, 0 for unlimited. Older entries spill to disk past it.
+            std::size_t memory_budget = 0;
+            // Where segment files go, the system temp directory if empty.
+            std::string spill_directory;
+            // Without it only the newest entry is kept, for runs that only need their outcome.
+            bool keep_history = true;
+            // Takes back the swarms the history drops and supplies its keyframe copies, null to allocate each.
+            std::shared_ptr<SwarmPool> pool = nullptr;
+        };
+
+        /*
+         * Delta codec. Positions are XORed with their value in the previous iteration
+         * and written as a byte counting the XOR's leading zero bytes followed by its
+         * remaining low bytes, which drops the sign/exponent bytes a small move leaves
+         * untouched. Personal bests only change when a particle improves, so they are
+         * stored as a bitmap of changed particles plus, for those, the new best (usually
+         * the new position, which then costs a single zero byte per coordinate).
+         * The encoding is lossless, a decoded swarm is bit-identical to the original.
+         */
+        namespace delta {
+            inline std::uint64_t bits_of(double value) {
+                std::uint64_t bits;
+                std::memcpy(&bits, &value, sizeof(bits));
+                return bits;
+            }
+
+            inline double from_bits(std::uint64_t bits) {
+                double value;
+                std::memcpy(&value, &bits, sizeof(value));
+                return value;
+            }
+
+            inline int leading_zero_bytes(std::uint64_t x) {
+#if defined(__GNUC__) || defined(__clang__)
+                return x == 0 ? 8 : __builtin_clzll(x) >> 3;
+#else
+                int n = 0;
+                while (n < 8 && (x >> (56 - 8 * n) & 0xFF) == 0) {
+                    n++;
+                }
+                return n;
+#endif
+            }
+
+            // Writes x as a length byte plus its low bytes; out needs 9 bytes of room.
+            inline std::uint8_t* put(std::uint8_t* out, std::uint64_t x) {
+                int length = 8 - leading_zero_bytes(x);
+                *out++ = (std::uint8_t) length;
+                for (int byte = 0; byte < length; byte++) {
+                    out[byte] = (std::uint8_t) (x >> (8 * byte));
+                }
+                return out + length;
+            }
+
+            inline const std::uint8_t* get(const std::uint8_t* in, std::uint64_t* x) {
+                int length = *in++;
+                std::uint64_t value = 0;
+                for (int byte = 0; byte < length; byte++) {
+                    value |= (std::uint64_t) in[byte] << (8 * byte);
+                }
+                *x = value;
+                return in + length;
+            }
+
+            inline bool best_changed(const Swarm& previous, const Swarm& current, std::size_t i) {
+                if (bits_of(previous.best_fitness[i]) != bits_of(current.best_fitness[i])) {
+                    return true;
+                }
+                for (int d = 0; d < current.dimensions; d++) {
+                    if (bits_of(previous.best_column(d)[i]) != bits_of(current.best_column(d)[i])) {
+                        return true;
+                    }
+                }
+                return false;
+            }
+
+            // Encodes into scratch (grown as needed) and returns the encoded length.
+            inline std::size_t encode(const Swarm& previous, const Swarm& current, std::vector<std::uint8_t>& scratch) {
+                std::size_t n = current.size();
+                int dimensions = current.dimensions;
+                std::size_t bitmap_bytes = (n + 7) / 8;
+                // Worst case: bitmap, the position and the best position and fitness per particle at 9 bytes each.
+                std::size_t worst = bitmap_bytes + n * (2 * dimensions + 1) * 9;
+                if (scratch.size() < worst) {
+                    scratch.resize(worst);
+                }
+                std::uint8_t* bitmap = scratch.data();
+                std::memset(bitmap, 0, bitmap_bytes);
+                std::uint8_t* p = bitmap + bitmap_bytes;
+                for (int d = 0; d < dimensions; d++) {
+                    const double* before = previous.column(d);
+                    const double* after = current.column(d);
+                    for (std::size_t i = 0; i < n; i++) {
+                        p = put(p, bits_of(before[i]) ^ bits_of(after[i]));
+                    }
+                }
+                for (std::size_t i = 0; i < n; i++) {
+                    if (!best_changed(previous, current, i)) {
+                        continue;
+                    }
+                    bitmap[i / 8] |= (std::uint8_t) (1 << (i % 8));
+                    for (int d = 0; d < dimensions; d++) {
+                        p = put(p, bits_of(current.column(d)[i]) ^ bits_of(current.best_column(d)[i]));
+                    }
+                    p = put(p, bits_of(previous.best_fitness[i]) ^ bits_of(current.best_fitness[i]));
+                }
+                return p - scratch.data();
+            }
+
+            // Applies a delta in place, turning the previous iteration into the next one.
+            inline void apply(const std::uint8_t* in, Swarm& swarm) {
+                std::size_t n = swarm.size();
+                int dimensions = swarm.dimensions;
+                const std::uint8_t* bitmap = in;
+                const std::uint8_t* p = bitmap + (n + 7) / 8;
+                std::uint64_t x;
+                for (int d = 0; d < dimensions; d++) {
+                    double* column = swarm.column(d);
+                    for (std::size_t i = 0; i < n; i++) {
+                        p = get(p, &x);
+                        column[i] = from_bits(bits_of(column[i]) ^ x);
+                    }
+                }
+                for (std::size_t i = 0; i < n; i++) {
+                    if (!(bitmap[i / 8] >> (i % 8) & 1)) {
+                        continue;
+                    }
+                    for (int d = 0; d < dimensions; d++) {
+                        p = get(p, &x);
+                        swarm.best_column(d)[i] = from_bits(bits_of(swarm.column(d)[i]) ^ x);
+                    }
+                    p = get(p, &x);
+                    swarm.best_fitness[i] = from_bits(bits_of(swarm.best_fitness[i]) ^ x);
+                }
+            }
+        }
+
+        /*
+         * Stack-like store of every iteration of a run. Every keyframe_interval-th
+         * entry is a full swarm; the others are deltas against the entry before, so
+         * any entry is rebuilt from at most keyframe_interval - 1 deltas. The newest
+         * entry is also kept decoded since stepping and plotting always read it.
+         *
+         * With a memory budget, the oldest resident entries are written to a segment
+         * file whenever the budget is exceeded and their RAM is released. Segments are
+         * memory-mapped on demand when an entry in them is read, and only a few stay
+         * mapped at once, so resident memory stays near the budget however long the run.
+         */
+        class History {
+        private:
+            struct Entry {
+                int iterations;
+                int n_particles;
+                int dimensions;
+                bool is_keyframe;
+                Swarm keyframe;
+                std::vector<std::uint8_t> delta;
+                // Location once spilled, segment is -1 while the entry is resident.
+                int segment = -1;
+                std::size_t offset = 0;
+                std::size_t length = 0;
+            };
+
+            struct Segment {
+                std::string path;
+                MappedFile map;
+                int live_entries = 0;
+            };
+
+            static constexpr int MAX_MAPPED_SEGMENTS = 4;
+
+            std::vector<Entry> entries;
+            StoredCycle current{};
+            std::vector<std::uint8_t> scratch;
+            HistoryOptions options;
+            // Delta buffers of popped entries, for the entries pushed next.
+            std::vector<std::vector<std::uint8_t>> spare_deltas;
+
+            // Mappings are a cache, so reading entries back (a const operation) may change them.
+            mutable std::vector<Segment> segments;
+            // Most recently used mapped segments first.
+            mutable std::list<int> mapped;
+            // Entries before this index are all spilled.
+            std::size_t first_resident = 0;
+            std::size_t resident_bytes = 0;
+
+            Swarm copy_of(const Swarm& swarm) {
+                return options.pool ? options.pool->acquire_copy(swarm) : swarm;
+            }
+
+            void recycle(Swarm&& swarm) {
+                if (options.pool) {
+                    options.pool->release(std::move(swarm));
+                }
+            }
+
+            static std::size_t swarm_bytes(const Swarm& swarm) {
+                return (swarm.position.size() + swarm.best_position.size() + swarm.best_fitness.size()) * sizeof(double);
+            }
+
+            static std::size_t entry_bytes(const Entry& entry) {
+                return sizeof(Entry) + entry.delta.capacity() + swarm_bytes(entry.keyframe);
+            }
+
+            std::string next_segment_path() {
+                static std::atomic<unsigned> counter{0};
+                std::filesystem::path dir = options.spill_directory.empty()
+                        ? std::filesystem::temp_directory_path() : std::filesystem::path(options.spill_directory);
+                auto stamp = std::chrono::steady_clock::now().time_since_epoch().count();
+                return (dir / ("pso_history_" + std::to_string(stamp) + "_" + std::to_string(counter++) + ".seg")).string();
+            }
+
+            const std::uint8_t* segment_data(int index) const {
+                Segment& segment = segments[index];
+                mapped.remove(index);
+                mapped.push_front(index);
+                if (!segment.map.is_open() && !segment.map.open(segment.path)) {
+                    printf("Error mapping history segment %s\n", segment.path.c_str());
+                    return nullptr;
+                }
+                while ((int) mapped.size() > MAX_MAPPED_SEGMENTS) {
+                    segments[mapped.back()].map.close();
+                    mapped.pop_back();
+                }
+                return segment.map.data();
+            }
+
+            void release_segment(int index) {
+                Segment& segment = segments[index];
+                if (--segment.live_entries > 0) {
+                    return;
+                }
+                segment.map.close();
+                mapped.remove(index);
+                std::remove(segment.path.c_str());
+                // Segments are released newest first, so trailing ones can be dropped.
+                while (!segments.empty() && segments.back().live_entries == 0) {
+                    segments.pop_back();
+                }
+            }
+
+            void load_keyframe(const Entry& entry, Swarm& swarm) const {
+                if (entry.segment < 0) {
+                    swarm = entry.keyframe;
+                    return;
+                }
+                const std::uint8_t* data = segment_data(entry.segment);
+                swarm.resize(entry.n_particles, entry.dimensions);
+                if (data == nullptr) {
+                    return;
+                }
+                const double* columns = reinterpret_cast<const double*>(data + entry.offset);
+                std::size_t positions = swarm.position.size();
+                std::memcpy(swarm.position.data(), columns, positions * sizeof(double));
+                std::memcpy(swarm.best_position.data(), columns + positions, positions * sizeof(double));
+                std::memcpy(swarm.best_fitness.data(), columns + 2 * positions, swarm.best_fitness.size() * sizeof(double));
+            }
+
+            void apply_delta(const Entry& entry, Swarm& swarm) const {
+                if (entry.segment < 0) {
+                    delta::apply(entry.delta.data(), swarm);
+                    return;
+                }
+                const std::uint8_t* data = segment_data(entry.segment);
+                if (data != nullptr) {
+                    delta::apply(data + entry.offset, swarm);
+                }
+            }
+
+            /*
+             * Writes the oldest resident entries to a new segment until resident memory
+             * drops to three quarters of the budget. The newest entry always stays resident.
+             */
+            void spill() {
+                std::size_t target = options.memory_budget / 4 * 3;
+                std::size_t end = first_resident;
+                std::size_t freed = 0;
+                while (end + 1 < entries.size() && resident_bytes - freed > target) {
+                    freed += entry_bytes(entries[end]);
+                    end++;
+                }
+                if (end == first_resident) {
+                    return;
+                }
+
+                Segment segment;
+                segment.path = next_segment_path();
+                FILE* file = fopen(segment.path.c_str(), "wb");
+                if (file == nullptr) {
+                    printf("Error opening history segment %s\n", segment.path.c_str());
+                    return;
+                }
+                int index = (int) segments.size();
+                std::size_t offset = 0;
+                bool ok = true;
+                for (std::size_t i = first_resident; i < end && ok; i++) {
+                    Entry& entry = entries[i];
+                    entry.offset = offset;
+                    if (entry.is_keyframe) {
+                        const Swarm& swarm = entry.keyframe;
+                        std::size_t positions = swarm.position.size();
+                        std::size_t n = swarm.best_fitness.size();
+                        ok = fwrite(swarm.position.data(), sizeof(double), positions, file) == positions &&
+                             fwrite(swarm.best_position.data(), sizeof(double), positions, file) == positions &&
+                             fwrite(swarm.best_fitness.data(), sizeof(double), n, file) == n;
+                        entry.length = swarm_bytes(swarm);
+                    } else {
+                        ok = fwrite(entry.delta.data(), 1, entry.delta.size(), file) == entry.delta.size();
+                        entry.length = entry.delta.size();
+                    }
+                    // Keep every record 8-byte aligned so keyframe columns can be read in place.
+                    std::size_t padding = (8 - entry.length % 8) % 8;
+                    static const std::uint8_t zeros[8] = {};
+                    ok = ok && fwrite(zeros, 1, padding, file) == padding;
+                    offset += entry.length + padding;
+                }
+                if (fclose(file) != 0 || !ok) {
+                    printf("Error writing history segment %s\n", segment.path.c_str());
+                    std::remove(segment.path.c_str());
+                    return;
+                }
+
+                for (std::size_t i = first_resident; i < end; i++) {
+                    Entry& entry = entries[i];
+                    resident_bytes -= entry_bytes(entry);
+                    entry.segment = index;
+                    entry.keyframe = Swarm();
+                    entry.delta = std::vector<std::uint8_t>();
+                    segment.live_entries++;
+                }
+                segments.push_back(std::move(segment));
+                first_resident = end;
+            }
+
+        public:
+            explicit History(HistoryOptions opts = HistoryOptions()) : options(std::move(opts)) {
+                if (options.keyframe_interval < 1) {
+                    options.keyframe_interval = 1;
+                }
+            }
+
+            explicit History(int keyframe_interval) : History(HistoryOptions{keyframe_interval, 0, ""}) {}
+
+            History(const History&) = delete;
+            History& operator=(const History&) = delete;
+            History(History&&) = default;
+
+            History& operator=(History&& other) noexcept {
+                if (this != &other) {
+                    clear();
+                    entries = std::move(other.entries);
+                    current = std::move(other.current);
+                    options = std::move(other.options);
+                    segments = std::move(other.segments);
+                    mapped = std::move(other.mapped);
+                    first_resident = other.first_resident;
+                    resident_bytes = other.resident_bytes;
+                    other.segments.clear();
+                    other.entries.clear();
+                    other.mapped.clear();
+                    other.first_resident = 0;
+                    other.resident_bytes = 0;
+                }
+                return *this;
+            }
+
+            ~History() {
+                clear();
+            }
+
+            void set_memory_budget(std::size_t bytes) {
+                options.memory_budget = bytes;
+                if (options.memory_budget > 0 && resident_bytes > options.memory_budget) {
+                    spill();
+                }
+            }
+
+            void push(StoredCycle cycle) {
+                if (!options.keep_history) {
+                    // The newest entry is always read from current, so it needs no keyframe of its own.
+                    entries.assign(1, Entry{cycle.iterations, cycle.n_particles, cycle.swarm.dimensions, true, {}, {}});
+                    resident_bytes = entry_bytes(entries.back());
+                    recycle(std::move(current.swarm));
+                    current = std::move(cycle);
+                    return;
+                }
+                // A change of swarm shape cannot be expressed as a delta, so it also forces a keyframe.
+                bool key = entries.size() % options.keyframe_interval == 0 || current.swarm.size() != cycle.swarm.size() ||
+                           current.swarm.dimensions != cycle.swarm.dimensions;
+                Entry entry{cycle.iterations, cycle.n_particles, cycle.swarm.dimensions, key, {}, {}};
+                if (key) {
+                    entry.keyframe = copy_of(cycle.swarm);
+                } else {
+                    std::size_t length = delta::encode(current.swarm, cycle.swarm, scratch);
+                    if (!spare_deltas.empty()) {
+                        entry.delta = std::move(spare_deltas.back());
+                        spare_deltas.pop_back();
+                    }
+                    entry.delta.assign(scratch.begin(), scratch.begin() + length);
+                }
+                resident_bytes += entry_bytes(entry);
+                entries.push_back(std::move(entry));
+                recycle(std::move(current.swarm));
+                current = std::move(cycle);
+                if (options.memory_budget > 0 && resident_bytes > options.memory_budget) {
+                    spill();
+                }
+            }
+
+            void pop() {
+                if (entries.empty()) {
+                    return;
+                }
+                Entry& last = entries.back();
+                if (last.segment >= 0) {
+                    release_segment(last.segment);
+                    first_resident = entries.size() - 1;
+                } else {
+                    resident_bytes -= entry_bytes(last);
+                    recycle(std::move(last.keyframe));
+                    // Enough for stepping back and forth over a keyframe interval or two.
+                    if (!last.delta.empty() && (int) spare_deltas.size() < 2 * options.keyframe_interval) {
+                        spare_deltas.push_back(std::move(last.delta));
+                    }
+                }
+                entries.pop_back();
+                if (entries.empty()) {
+                    current = StoredCycle{};
+                } else {
+                    seek(entries.size() - 1, &current);
+                }
+            }
+
+            const StoredCycle& top() const {
+                return current;
+            }
+
+            std::size_t size() const {
+                return entries.size();
+            }
+
+            bool empty() const {
+                return entries.empty();
+            }
+
+            void clear() {
+                for (Segment& segment : segments) {
+                    segment.map.close();
+                    std::remove(segment.path.c_str());
+                }
+                segments.clear();
+                mapped.clear();
+                entries.clear();
+                spare_deltas.clear();
+                recycle(std::move(current.swarm));
+                current = StoredCycle{};
+                first_resident = 0;
+                resident_bytes = 0;
+            }
+
+            /*
+             * Rebuilds entry index (0 is the oldest) into out by decoding forward from
+             * the nearest keyframe at or before it.
+             */
+            void seek(std::size_t index, StoredCycle* out) const {
+                if (index == entries.size() - 1 && out != &current) {
+                    *out = current;
+                    return;
+                }
+                std::size_t base = index;
+                while (!entries[base].is_keyframe) {
+                    base--;
+                }
+                load_keyframe(entries[base], out->swarm);
+                for (std::size_t i = base + 1; i <= index; i++) {
+                    apply_delta(entries[i], out->swarm);
+                }
+                out->iterations = entries[index].iterations;
+                out->n_particles = entries[index].n_particles;
+            }
+
+            // Visits every entry from oldest to newest, decoding each delta once.
+            void for_each(const std::function<void(const StoredCycle&)>& visit) const {
+                if (!options.keep_history) {
+                    if (!entries.empty()) {
+                        visit(current);
+                    }
+                    return;
+                }
+                StoredCycle cycle{};
+                for (std::size_t i = 0; i < entries.size(); i++) {
+                    if (entries[i].is_keyframe) {
+                        load_keyframe(entries[i], cycle.swarm);
+                    } else {
+                        apply_delta(entries[i], cycle.swarm);
+                    }
+                    cycle.iterations = entries[i].iterations;
+                    cycle.n_particles = entries[i].n_particles;
+                    visit(cycle);
+                }
+            }
+
+            HistoryStats stats() const {
+                HistoryStats stats;
+                stats.entries = entries.size();
+                for (const Entry& entry : entries) {
+                    stats.full_copy_bytes += entry.n_particles * (2 * entry.dimensions + 1) * sizeof(double);
+                    if (entry.is_keyframe) {
+                        stats.keyframes++;
+                    }
+                    if (entry.segment >= 0) {
+                        stats.spilled_bytes += entry.length;
+                        stats.spilled_entries++;
+                    }
+                }
+                for (const Segment& segment : segments) {
+                    if (segment.live_entries > 0) {
+                        stats.segments++;
+                    }
+                }
+                stats.bytes = resident_bytes + swarm_bytes(current.swarm);
+                return stats;
+            }
+        };
+    }
+}
+#endif //HISTORY_H
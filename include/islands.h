@@ -0,0 +1,219 @@
+//
+// Island model: independent swarms stepped on their own threads, exchanging their
+// best particles every few iterations.
+//
+#ifndef ISLANDS_H
+#define ISLANDS_H
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "pso.h"
+
+namespace algos {
+    namespace islands {
+        enum Topology {
+            // Island i sends to island i + 1, the last one to the first.
+            TOPOLOGY_RING = 0,
+            // Every island receives the best migrants of all the others.
+            TOPOLOGY_FULL = 1,
+        };
+
+        struct IslandConfig {
+            int n_islands = 4;
+            // Iterations each island runs alone between migrations.
+            int migration_interval = 10;
+            // Best particles each island sends at a migration.
+            int n_migrants = 1;
+            Topology topology = TOPOLOGY_RING;
+        };
+
+        inline bool parse_topology(const std::string& name, Topology* out) {
+            if (name == "ring") {
+                *out = TOPOLOGY_RING;
+            } else if (name == "full") {
+                *out = TOPOLOGY_FULL;
+            } else {
+                return false;
+            }
+            return true;
+        }
+
+        inline const char* topology_name(Topology topology) {
+            return topology == TOPOLOGY_FULL ? "full" : "ring";
+        }
+
+        // Seed of one island, hashed from the run's seed so the islands draw unrelated swarms.
+        inline std::uint64_t island_seed(std::uint64_t seed, int island) {
+            rng::Counter mixed = rng::philox4x32({{(std::uint32_t) island, 0, 0x15A4D, 0}}, seed);
+            return ((std::uint64_t) mixed.v[0] << 32) | mixed.v[1];
+        }
+    }
+
+    /*
+     * K swarms, each a BasicPSO with its own particles, global best and history. Between
+     * migrations every island steps on one thread with no shared state; at a migration
+     * each sends its best personal bests along the topology and they replace the
+     * receiver's worst ones. Islands step and migrate in a fixed order, so the outcome
+     * does not depend on the thread count.
+     *
+     * config.n_particles is per island, config.n_threads the threads for all of them.
+     */
+    template<typename Objective>
+    class BasicIslandPSO {
+    private:
+        pso::PSOConfig config;
+        islands::IslandConfig island_config;
+        std::vector<std::unique_ptr<BasicPSO<Objective>>> islands;
+        std::unique_ptr<ThreadPool> pool;
+        int iteration = 0;
+
+        void for_each_island(const std::function<void(int)>& body) {
+            int n = (int) islands.size();
+            if (config.n_threads <= 1 || n <= 1) {
+                for (int i = 0; i < n; i++) {
+                    body(i);
+                }
+                return;
+            }
+            // The calling thread steps islands too, so the pool needs one thread fewer.
+            if (!pool) {
+                pool = std::make_unique<ThreadPool>(std::min(config.n_threads, n) - 1);
+            }
+            pool->parallel_for(0, n, 1, [&body](int begin, int) {
+                body(begin);
+            });
+        }
+
+        // The migrants island receives, given what every island sent.
+        std::vector<pso::Migrant> migrants_for(int island, const std::vector<std::vector<pso::Migrant>>& sent) const {
+            int n = (int) islands.size();
+            if (island_config.topology == islands::TOPOLOGY_RING) {
+                return sent[(island + n - 1) % n];
+            }
+            std::vector<pso::Migrant> received;
+            for (int j = 0; j < n; j++) {
+                if (j != island) {
+                    received.insert(received.end(), sent[j].begin(), sent[j].end());
+                }
+            }
+            // Sending island order breaks ties, stable_sort keeps it.
+            std::stable_sort(received.begin(), received.end(),
+                             [](const pso::Migrant& a, const pso::Migrant& b) { return a.fitness < b.fitness; });
+            if ((int) received.size() > island_config.n_migrants) {
+                received.resize(island_config.n_migrants);
+            }
+            return received;
+        }
+
+        void migrate() {
+            int n = (int) islands.size();
+            if (n < 2 || island_config.n_migrants <= 0) {
+                return;
+            }
+            // Everyone sends before anyone receives, so no island passes on what it was just sent.
+            std::vector<std::vector<pso::Migrant>> sent(n);
+            for (int i = 0; i < n; i++) {
+                sent[i] = islands[i]->best_particles(island_config.n_migrants);
+            }
+            for (int i = 0; i < n; i++) {
+                islands[i]->add_migrants(migrants_for(i, sent));
+            }
+        }
+
+    public:
+        BasicIslandPSO(Objective objective, pso::PSOConfig cfg, islands::IslandConfig island_cfg)
+            : config(std::move(cfg)), island_config(island_cfg) {
+            island_config.n_islands = std::max(1, island_config.n_islands);
+            island_config.migration_interval = std::max(1, island_config.migration_interval);
+            islands.resize(island_config.n_islands);
+            for_each_island([&](int i) {
+                pso::PSOConfig island = config;
+                island.n_threads = 1;
+                island.seed = islands::island_seed(config.seed, i);
+                islands[i] = std::make_unique<BasicPSO<Objective>>(objective, island);
+            });
+        }
+
+        /*
+         * Runs every island to the next migration point, or to max_iterations if that
+         * comes first, then migrates. An island its stopping criteria stopped waits out
+         * the others. Returns false once max_iterations is reached or every island stopped.
+         */
+        bool advance() {
+            if (iteration >= config.max_iterations || all_stopped()) {
+                return false;
+            }
+            int target = std::min(config.max_iterations,
+                                  (iteration / island_config.migration_interval + 1) * island_config.migration_interval);
+            for_each_island([this, target](int i) {
+                while (islands[i]->get_iteration() < target &&
+                       islands[i]->get_stop_reason() == convergence::STOP_NONE) {
+                    islands[i]->step();
+                }
+            });
+            iteration = target;
+            if (iteration % island_config.migration_interval == 0) {
+                migrate();
+            }
+            return iteration < config.max_iterations && !all_stopped();
+        }
+
+        bool all_stopped() const {
+            for (const auto& island : islands) {
+                if (island->get_stop_reason() == convergence::STOP_NONE) {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        void run() {
+            while (advance()) {
+            }
+        }
+
+        int get_iteration() const {
+            return iteration;
+        }
+
+        int size() const {
+            return (int) islands.size();
+        }
+
+        BasicPSO<Objective>& island(int i) {
+            return *islands[i];
+        }
+
+        // Index of the island holding the overall global best, the first on ties.
+        int best_island() const {
+            int best = 0;
+            for (int i = 1; i < (int) islands.size(); i++) {
+                if (islands[i]->get_pso_config().global_best_fitness <
+                    islands[best]->get_pso_config().global_best_fitness) {
+                    best = i;
+                }
+            }
+            return best;
+        }
+
+        // Best of all islands, with n_particles the total over them.
+        pso::PSOConfig get_pso_config() const {
+            pso::PSOConfig best = islands[best_island()]->get_pso_config();
+            best.n_particles = config.n_particles * (int) islands.size();
+            best.n_threads = config.n_threads;
+            best.seed = config.seed;
+            return best;
+        }
+
+        islands::IslandConfig get_island_config() const {
+            return island_config;
+        }
+    };
+
+    using IslandPSO = BasicIslandPSO<BatchFitnessFunction>;
+}
+#endif //ISLANDS_H
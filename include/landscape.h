@@ -0,0 +1,299 @@
+//
+// Cached, progressively refined samples of an objective over a 2-D slice of the search space.
+//
+#ifndef LANDSCAPE_H
+#define LANDSCAPE_H
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include "searchers.h"
+#include "swarm.h"
+#include "thread_pool.h"
+#include "plot_data.h"
+
+namespace algos {
+    namespace landscape {
+        // Samples along each side of a tile.
+        constexpr int TILE_SAMPLES = 64;
+        // Sample stride of the first, coarsest pass. Each later pass halves it down to 1.
+        constexpr int COARSEST_STRIDE = 8;
+        constexpr int PASSES = 4;
+        // Screen pixels per sample the tile level is chosen for.
+        constexpr int PIXELS_PER_SAMPLE = 2;
+
+        /*
+         * The plane being sampled: dim_x and dim_y vary, every other coordinate is held
+         * at origin. Changing any of it invalidates every tile.
+         */
+        struct Slice {
+            int dimensions = 2;
+            int dim_x = 0;
+            int dim_y = 1;
+            std::vector<double> origin;
+
+            bool operator==(const Slice& other) const {
+                return dimensions == other.dimensions && dim_x == other.dim_x && dim_y == other.dim_y &&
+                       origin == other.origin;
+            }
+        };
+
+        /*
+         * Tiles sit on a fixed world-space lattice: at level (ex, ey) samples are 2^ex
+         * apart along x and 2^ey along y, and tile (tx, ty) starts at sample
+         * (tx, ty) * TILE_SAMPLES. Panning therefore reuses every tile still in view,
+         * and zooming back finds the tiles of the earlier level still cached.
+         */
+        struct TileKey {
+            int ex;
+            int ey;
+            long long tx;
+            long long ty;
+
+            bool operator==(const TileKey& other) const {
+                return ex == other.ex && ey == other.ey && tx == other.tx && ty == other.ty;
+            }
+        };
+
+        struct TileKeyHash {
+            std::size_t operator()(const TileKey& key) const {
+                std::uint64_t h = (std::uint64_t) (key.ex * 131 + key.ey);
+                h = h * 0x9E3779B97F4A7C15ull ^ (std::uint64_t) key.tx;
+                h = h * 0x9E3779B97F4A7C15ull ^ (std::uint64_t) key.ty;
+                return (std::size_t) (h ^ (h >> 29));
+            }
+        };
+
+        struct Tile {
+            // Row-major, row 0 at the lowest y. Before the last pass, each sample is copied over the block it stands for.
+            std::vector<float> values;
+            // Passes done, PASSES when every sample is exact.
+            int passes = 0;
+            // Bumped whenever values change, for whoever caches a rendering of them.
+            std::uint64_t version = 0;
+            // Frame the tile was last in view, the least recent ones are evicted first.
+            std::uint64_t last_used = 0;
+            float min_value = 0;
+            float max_value = 0;
+        };
+
+        /*
+         * Tile cache for one slice. refine() runs the next pass of the coarsest visible
+         * tiles within a sample budget, so a fresh view fills in quickly at low
+         * resolution and sharpens over the following frames. Only tiles that come into
+         * view are computed; a changed slice or objective (e.g. a new goal) empties it.
+         */
+        class LandscapeCache {
+        private:
+            std::unordered_map<TileKey, Tile, TileKeyHash> tiles;
+            Slice slice;
+            std::uint64_t frame = 0;
+            std::size_t max_tiles;
+
+            // Per-pass scratch, one set per tile refined together.
+            std::vector<pso::AlignedVector<double>> columns;
+            std::vector<pso::AlignedVector<double>> fitness;
+
+            static int level_for(double extent, int pixels) {
+                double spacing = extent * PIXELS_PER_SAMPLE / std::max(1, pixels);
+                return (int) std::ceil(std::log2(std::max(spacing, 1e-12)));
+            }
+
+            void evict() {
+                while (tiles.size() > max_tiles) {
+                    auto oldest = tiles.begin();
+                    for (auto it = tiles.begin(); it != tiles.end(); ++it) {
+                        if (it->second.last_used < oldest->second.last_used) {
+                            oldest = it;
+                        }
+                    }
+                    if (oldest->second.last_used == frame) {
+                        return;
+                    }
+                    tiles.erase(oldest);
+                }
+            }
+
+        public:
+            explicit LandscapeCache(std::size_t tile_limit = 1024) : max_tiles(tile_limit) {}
+
+            // Level of the visible tiles in a view.
+            static void level_of(const plot::View& view, int* ex, int* ey) {
+                *ex = level_for(view.max_x - view.min_x, view.width);
+                *ey = level_for(view.max_y - view.min_y, view.height);
+            }
+
+            // World rectangle of a tile.
+            static void bounds_of(const TileKey& key, double* min_x, double* min_y, double* max_x, double* max_y) {
+                double sx = std::ldexp(1.0, key.ex) * TILE_SAMPLES;
+                double sy = std::ldexp(1.0, key.ey) * TILE_SAMPLES;
+                *min_x = key.tx * sx;
+                *min_y = key.ty * sy;
+                *max_x = *min_x + sx;
+                *max_y = *min_y + sy;
+            }
+
+            /*
+             * Tiles at view's level covering the part of the view inside [min_x, max_x] x
+             * [min_y, max_y], each created empty if it is not cached.
+             */
+            std::vector<TileKey> visible(const plot::View& view, double min_x, double max_x, double min_y, double max_y) {
+                std::vector<TileKey> keys;
+                min_x = std::max(min_x, view.min_x);
+                max_x = std::min(max_x, view.max_x);
+                min_y = std::max(min_y, view.min_y);
+                max_y = std::min(max_y, view.max_y);
+                if (!(view.max_x > view.min_x && view.max_y > view.min_y && max_x > min_x && max_y > min_y)) {
+                    return keys;
+                }
+                int ex, ey;
+                level_of(view, &ex, &ey);
+                double sx = std::ldexp(1.0, ex) * TILE_SAMPLES;
+                double sy = std::ldexp(1.0, ey) * TILE_SAMPLES;
+                long long x0 = (long long) std::floor(min_x / sx), x1 = (long long) std::ceil(max_x / sx);
+                long long y0 = (long long) std::floor(min_y / sy), y1 = (long long) std::ceil(max_y / sy);
+                frame++;
+                for (long long ty = y0; ty < y1; ty++) {
+                    for (long long tx = x0; tx < x1; tx++) {
+                        TileKey key = {ex, ey, tx, ty};
+                        tiles[key].last_used = frame;
+                        keys.push_back(key);
+                    }
+                }
+                evict();
+                return keys;
+            }
+
+            // Switches to slice, dropping every tile if it differs from the current one.
+            void set_slice(const Slice& next) {
+                if (!(next == slice)) {
+                    slice = next;
+                    clear();
+                }
+            }
+
+            void clear() {
+                tiles.clear();
+            }
+
+            const Tile* find(const TileKey& key) const {
+                auto it = tiles.find(key);
+                return it == tiles.end() ? nullptr : &it->second;
+            }
+
+            /*
+             * Runs the next pass on the visible tiles with the fewest passes, up to about
+             * sample_budget new samples, tiles in parallel on pool. Returns whether
+             * anything is left to refine. The objective may be called from several
+             * threads at once, as it is when stepping with n_threads > 1. Objective is
+             * anything BasicPSO accepts.
+             */
+            template<typename Objective>
+            bool refine(const Objective& objective, AppConfig* config, const std::vector<TileKey>& keys,
+                        std::size_t sample_budget, ThreadPool* pool) {
+                std::vector<Tile*> batch;
+                std::vector<TileKey> batch_keys;
+                std::size_t samples = 0;
+                for (int pass = 0; pass < PASSES && samples < sample_budget; pass++) {
+                    for (const TileKey& key : keys) {
+                        Tile& tile = tiles[key];
+                        if (tile.passes != pass || samples >= sample_budget) {
+                            continue;
+                        }
+                        int stride = COARSEST_STRIDE >> pass;
+                        samples += (std::size_t) (TILE_SAMPLES / stride) * (TILE_SAMPLES / stride);
+                        batch.push_back(&tile);
+                        batch_keys.push_back(key);
+                    }
+                }
+                if (batch.empty()) {
+                    return false;
+                }
+                if (columns.size() < batch.size()) {
+                    columns.resize(batch.size());
+                    fitness.resize(batch.size());
+                }
+
+                auto run_tile = [&](int begin, int end) {
+                    for (int b = begin; b < end; b++) {
+                        refine_tile(objective, config, batch_keys[b], *batch[b], columns[b], fitness[b]);
+                    }
+                };
+                if (pool == nullptr || batch.size() == 1) {
+                    run_tile(0, (int) batch.size());
+                } else {
+                    pool->parallel_for(0, (int) batch.size(), 1, run_tile);
+                }
+                for (const TileKey& key : keys) {
+                    if (tiles[key].passes < PASSES) {
+                        return true;
+                    }
+                }
+                return false;
+            }
+
+        private:
+            /*
+             * One pass: evaluates the samples on this pass's stride that no earlier pass
+             * took (all of them on the first) and copies each over its stride x stride block.
+             */
+            template<typename Objective>
+            void refine_tile(const Objective& objective, AppConfig* config, const TileKey& key, Tile& tile,
+                             pso::AlignedVector<double>& cols, pso::AlignedVector<double>& out) const {
+                int pass = tile.passes;
+                int stride = COARSEST_STRIDE >> pass;
+                int per_side = TILE_SAMPLES / stride;
+                std::size_t count = (std::size_t) per_side * per_side;
+                int dimensions = std::max(slice.dimensions, std::max(slice.dim_x, slice.dim_y) + 1);
+                cols.resize(count * dimensions);
+                out.resize(count);
+
+                double spacing_x = std::ldexp(1.0, key.ex), spacing_y = std::ldexp(1.0, key.ey);
+                double origin_x = key.tx * TILE_SAMPLES * spacing_x, origin_y = key.ty * TILE_SAMPLES * spacing_y;
+                std::vector<int> cells;
+                std::size_t n = 0;
+                for (int j = 0; j < TILE_SAMPLES; j += stride) {
+                    for (int i = 0; i < TILE_SAMPLES; i += stride) {
+                        bool done = pass > 0 && i % (2 * stride) == 0 && j % (2 * stride) == 0;
+                        if (done) {
+                            continue;
+                        }
+                        for (int d = 0; d < dimensions; d++) {
+                            double value = d < (int) slice.origin.size() ? slice.origin[d] : 0.0;
+                            if (d == slice.dim_x) {
+                                value = origin_x + (i + 0.5) * spacing_x;
+                            }
+                            if (d == slice.dim_y) {
+                                value = origin_y + (j + 0.5) * spacing_y;
+                            }
+                            cols[d * count + n] = value;
+                        }
+                        cells.push_back(j * TILE_SAMPLES + i);
+                        n++;
+                    }
+                }
+                objective(Points(cols.data(), count, n, dimensions), Span<double>(out.data(), n), config);
+
+                if (tile.values.empty()) {
+                    tile.values.assign((std::size_t) TILE_SAMPLES * TILE_SAMPLES, 0.0f);
+                }
+                for (std::size_t s = 0; s < n; s++) {
+                    int i = cells[s] % TILE_SAMPLES, j = cells[s] / TILE_SAMPLES;
+                    float value = (float) out[s];
+                    for (int y = j; y < j + stride; y++) {
+                        std::fill(tile.values.begin() + y * TILE_SAMPLES + i,
+                                  tile.values.begin() + y * TILE_SAMPLES + i + stride, value);
+                    }
+                }
+                auto range = std::minmax_element(tile.values.begin(), tile.values.end());
+                tile.min_value = *range.first;
+                tile.max_value = *range.second;
+                tile.passes++;
+                tile.version++;
+            }
+        };
+    }
+}
+#endif //LANDSCAPE_H
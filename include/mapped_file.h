@@ -0,0 +1,145 @@
+//
+// Read-only memory mapping of a whole file (POSIX mmap / Win32 file mapping).
+//
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <utility>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace algos {
+    class MappedFile {
+    private:
+        const std::uint8_t* ptr = nullptr;
+        std::size_t length = 0;
+#ifdef _WIN32
+        HANDLE file = INVALID_HANDLE_VALUE;
+        HANDLE mapping = nullptr;
+#endif
+
+    public:
+        MappedFile() = default;
+
+        ~MappedFile() {
+            close();
+        }
+
+        MappedFile(const MappedFile&) = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+
+        MappedFile(MappedFile&& other) noexcept {
+            *this = std::move(other);
+        }
+
+        MappedFile& operator=(MappedFile&& other) noexcept {
+            if (this != &other) {
+                close();
+                ptr = other.ptr;
+                length = other.length;
+                other.ptr = nullptr;
+                other.length = 0;
+#ifdef _WIN32
+                file = other.file;
+                mapping = other.mapping;
+                other.file = INVALID_HANDLE_VALUE;
+                other.mapping = nullptr;
+#endif
+            }
+            return *this;
+        }
+
+        // Maps the whole file read-only. Returns false (and stays closed) on failure.
+        bool open(const std::string& path) {
+            close();
+#ifdef _WIN32
+            file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                               FILE_ATTRIBUTE_NORMAL, nullptr);
+            if (file == INVALID_HANDLE_VALUE) {
+                return false;
+            }
+            LARGE_INTEGER file_size;
+            if (!GetFileSizeEx(file, &file_size) || file_size.QuadPart == 0) {
+                close();
+                return false;
+            }
+            mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+            if (mapping == nullptr) {
+                close();
+                return false;
+            }
+            ptr = static_cast<const std::uint8_t*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+            if (ptr == nullptr) {
+                close();
+                return false;
+            }
+            length = (std::size_t) file_size.QuadPart;
+#else
+            int fd = ::open(path.c_str(), O_RDONLY);
+            if (fd < 0) {
+                return false;
+            }
+            struct stat info{};
+            if (fstat(fd, &info) != 0 || info.st_size == 0) {
+                ::close(fd);
+                return false;
+            }
+            void* mapped = mmap(nullptr, (std::size_t) info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            ::close(fd);
+            if (mapped == MAP_FAILED) {
+                return false;
+            }
+            ptr = static_cast<const std::uint8_t*>(mapped);
+            length = (std::size_t) info.st_size;
+#endif
+            return true;
+        }
+
+        void close() {
+#ifdef _WIN32
+            if (ptr != nullptr) {
+                UnmapViewOfFile(ptr);
+            }
+            if (mapping != nullptr) {
+                CloseHandle(mapping);
+            }
+            if (file != INVALID_HANDLE_VALUE) {
+                CloseHandle(file);
+            }
+            mapping = nullptr;
+            file = INVALID_HANDLE_VALUE;
+#else
+            if (ptr != nullptr) {
+                munmap(const_cast<std::uint8_t*>(ptr), length);
+            }
+#endif
+            ptr = nullptr;
+            length = 0;
+        }
+
+        bool is_open() const {
+            return ptr != nullptr;
+        }
+
+        const std::uint8_t* data() const {
+            return ptr;
+        }
+
+        std::size_t size() const {
+            return length;
+        }
+    };
+}
+#endif //MAPPED_FILE_H
@@ -0,0 +1,358 @@
+//
+// Local-best topologies: which particles each particle learns from, and the
+// k-d tree that finds spatial neighbours.
+//
+#ifndef NEIGHBOURHOOD_H
+#define NEIGHBOURHOOD_H
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <string>
+#include <vector>
+
+#include "swarm.h"
+#include "thread_pool.h"
+
+namespace algos {
+    namespace neighbourhood {
+        enum Topology {
+            // Everyone follows the global best.
+            TOPOLOGY_GLOBAL = 0,
+            // Particle i follows the best of i - 1, i and i + 1, wrapping around.
+            TOPOLOGY_RING = 1,
+            // Particles sit on a wrapping grid in index order and follow the best of themselves and
+            // their four grid neighbours.
+            TOPOLOGY_VON_NEUMANN = 2,
+            // Each particle follows the best of the k particles nearest to it, itself included.
+            TOPOLOGY_NEAREST = 3,
+        };
+
+        inline bool parse_topology(const std::string& name, Topology* out) {
+            if (name == "global") {
+                *out = TOPOLOGY_GLOBAL;
+            } else if (name == "ring") {
+                *out = TOPOLOGY_RING;
+            } else if (name == "von-neumann") {
+                *out = TOPOLOGY_VON_NEUMANN;
+            } else if (name == "nearest") {
+                *out = TOPOLOGY_NEAREST;
+            } else {
+                return false;
+            }
+            return true;
+        }
+
+        inline const char* topology_name(Topology topology) {
+            switch (topology) {
+                case TOPOLOGY_RING: return "ring";
+                case TOPOLOGY_VON_NEUMANN: return "von-neumann";
+                case TOPOLOGY_NEAREST: return "nearest";
+                default: return "global";
+            }
+        }
+
+        // The better of two particles by personal best, the lower index on ties.
+        inline int better(const pso::Swarm& swarm, int a, int b) {
+            return swarm.best_fitness[b] < swarm.best_fitness[a] ||
+                   (swarm.best_fitness[b] == swarm.best_fitness[a] && b < a) ? b : a;
+        }
+
+        /*
+         * A k-d tree over every coordinate, split at the median of the widest coordinate
+         * so every leaf holds at most LEAF_SIZE + 1 particles. The tree is implicit: node
+         * 1 is the root, node i has children 2i and 2i + 1, and nodes from first_leaf on
+         * are leaves. Building it depends only on the swarm, never on the thread count.
+         *
+         * The coordinates and personal best fitness are copied out in leaf order, so a
+         * search reads each leaf's particles from contiguous memory rather than chasing
+         * indices across the whole swarm. Searches refer to particles by that order, their
+         * slot; particle() maps a slot back.
+         */
+        class KdTree {
+        public:
+            // A subtree still to be searched and a lower bound on the squared distance to anything in it.
+            struct Branch {
+                double bound;
+                int node;
+            };
+
+        private:
+            static constexpr int LEAF_SIZE = 8;
+            // Levels split on the calling thread before the subtrees are handed to the pool.
+            static constexpr int SERIAL_LEVELS = 6;
+            // The widest coordinate of a larger node is judged from this many of its particles.
+            static constexpr int SPREAD_SAMPLE = 1024;
+            // A search examines at most max(MIN_CHECKS, CHECKS_PER_NEIGHBOUR * k) particles.
+            static constexpr int MIN_CHECKS = 128;
+            static constexpr int CHECKS_PER_NEIGHBOUR = 16;
+
+            int first_leaf = 1;
+            // Slots of node i are [node_begin[i], node_end[i]).
+            std::vector<int> node_begin;
+            std::vector<int> node_end;
+            std::vector<int> split_dimension;
+            std::vector<double> split_value;
+            std::vector<int> order;
+            // Coordinate d of the particle in slot s at sorted[s * dimensions + d], and its personal best fitness.
+            pso::AlignedVector<double> sorted;
+            int n_dimensions = 0;
+            std::vector<double> sorted_fitness;
+
+            // Splits node at the median of its widest coordinate, ties broken by particle index.
+            void split(const pso::Swarm& swarm, int node) {
+                int begin = node_begin[node], end = node_end[node];
+                int step = std::max(1, (end - begin) / SPREAD_SAMPLE);
+                int widest = 0;
+                double widest_spread = -1;
+                for (int d = 0; d < swarm.dimensions; d++) {
+                    const double* x = swarm.column(d);
+                    double low = x[order[begin]], high = low;
+                    for (int s = begin; s < end; s += step) {
+                        low = std::min(low, x[order[s]]);
+                        high = std::max(high, x[order[s]]);
+                    }
+                    if (high - low > widest_spread) {
+                        widest = d;
+                        widest_spread = high - low;
+                    }
+                }
+                const double* x = swarm.column(widest);
+                int middle = begin + (end - begin) / 2;
+                std::nth_element(order.begin() + begin, order.begin() + middle, order.begin() + end,
+                                 [x](int a, int b) { return x[a] < x[b] || (x[a] == x[b] && a < b); });
+                split_dimension[node] = widest;
+                split_value[node] = x[order[middle]];
+                node_begin[2 * node] = begin;
+                node_end[2 * node] = middle;
+                node_begin[2 * node + 1] = middle;
+                node_end[2 * node + 1] = end;
+            }
+
+            void split_subtree(const pso::Swarm& swarm, int node) {
+                if (node >= first_leaf) {
+                    return;
+                }
+                split(swarm, node);
+                split_subtree(swarm, 2 * node);
+                split_subtree(swarm, 2 * node + 1);
+            }
+
+        public:
+            void build(const pso::Swarm& swarm, ThreadPool* pool) {
+                int n = swarm.size();
+                int depth = 0;
+                while ((n >> depth) > LEAF_SIZE) {
+                    depth++;
+                }
+                first_leaf = 1 << depth;
+                node_begin.resize((std::size_t) 2 * first_leaf);
+                node_end.resize((std::size_t) 2 * first_leaf);
+                split_dimension.resize(first_leaf);
+                split_value.resize(first_leaf);
+                order.resize(n);
+                for (int i = 0; i < n; i++) {
+                    order[i] = i;
+                }
+                node_begin[1] = 0;
+                node_end[1] = n;
+                // The top levels level by level here, then each subtree below them as a task of its own.
+                int serial_levels = std::min(depth, SERIAL_LEVELS);
+                for (int node = 1; node < (1 << serial_levels); node++) {
+                    split(swarm, node);
+                }
+                int subtrees = 1 << serial_levels;
+                run(pool, subtrees, 1, [&](int begin, int end) {
+                    for (int t = begin; t < end; t++) {
+                        split_subtree(swarm, subtrees + t);
+                    }
+                });
+
+                const int grain = 1 << 14;
+                sorted.resize((std::size_t) n * swarm.dimensions);
+                sorted_fitness.resize(n);
+                n_dimensions = swarm.dimensions;
+                run(pool, n, grain, [&](int begin, int end) {
+                    for (int d = 0; d < swarm.dimensions; d++) {
+                        const double* x = swarm.column(d);
+                        double* out = sorted.data() + d;
+                        for (int s = begin; s < end; s++) {
+                            out[(std::size_t) s * swarm.dimensions] = x[order[s]];
+                        }
+                    }
+                    for (int s = begin; s < end; s++) {
+                        sorted_fitness[s] = swarm.best_fitness[order[s]];
+                    }
+                });
+            }
+
+            int particle(int slot) const {
+                return order[slot];
+            }
+
+            double fitness(int slot) const {
+                return sorted_fitness[slot];
+            }
+
+            /*
+             * The slots of the k particles nearest to the one in slot, itself included, into
+             * out, nearest first with ties in particle order. Leaves are searched nearest
+             * bound first, and the search stops once no unsearched leaf can hold anything
+             * nearer than the k-th found, which makes it exact. It also stops after examining
+             * a fixed number of particles, so a query costs O(log n) however the swarm is
+             * spread; in many dimensions, where the bound rarely closes early, the result is
+             * then approximate: the nearest among the leaves closest to the particle.
+             * queue is scratch, reused between calls. Returns how many were found, fewer than
+             * k only in a smaller swarm.
+             */
+            int nearest(int slot, int k, int* out, double* out_distance, std::vector<Branch>* queue) const {
+                int found = 0;
+                int checks = 0;
+                int max_checks = std::max(MIN_CHECKS, CHECKS_PER_NEIGHBOUR * k);
+                const double* point = sorted.data() + (std::size_t) slot * n_dimensions;
+                auto farther = [](const Branch& a, const Branch& b) {
+                    return a.bound > b.bound || (a.bound == b.bound && a.node > b.node);
+                };
+                auto consider = [&](int s) {
+                    double worst = found == k ? out_distance[k - 1] : std::numeric_limits<double>::infinity();
+                    double distance = 0;
+                    const double* other = sorted.data() + (std::size_t) s * n_dimensions;
+                    for (int d = 0; d < n_dimensions && distance <= worst; d++) {
+                        double delta = other[d] - point[d];
+                        distance += delta * delta;
+                    }
+                    if (found == k && (distance > worst || (distance == worst && order[s] > order[out[k - 1]]))) {
+                        return;
+                    }
+                    int at = found < k ? found++ : k - 1;
+                    while (at > 0 && (out_distance[at - 1] > distance ||
+                                      (out_distance[at - 1] == distance && order[out[at - 1]] > order[s]))) {
+                        out[at] = out[at - 1];
+                        out_distance[at] = out_distance[at - 1];
+                        at--;
+                    }
+                    out[at] = s;
+                    out_distance[at] = distance;
+                };
+                queue->clear();
+                queue->push_back({0.0, 1});
+                while (!queue->empty()) {
+                    std::pop_heap(queue->begin(), queue->end(), farther);
+                    Branch branch = queue->back();
+                    queue->pop_back();
+                    // Equal distances still matter, a lower particle index wins the tie.
+                    if (found == k && (branch.bound > out_distance[k - 1] || checks >= max_checks)) {
+                        break;
+                    }
+                    int node = branch.node;
+                    while (node < first_leaf) {
+                        double delta = point[split_dimension[node]] - split_value[node];
+                        int near = delta < 0 ? 2 * node : 2 * node + 1;
+                        double bound = std::max(branch.bound, delta * delta);
+                        if (found < k || bound <= out_distance[k - 1]) {
+                            queue->push_back({bound, near ^ 1});
+                            std::push_heap(queue->begin(), queue->end(), farther);
+                        }
+                        node = near;
+                    }
+                    for (int s = node_begin[node]; s < node_end[node]; s++) {
+                        consider(s);
+                    }
+                    checks += node_end[node] - node_begin[node];
+                }
+                return found;
+            }
+
+            template<typename Body>
+            static void run(ThreadPool* pool, int n, int grain, const Body& body) {
+                if (pool == nullptr || n <= grain) {
+                    for (int begin = 0; begin < n; begin += grain) {
+                        body(begin, std::min(n, begin + grain));
+                    }
+                    return;
+                }
+                pool->parallel_for(0, n, grain, [&body](int begin, int end) { body(begin, end); });
+            }
+        };
+
+        /*
+         * Fills social, laid out like the swarm's positions, with each particle's
+         * neighbourhood best: the personal best of the best particle in its
+         * neighbourhood. Each particle only writes its own slots, so the pass needs no
+         * lock and its outcome does not depend on the thread count.
+         */
+        class Neighbourhoods {
+        private:
+            KdTree tree;
+            // Per-chunk scratch for nearest-neighbour queries.
+            std::vector<std::vector<int>> chunk_indices;
+            std::vector<std::vector<double>> chunk_distances;
+            std::vector<std::vector<KdTree::Branch>> chunk_queues;
+
+        public:
+            void compute(const pso::Swarm& swarm, Topology topology, int k, pso::AlignedVector<double>* social,
+                         ThreadPool* pool) {
+                int n = swarm.size();
+                social->resize(swarm.position.size());
+                if (n == 0) {
+                    return;
+                }
+                int grid_cols = std::max(1, (int) std::ceil(std::sqrt((double) n)));
+                k = std::clamp(k, 1, n);
+                if (topology == TOPOLOGY_NEAREST) {
+                    tree.build(swarm, pool);
+                }
+                const int grain = 1 << 10;
+                int chunks = (n + grain - 1) / grain;
+                chunk_indices.resize(chunks);
+                chunk_distances.resize(chunks);
+                chunk_queues.resize(chunks);
+
+                KdTree::run(pool, n, grain, [&](int begin, int end) {
+                    std::vector<int>& indices = chunk_indices[begin / grain];
+                    std::vector<double>& distances = chunk_distances[begin / grain];
+                    std::vector<KdTree::Branch>& queue = chunk_queues[begin / grain];
+                    indices.resize(k);
+                    distances.resize(k);
+                    for (int position = begin; position < end; position++) {
+                        // Nearest neighbours are found in the tree's leaf order, so consecutive searches share leaves.
+                        int i = position;
+                        int best = i;
+                        if (topology == TOPOLOGY_NEAREST) {
+                            int found = tree.nearest(position, k, indices.data(), distances.data(), &queue);
+                            int best_slot = position;
+                            for (int f = 0; f < found; f++) {
+                                int s = indices[f];
+                                if (tree.fitness(s) < tree.fitness(best_slot) ||
+                                    (tree.fitness(s) == tree.fitness(best_slot) && tree.particle(s) < tree.particle(best_slot))) {
+                                    best_slot = s;
+                                }
+                            }
+                            i = tree.particle(position);
+                            best = tree.particle(best_slot);
+                        } else if (topology == TOPOLOGY_RING) {
+                            best = better(swarm, best, (i + n - 1) % n);
+                            best = better(swarm, best, (i + 1) % n);
+                        } else if (topology == TOPOLOGY_VON_NEUMANN) {
+                            int row = i / grid_cols, col = i % grid_cols;
+                            int grid_rows = (n + grid_cols - 1) / grid_cols;
+                            int around[4] = {((row + grid_rows - 1) % grid_rows) * grid_cols + col,
+                                             ((row + 1) % grid_rows) * grid_cols + col,
+                                             row * grid_cols + (col + grid_cols - 1) % grid_cols,
+                                             row * grid_cols + (col + 1) % grid_cols};
+                            for (int j : around) {
+                                // The last grid row may be short, its gaps have no particle.
+                                if (j < n) {
+                                    best = better(swarm, best, j);
+                                }
+                            }
+                        }
+                        for (int d = 0; d < swarm.dimensions; d++) {
+                            (*social)[d * swarm.stride + i] = swarm.best_column(d)[best];
+                        }
+                    }
+                });
+            }
+        };
+    }
+}
+#endif //NEIGHBOURHOOD_H
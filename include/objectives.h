@@ -0,0 +1,194 @@
+//
+// Objective functions shared by the GUI, the headless runner and the benchmarks.
+//
+#ifndef OBJECTIVES_H
+#define OBJECTIVES_H
+#include <algorithm>
+#include <cmath>
+
+#include "searchers.h"
+
+namespace algos {
+    namespace objectives {
+        /*
+         * Fitness function, the lower the better
+         * hence why we use the euclidean distance
+         */
+        inline double euclidean(double x, double y, AppConfig* config) {
+            return std::sqrt(std::pow(x - config->goal_x, 2) + std::pow(y - config->goal_y, 2));
+        }
+
+        // Goal coordinate for dimension d: goal_x, goal_y, then the origin.
+        inline double goal_coordinate(const AppConfig* config, int d) {
+            return d == 0 ? config->goal_x : d == 1 ? config->goal_y : 0.0;
+        }
+
+        /*
+         * Batch form of euclidean() in any number of dimensions, written so the
+         * compiler can vectorise it. The squares are summed into fitness column by
+         * column, which in two dimensions is exactly euclidean().
+         */
+        inline void euclidean_batch(Points points, Span<double> fitness, AppConfig* config) {
+            double* out = fitness.data();
+            std::size_t n = fitness.size();
+            for (std::size_t i = 0; i < n; i++) {
+                out[i] = 0;
+            }
+            for (int d = 0; d < points.dimensions(); d++) {
+                const double goal = goal_coordinate(config, d);
+                const double* x = points.column(d);
+                for (std::size_t i = 0; i < n; i++) {
+                    double dx = x[i] - goal;
+                    out[i] += dx * dx;
+                }
+            }
+            for (std::size_t i = 0; i < n; i++) {
+                out[i] = std::sqrt(out[i]);
+            }
+        }
+
+        // euclidean_batch() as a type, so BasicPSO<Euclidean> inlines it into the step.
+        struct Euclidean {
+            void operator()(Points points, Span<double> fitness, AppConfig* config) const {
+                euclidean_batch(points, fitness, config);
+            }
+        };
+
+        /*
+         * Standard test landscapes, global minimum 0 at the origin (Rosenbrock at 1, ..., 1).
+         * They ignore the goal. Each works on blocks of points so its per-point sums stay
+         * in small arrays the compiler can vectorise.
+         */
+        constexpr std::size_t OBJECTIVE_BLOCK = 256;
+        constexpr double PI = 3.14159265358979323846;
+
+        inline void sphere_batch(Points points, Span<double> fitness, AppConfig*) {
+            double* out = fitness.data();
+            std::size_t n = fitness.size();
+            for (std::size_t i = 0; i < n; i++) {
+                out[i] = 0;
+            }
+            for (int d = 0; d < points.dimensions(); d++) {
+                const double* x = points.column(d);
+                for (std::size_t i = 0; i < n; i++) {
+                    out[i] += x[i] * x[i];
+                }
+            }
+        }
+
+        inline void rastrigin_batch(Points points, Span<double> fitness, AppConfig*) {
+            double* out = fitness.data();
+            std::size_t n = fitness.size();
+            for (std::size_t i = 0; i < n; i++) {
+                out[i] = 10.0 * points.dimensions();
+            }
+            for (int d = 0; d < points.dimensions(); d++) {
+                const double* x = points.column(d);
+                for (std::size_t i = 0; i < n; i++) {
+                    out[i] += x[i] * x[i] - 10.0 * std::cos(2 * PI * x[i]);
+                }
+            }
+        }
+
+        // Sum over consecutive pairs of dimensions, so one dimension only keeps the (1 - x)^2 term.
+        inline void rosenbrock_batch(Points points, Span<double> fitness, AppConfig*) {
+            double* out = fitness.data();
+            std::size_t n = fitness.size();
+            int dimensions = points.dimensions();
+            for (std::size_t i = 0; i < n; i++) {
+                out[i] = 0;
+            }
+            if (dimensions == 1) {
+                const double* x = points.column(0);
+                for (std::size_t i = 0; i < n; i++) {
+                    out[i] = (1 - x[i]) * (1 - x[i]);
+                }
+                return;
+            }
+            for (int d = 0; d + 1 < dimensions; d++) {
+                const double* x = points.column(d);
+                const double* next = points.column(d + 1);
+                for (std::size_t i = 0; i < n; i++) {
+                    double valley = next[i] - x[i] * x[i];
+                    out[i] += 100 * valley * valley + (1 - x[i]) * (1 - x[i]);
+                }
+            }
+        }
+
+        inline void ackley_batch(Points points, Span<double> fitness, AppConfig*) {
+            double* out = fitness.data();
+            int dimensions = points.dimensions();
+            for (std::size_t begin = 0; begin < fitness.size(); begin += OBJECTIVE_BLOCK) {
+                std::size_t count = std::min(OBJECTIVE_BLOCK, fitness.size() - begin);
+                double squares[OBJECTIVE_BLOCK] = {};
+                double cosines[OBJECTIVE_BLOCK] = {};
+                for (int d = 0; d < dimensions; d++) {
+                    const double* x = points.column(d) + begin;
+                    for (std::size_t i = 0; i < count; i++) {
+                        squares[i] += x[i] * x[i];
+                        cosines[i] += std::cos(2 * PI * x[i]);
+                    }
+                }
+                for (std::size_t i = 0; i < count; i++) {
+                    out[begin + i] = -20 * std::exp(-0.2 * std::sqrt(squares[i] / dimensions)) -
+                                     std::exp(cosines[i] / dimensions) + 20 + std::exp(1.0);
+                }
+            }
+        }
+
+        inline void griewank_batch(Points points, Span<double> fitness, AppConfig*) {
+            double* out = fitness.data();
+            int dimensions = points.dimensions();
+            for (std::size_t begin = 0; begin < fitness.size(); begin += OBJECTIVE_BLOCK) {
+                std::size_t count = std::min(OBJECTIVE_BLOCK, fitness.size() - begin);
+                double squares[OBJECTIVE_BLOCK] = {};
+                double product[OBJECTIVE_BLOCK];
+                for (std::size_t i = 0; i < count; i++) {
+                    product[i] = 1;
+                }
+                for (int d = 0; d < dimensions; d++) {
+                    const double* x = points.column(d) + begin;
+                    const double scale = 1.0 / std::sqrt((double) (d + 1));
+                    for (std::size_t i = 0; i < count; i++) {
+                        squares[i] += x[i] * x[i];
+                        product[i] *= std::cos(x[i] * scale);
+                    }
+                }
+                for (std::size_t i = 0; i < count; i++) {
+                    out[begin + i] = 1 + squares[i] / 4000 - product[i];
+                }
+            }
+        }
+
+        struct Sphere {
+            void operator()(Points points, Span<double> fitness, AppConfig* config) const {
+                sphere_batch(points, fitness, config);
+            }
+        };
+
+        struct Rastrigin {
+            void operator()(Points points, Span<double> fitness, AppConfig* config) const {
+                rastrigin_batch(points, fitness, config);
+            }
+        };
+
+        struct Rosenbrock {
+            void operator()(Points points, Span<double> fitness, AppConfig* config) const {
+                rosenbrock_batch(points, fitness, config);
+            }
+        };
+
+        struct Ackley {
+            void operator()(Points points, Span<double> fitness, AppConfig* config) const {
+                ackley_batch(points, fitness, config);
+            }
+        };
+
+        struct Griewank {
+            void operator()(Points points, Span<double> fitness, AppConfig* config) const {
+                griewank_batch(points, fitness, config);
+            }
+        };
+    }
+}
+#endif //OBJECTIVES_H
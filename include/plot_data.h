@@ -0,0 +1,121 @@
+//
+// Reduces a large swarm to what a plot of a given pixel size can show.
+//
+#ifndef PLOT_DATA_H
+#define PLOT_DATA_H
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "thread_pool.h"
+
+namespace algos {
+    namespace plot {
+        // The visible rectangle of the plot and its size in pixels.
+        struct View {
+            double min_x = 0;
+            double max_x = 1;
+            double min_y = 0;
+            double max_y = 1;
+            int width = 1;
+            int height = 1;
+
+            bool operator==(const View& other) const {
+                return min_x == other.min_x && max_x == other.max_x && min_y == other.min_y &&
+                       max_y == other.max_y && width == other.width && height == other.height;
+            }
+
+            bool operator!=(const View& other) const {
+                return !(*this == other);
+            }
+        };
+
+        // Cell of (x, y) on a cols x rows grid over the view, -1 when it falls outside.
+        inline long long cell_of(const View& view, int cols, int rows, double x, double y) {
+            double u = (x - view.min_x) / (view.max_x - view.min_x);
+            double v = (y - view.min_y) / (view.max_y - view.min_y);
+            if (!(u >= 0 && u < 1 && v >= 0 && v < 1)) {
+                return -1;
+            }
+            return (long long) (v * rows) * cols + (long long) (u * cols);
+        }
+
+        /*
+         * Screen-space decimation: keeps the first point, in particle order, landing on
+         * each pixel of the view and drops the rest, along with points off screen. What
+         * is drawn looks the same, but there are never more points than pixels.
+         */
+        inline void decimate(const double* xs, const double* ys, std::size_t n, const View& view,
+                             std::vector<double>* out_x, std::vector<double>* out_y, std::vector<std::uint64_t>* seen) {
+            int width = std::max(1, view.width);
+            int height = std::max(1, view.height);
+            seen->assign(((std::size_t) width * height + 63) / 64, 0);
+            out_x->clear();
+            out_y->clear();
+            for (std::size_t i = 0; i < n; i++) {
+                long long pixel = cell_of(view, width, height, xs[i], ys[i]);
+                if (pixel < 0) {
+                    continue;
+                }
+                std::uint64_t bit = 1ull << (pixel & 63);
+                std::uint64_t& word = (*seen)[pixel >> 6];
+                if ((word & bit) == 0) {
+                    word |= bit;
+                    out_x->push_back(xs[i]);
+                    out_y->push_back(ys[i]);
+                }
+            }
+        }
+
+        /*
+         * Counts the points in each cell of a cols x rows grid over the view, row 0 at
+         * the top as ImPlot::PlotHeatmap draws it. Chunks bin into histograms of their
+         * own that are then summed, so there is no contention and the counts are exact.
+         * Returns the largest count.
+         */
+        inline float bin_density(const double* xs, const double* ys, std::size_t n, const View& view, int cols, int rows,
+                                 std::vector<float>* counts, ThreadPool* pool) {
+            std::size_t cells = (std::size_t) cols * rows;
+            // Enough points per chunk that summing the histograms stays cheap next to filling them.
+            int grain = (int) std::max<std::size_t>(cells * 4, 1 << 16);
+            int chunks = (int) ((n + grain - 1) / grain);
+            std::vector<std::vector<std::uint32_t>> partial(std::max(1, chunks));
+            auto bin = [&](int begin, int end) {
+                std::vector<std::uint32_t>& histogram = partial[begin / grain];
+                histogram.assign(cells, 0);
+                for (int i = begin; i < end; i++) {
+                    long long cell = cell_of(view, cols, rows, xs[i], ys[i]);
+                    if (cell >= 0) {
+                        // Flip vertically, heatmap rows run top to bottom.
+                        long long row = rows - 1 - cell / cols;
+                        histogram[row * cols + cell % cols]++;
+                    }
+                }
+            };
+            if (pool == nullptr || chunks <= 1) {
+                for (int begin = 0; begin < (int) n; begin += grain) {
+                    bin(begin, (int) std::min<std::size_t>(n, (std::size_t) begin + grain));
+                }
+            } else {
+                pool->parallel_for(0, (int) n, grain, bin);
+            }
+
+            std::vector<std::uint32_t>& total = partial[0];
+            total.resize(cells);
+            for (int chunk = 1; chunk < chunks; chunk++) {
+                for (std::size_t c = 0; c < cells; c++) {
+                    total[c] += partial[chunk][c];
+                }
+            }
+            counts->resize(cells);
+            float max_count = 0;
+            for (std::size_t c = 0; c < cells; c++) {
+                (*counts)[c] = (float) total[c];
+                max_count = std::max(max_count, (*counts)[c]);
+            }
+            return max_count;
+        }
+    }
+}
+#endif //PLOT_DATA_H
@@ -0,0 +1,237 @@
+//
+// Loads objective plugins (see pso_plugin.h) and adapts them to the batch objective interface.
+//
+#ifndef PLUGIN_H
+#define PLUGIN_H
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <system_error>
+#include <utility>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <dlfcn.h>
+#endif
+
+#include "searchers.h"
+#include "pso_plugin.h"
+
+namespace algos {
+    namespace plugin {
+        // The run's settings as plugins and worker processes see them.
+        inline PsoPluginContext context_of(const AppConfig* config) {
+            return {config->goal_x, config->goal_y, (double) config->min_x, (double) config->max_x,
+                    (double) config->min_y, (double) config->max_y};
+        }
+
+        /*
+         * A shared library opened from a private copy, so the original can be rebuilt
+         * while it is loaded and a reload always gets a fresh image. The copy is
+         * deleted again on close.
+         */
+        class Library {
+        private:
+#ifdef _WIN32
+            HMODULE handle = nullptr;
+#else
+            void* handle = nullptr;
+#endif
+            std::string copy_path;
+
+            static std::string next_copy_path(const std::filesystem::path& original) {
+                static std::atomic<unsigned> counter{0};
+                auto stamp = std::chrono::steady_clock::now().time_since_epoch().count();
+                return (std::filesystem::temp_directory_path() /
+                        ("pso_plugin_" + std::to_string(stamp) + "_" + std::to_string(counter++) + "_" +
+                         original.filename().string())).string();
+            }
+
+        public:
+            Library() = default;
+
+            ~Library() {
+                close();
+            }
+
+            Library(const Library&) = delete;
+            Library& operator=(const Library&) = delete;
+
+            // Returns false, with the reason in error, if the library could not be copied or opened.
+            bool open(const std::string& path, std::string* error) {
+                close();
+                std::error_code ec;
+                std::string copy = next_copy_path(path);
+                if (!std::filesystem::copy_file(path, copy, std::filesystem::copy_options::overwrite_existing, ec)) {
+                    *error = "Error opening file";
+                    return false;
+                }
+#ifdef _WIN32
+                handle = LoadLibraryA(copy.c_str());
+                if (handle == nullptr) {
+                    *error = "Error loading library";
+                }
+#else
+                handle = dlopen(copy.c_str(), RTLD_NOW | RTLD_LOCAL);
+                if (handle == nullptr) {
+                    const char* reason = dlerror();
+                    *error = reason != nullptr ? reason : "Error loading library";
+                }
+#endif
+                if (handle == nullptr) {
+                    std::filesystem::remove(copy, ec);
+                    return false;
+                }
+                copy_path = copy;
+                return true;
+            }
+
+            void* symbol(const char* name) const {
+                if (handle == nullptr) {
+                    return nullptr;
+                }
+#ifdef _WIN32
+                return reinterpret_cast<void*>(GetProcAddress(handle, name));
+#else
+                return dlsym(handle, name);
+#endif
+            }
+
+            void close() {
+                if (handle == nullptr) {
+                    return;
+                }
+#ifdef _WIN32
+                FreeLibrary(handle);
+#else
+                dlclose(handle);
+#endif
+                handle = nullptr;
+                std::error_code ec;
+                std::filesystem::remove(copy_path, ec);
+                copy_path.clear();
+            }
+
+            bool is_open() const {
+                return handle != nullptr;
+            }
+        };
+
+        /*
+         * One plugin file and the library currently loaded from it. reload() swaps in
+         * a rebuilt file; it must not run while evaluate() does, which BasicPSO
+         * guarantees by reloading only in reset().
+         */
+        class ObjectivePlugin {
+        private:
+            std::string path;
+            std::unique_ptr<Library> library;
+            const PsoObjectivePlugin* table = nullptr;
+            std::filesystem::file_time_type loaded_time{};
+
+            // Opens path into a new library and checks its table, leaving this plugin untouched on failure.
+            bool open_table(std::unique_ptr<Library>* out_library, const PsoObjectivePlugin** out_table,
+                            std::string* error) const {
+                auto next = std::make_unique<Library>();
+                if (!next->open(path, error)) {
+                    return false;
+                }
+                auto entry = reinterpret_cast<PsoPluginEntryPoint>(next->symbol(PSO_PLUGIN_ENTRY_POINT));
+                if (entry == nullptr) {
+                    *error = "No " PSO_PLUGIN_ENTRY_POINT " in library";
+                    return false;
+                }
+                const PsoObjectivePlugin* next_table = entry();
+                if (next_table == nullptr || next_table->abi_version != PSO_PLUGIN_ABI_VERSION ||
+                    next_table->struct_size < sizeof(PsoObjectivePlugin) || next_table->evaluate == nullptr) {
+                    *error = "Plugin ABI version does not match, expected " + std::to_string(PSO_PLUGIN_ABI_VERSION);
+                    return false;
+                }
+                *out_library = std::move(next);
+                *out_table = next_table;
+                return true;
+            }
+
+        public:
+            explicit ObjectivePlugin(std::string file) : path(std::move(file)) {}
+
+            bool load(std::string* error) {
+                std::error_code ec;
+                std::filesystem::file_time_type time = std::filesystem::last_write_time(path, ec);
+                if (!open_table(&library, &table, error)) {
+                    return false;
+                }
+                loaded_time = time;
+                return true;
+            }
+
+            /*
+             * Loads the file again if it changed since it was loaded. Returns whether the
+             * objective changed; a rebuilt file that fails to load keeps the old one.
+             */
+            bool reload() {
+                std::error_code ec;
+                std::filesystem::file_time_type time = std::filesystem::last_write_time(path, ec);
+                if (ec || time == loaded_time) {
+                    return false;
+                }
+                std::string error;
+                if (!load(&error)) {
+                    printf("Error reloading plugin %s: %s\n", path.c_str(), error.c_str());
+                    loaded_time = time;
+                    return false;
+                }
+                printf("Reloaded plugin %s\n", path.c_str());
+                return true;
+            }
+
+            std::string name() const {
+                return table != nullptr && table->name != nullptr ? table->name : path;
+            }
+
+            const std::string& file() const {
+                return path;
+            }
+
+            void evaluate(Points points, Span<double> fitness, const AppConfig* config) const {
+                PsoPluginContext context = context_of(config);
+                table->evaluate(points.column(0), points.stride, fitness.size(), points.dimensions(), fitness.data(),
+                                &context);
+            }
+        };
+
+        /*
+         * Batch objective backed by a plugin, one call into the library per batch.
+         * Copies share the plugin, so reloading through one reloads them all.
+         */
+        struct PluginObjective {
+            std::shared_ptr<ObjectivePlugin> plugin;
+
+            void operator()(Points points, Span<double> fitness, AppConfig* config) const {
+                plugin->evaluate(points, fitness, config);
+            }
+
+            bool reload() {
+                return plugin->reload();
+            }
+        };
+
+        // Loads the plugin at path, or returns false with the reason in error.
+        inline bool open_objective(const std::string& path, PluginObjective* out, std::string* error) {
+            auto plugin = std::make_shared<ObjectivePlugin>(path);
+            if (!plugin->load(error)) {
+                return false;
+            }
+            out->plugin = std::move(plugin);
+            return true;
+        }
+    }
+}
+#endif //PLUGIN_H
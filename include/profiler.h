@@ -0,0 +1,279 @@
+//
+// Hot-path instrumentation: scoped timers, counters and latency histograms, with a
+// Chrome trace-event export. The PSO_PROFILE_* macros compile to nothing unless
+// PSO_PROFILE is defined (cmake -DBETTER_PSO_PROFILE=ON).
+//
+#ifndef PROFILER_H
+#define PROFILER_H
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace algos {
+    namespace profile {
+#ifdef PSO_PROFILE
+        constexpr bool ENABLED = true;
+#else
+        constexpr bool ENABLED = false;
+#endif
+        // Distinct timer and counter names a program may use.
+        constexpr int MAX_SITES = 128;
+        // Bucket b counts durations in [2^(b-1), 2^b) microseconds, bucket 0 those under 1us.
+        constexpr int HISTOGRAM_BUCKETS = 32;
+        // Trace events kept per thread while tracing, later ones are dropped.
+        constexpr std::size_t MAX_TRACE_EVENTS = 1 << 20;
+
+        enum SiteKind {
+            SITE_TIMER = 0,
+            SITE_COUNTER = 1,
+        };
+
+        struct SiteStats {
+            const char* name = "";
+            SiteKind kind = SITE_TIMER;
+            // Timers: completed scopes. Counters: the running total.
+            std::uint64_t count = 0;
+            std::uint64_t total_ns = 0;
+            std::uint64_t max_ns = 0;
+            std::array<std::uint64_t, HISTOGRAM_BUCKETS> buckets{};
+        };
+
+        inline int histogram_bucket(std::uint64_t nanoseconds) {
+            std::uint64_t microseconds = nanoseconds / 1000;
+            int bucket = 0;
+            while (microseconds > 0 && bucket < HISTOGRAM_BUCKETS - 1) {
+                microseconds >>= 1;
+                bucket++;
+            }
+            return bucket;
+        }
+
+        inline std::int64_t now_ns() {
+            return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    std::chrono::steady_clock::now().time_since_epoch()).count();
+        }
+
+        /*
+         * Process-wide registry. Each thread records into its own block, under a lock
+         * only readers ever contend for, so recording stays a few tens of nanoseconds.
+         * Blocks outlive their threads, so a report still covers finished pools.
+         */
+        class Profiler {
+        private:
+            struct TraceEvent {
+                int site;
+                std::int64_t start_ns;
+                std::int64_t duration_ns;
+            };
+
+            struct ThreadBlock {
+                std::mutex mutex;
+                int id = 0;
+                std::array<SiteStats, MAX_SITES> stats{};
+                std::vector<TraceEvent> events;
+            };
+
+            mutable std::mutex registry_mutex;
+            std::array<const char*, MAX_SITES> names{};
+            std::array<SiteKind, MAX_SITES> kinds{};
+            std::atomic<int> site_count{0};
+            std::vector<std::unique_ptr<ThreadBlock>> blocks;
+            std::atomic<bool> tracing{false};
+            std::int64_t epoch_ns = now_ns();
+
+            ThreadBlock& local() {
+                thread_local ThreadBlock* block = nullptr;
+                if (block == nullptr) {
+                    std::lock_guard<std::mutex> lock(registry_mutex);
+                    blocks.push_back(std::make_unique<ThreadBlock>());
+                    block = blocks.back().get();
+                    block->id = (int) blocks.size();
+                }
+                return *block;
+            }
+
+        public:
+            static Profiler& instance() {
+                static Profiler profiler;
+                return profiler;
+            }
+
+            // Index of the site called name, registering it the first time. Names must outlive the profiler.
+            int site(const char* name, SiteKind kind) {
+                std::lock_guard<std::mutex> lock(registry_mutex);
+                int count = site_count.load();
+                for (int i = 0; i < count; i++) {
+                    if (std::string(names[i]) == name) {
+                        return i;
+                    }
+                }
+                if (count == MAX_SITES) {
+                    return -1;
+                }
+                names[count] = name;
+                kinds[count] = kind;
+                site_count.store(count + 1);
+                return count;
+            }
+
+            void record(int site, std::int64_t start_ns, std::int64_t duration_ns) {
+                if (site < 0) {
+                    return;
+                }
+                ThreadBlock& block = local();
+                std::lock_guard<std::mutex> lock(block.mutex);
+                SiteStats& stats = block.stats[site];
+                stats.count++;
+                stats.total_ns += duration_ns;
+                stats.max_ns = std::max<std::uint64_t>(stats.max_ns, duration_ns);
+                stats.buckets[histogram_bucket(duration_ns)]++;
+                if (tracing.load(std::memory_order_relaxed) && block.events.size() < MAX_TRACE_EVENTS) {
+                    block.events.push_back({site, start_ns, duration_ns});
+                }
+            }
+
+            void add(int site, std::uint64_t amount) {
+                if (site < 0) {
+                    return;
+                }
+                ThreadBlock& block = local();
+                std::lock_guard<std::mutex> lock(block.mutex);
+                block.stats[site].count += amount;
+            }
+
+            // Every site's totals over all threads, in registration order.
+            std::vector<SiteStats> report() const {
+                std::lock_guard<std::mutex> lock(registry_mutex);
+                int count = site_count.load();
+                std::vector<SiteStats> out(count);
+                for (int i = 0; i < count; i++) {
+                    out[i].name = names[i];
+                    out[i].kind = kinds[i];
+                }
+                for (const auto& block : blocks) {
+                    std::lock_guard<std::mutex> block_lock(block->mutex);
+                    for (int i = 0; i < count; i++) {
+                        const SiteStats& stats = block->stats[i];
+                        out[i].count += stats.count;
+                        out[i].total_ns += stats.total_ns;
+                        out[i].max_ns = std::max(out[i].max_ns, stats.max_ns);
+                        for (int b = 0; b < HISTOGRAM_BUCKETS; b++) {
+                            out[i].buckets[b] += stats.buckets[b];
+                        }
+                    }
+                }
+                return out;
+            }
+
+            // Zeroes every site and drops the trace, the sites stay registered.
+            void reset() {
+                std::lock_guard<std::mutex> lock(registry_mutex);
+                for (const auto& block : blocks) {
+                    std::lock_guard<std::mutex> block_lock(block->mutex);
+                    block->stats.fill(SiteStats());
+                    block->events.clear();
+                }
+                epoch_ns = now_ns();
+            }
+
+            // Keeps every timed scope for write_chrome_trace() from now on.
+            void set_tracing(bool enabled) {
+                tracing.store(enabled);
+            }
+
+            bool is_tracing() const {
+                return tracing.load();
+            }
+
+            /*
+             * Writes the traced scopes as Chrome trace-event JSON (chrome://tracing,
+             * Perfetto), one complete event per scope and the counters' totals at the end.
+             */
+            bool write_chrome_trace(const std::string& filename) const {
+                FILE* file = fopen(filename.c_str(), "w");
+                if (file == nullptr) {
+                    printf("Error opening file\n");
+                    return false;
+                }
+                setvbuf(file, nullptr, _IOFBF, 1 << 20);
+                std::vector<SiteStats> totals = report();
+                std::lock_guard<std::mutex> lock(registry_mutex);
+                fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+                bool first = true;
+                std::int64_t last_ns = 0;
+                for (const auto& block : blocks) {
+                    std::lock_guard<std::mutex> block_lock(block->mutex);
+                    fprintf(file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"thread %d\"}}",
+                            first ? "" : ",\n", block->id, block->id);
+                    first = false;
+                    for (const TraceEvent& event : block->events) {
+                        if (event.start_ns < epoch_ns) {
+                            continue;
+                        }
+                        fprintf(file, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}",
+                                names[event.site], block->id, (event.start_ns - epoch_ns) / 1000.0,
+                                event.duration_ns / 1000.0);
+                        last_ns = std::max(last_ns, event.start_ns + event.duration_ns - epoch_ns);
+                    }
+                }
+                for (const SiteStats& stats : totals) {
+                    if (stats.kind == SITE_COUNTER) {
+                        fprintf(file, ",\n{\"name\":\"%s\",\"ph\":\"C\",\"pid\":1,\"ts\":%.3f,\"args\":{\"total\":%llu}}",
+                                stats.name, last_ns / 1000.0, (unsigned long long) stats.count);
+                    }
+                }
+                fprintf(file, "\n]}\n");
+                if (fclose(file) != 0) {
+                    printf("Error writing file\n");
+                    return false;
+                }
+                return true;
+            }
+        };
+
+        // Times its own lifetime into a timer site.
+        class ScopedTimer {
+        private:
+            int site;
+            std::int64_t start;
+
+        public:
+            explicit ScopedTimer(int timer_site) : site(timer_site), start(now_ns()) {}
+
+            ~ScopedTimer() {
+                Profiler::instance().record(site, start, now_ns() - start);
+            }
+
+            ScopedTimer(const ScopedTimer&) = delete;
+            ScopedTimer& operator=(const ScopedTimer&) = delete;
+        };
+    }
+}
+
+#define PSO_PROFILE_JOIN_(a, b) a##b
+#define PSO_PROFILE_JOIN(a, b) PSO_PROFILE_JOIN_(a, b)
+#ifdef PSO_PROFILE
+// Times the rest of the enclosing scope under name, a string literal.
+#define PSO_PROFILE_SCOPE(name)                                                                                  \
+    static const int PSO_PROFILE_JOIN(pso_profile_site_, __LINE__) =                                             \
+            ::algos::profile::Profiler::instance().site(name, ::algos::profile::SITE_TIMER);                     \
+    ::algos::profile::ScopedTimer PSO_PROFILE_JOIN(pso_profile_timer_, __LINE__)(PSO_PROFILE_JOIN(pso_profile_site_, __LINE__))
+// Adds amount to the counter called name.
+#define PSO_PROFILE_COUNT(name, amount)                                                                          \
+    do {                                                                                                         \
+        static const int pso_profile_counter =                                                                   \
+                ::algos::profile::Profiler::instance().site(name, ::algos::profile::SITE_COUNTER);               \
+        ::algos::profile::Profiler::instance().add(pso_profile_counter, (std::uint64_t) (amount));               \
+    } while (0)
+#else
+#define PSO_PROFILE_SCOPE(name) static_assert(true, "")
+#define PSO_PROFILE_COUNT(name, amount) do {} while (0)
+#endif
+#endif //PROFILER_H
@@ -1,338 +1,543 @@
 //
 // Created by jkshi on 27/10/2025.
 //
-#include <stack>
-#include <utility>
-#include <fstream>
-#include <sstream>
-
+// ImGui/ImPlot front end for the PSO core in pso.h.
 #include "imgui.h"
 #include "implot.h"
-#include "searchers.h"
+#include <atomic>
+#include <cfloat>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <unordered_map>
+#include <SDL_opengl.h>
+
+#include "pso.h"
+#include "objectives.h"
+#include "triple_buffer.h"
+#include "simulation_thread.h"
+#include "plot_data.h"
+#include "landscape.h"
+#include "profiler.h"
 
 namespace algos {
-    namespace pso {
-        struct Particle {
-            double x;
-            double y;
-            double best_x;
-            double best_y;
-            double best_fitness;
-        };
-
-        struct PSOConfig : AppConfig {
-            int n_particles = 5;
-            float cognitive_factor = 0.5;
-            float social_factor = 0.8;
-            float inertia_weight = 0.5;
-            float seconds_per_iteration = 1;
-
-        };
-
-        struct UpdateCycle {
-            Particle *particles;
-            int iterations;
-        };
-
-        struct StoredCycle {
-            Particle *particles;
-            int iterations;
-            int n_particles;
-        };
-    };
-    class PSO : public Optimiser {
+    /*
+     * The optimiser steps on a SimulationThread and publishes snapshots through a
+     * triple buffer. plot() and the config window only read the newest snapshot;
+     * changes from the GUI run in SimulationThread::exclusive() between two steps.
+     */
+    template<typename Objective>
+    class BasicPSOGui : public BasicPSO<Objective> {
     private:
-        FitnessFunction fitness_function;
-        pso::PSOConfig config;
-        std::stack<pso::StoredCycle> cycles;
-
-        pso::Particle *initialise_particles(int n_particles, pso::PSOConfig *config) {
-            auto* particles = new pso::Particle[n_particles];
-            for (int i = 0; i < n_particles; i++) {
-                particles[i].x = config->min_x + (double) (rand()) / ((double) (RAND_MAX / (config->max_x - config->min_x)));
-                particles[i].y = config->min_y + (double) (rand()) / ((double) (RAND_MAX / (config->max_y - config->min_y)));
-                particles[i].best_x = particles[i].x;
-                particles[i].best_y = particles[i].y;
-                particles[i].best_fitness = fitness_function(particles[i].x, particles[i].y, config);
-                if (particles[i].best_fitness < config->global_best_fitness) {
-                    config->global_best_x = particles[i].best_x;
-                    config->global_best_y = particles[i].best_y;
-                    config->global_best_fitness = particles[i].best_fitness;
-                }
-            }
-            return particles;
+        using Base = BasicPSO<Objective>;
+        using Base::config;
+        using Base::cycles;
+        using Base::clear_cycles;
+        using Base::initialise_particles;
+        using Base::stop_recording;
+        using Base::start_recording;
+        using Base::set_history_memory_budget;
+
+        char record_filename[1024] = "trajectory.psot";
+        // Dimensions shown on the plot's X and Y axes, edited here and read when publishing.
+        int projection[2] = {0, 1};
+        std::atomic<int> published_projection[2] = {{0}, {1}};
+
+        TripleBuffer<pso::Snapshot> snapshots;
+        // Counts snapshots taken from the buffer, so plot data knows when it is stale.
+        std::uint64_t snapshot_serial = 0;
+
+        enum PlotMode {
+            PLOT_PARTICLES = 0,
+            PLOT_DENSITY = 1,
         };
-
-        pso::StoredCycle create_stored_cycle(pso::Particle* particles, int iterations, int n_particles) {
-            auto* new_particles = new pso::Particle[n_particles];
-            std::copy(particles, particles + n_particles, new_particles);
-            return {new_particles, iterations, n_particles};
+        // Screen pixels per density cell along each axis.
+        static constexpr int DENSITY_CELL_PIXELS = 4;
+        int plot_mode = PLOT_PARTICLES;
+
+        // What plot() drew last, reused until the snapshot, the view or the mode changes.
+        plot::View plotted_view;
+        std::uint64_t plotted_serial = ~0ull;
+        int plotted_mode = -1;
+        std::vector<double> plot_xs;
+        std::vector<double> plot_ys;
+        std::vector<std::uint64_t> plot_seen;
+        std::vector<float> density;
+        int density_cols = 0;
+        int density_rows = 0;
+        float density_max = 0;
+        std::unique_ptr<ThreadPool> plot_pool;
+
+        // Objective drawn behind the swarm, each frame refining what is in view a little further.
+        static constexpr std::size_t LANDSCAPE_SAMPLES_PER_FRAME = 1 << 15;
+        struct TileTexture {
+            GLuint id = 0;
+            // Tile version and colour scale the texture was made from.
+            std::uint64_t version = 0;
+            float low = 0;
+            float high = 0;
         };
-
-        void clear_cycles() {
-            while (!this->cycles.empty()) {
-                delete[] this->cycles.top().particles;
-                this->cycles.pop();
+        bool show_landscape = true;
+        landscape::LandscapeCache landscape_cache;
+        // Objective version the cached tiles were sampled from.
+        std::uint64_t landscape_objective_version = 0;
+        std::unordered_map<landscape::TileKey, TileTexture, landscape::TileKeyHash> tile_textures;
+        std::vector<ImU32> tile_pixels;
+        // Last so it stops before anything it uses is destroyed.
+        std::unique_ptr<SimulationThread> simulation;
+
+        void set_goal(int d, double value) {
+            if (d == 0) {
+                config.goal_x = value;
+            } else if (d == 1) {
+                config.goal_y = value;
             }
         }
-    public:
-        PSO(FitnessFunction func, pso::PSOConfig cfg) : config(cfg) {
-            this->fitness_function = std::move(func);
-            pso::Particle* temp = initialise_particles(config.n_particles, &config);
-            cycles.push({temp, 0, config.n_particles});
-        };
 
-        void forward_step() override {
-            this->step();
+        const pso::Snapshot& latest() {
+            if (snapshots.update()) {
+                snapshot_serial++;
+            }
+            return snapshots.read_buffer();
         }
 
-        void step() override {
-            if (cycles.top().iterations == config.max_iterations) {
-#ifndef NDEBUG
-                printf("Max iterations reached\n");
-#endif
-                return;
-            }
-            pso::StoredCycle next_cycle = create_stored_cycle(cycles.top().particles, cycles.top().iterations+1, this->config.n_particles);
-            pso::Particle* particles = next_cycle.particles;
-            for (int i = 0; i < config.n_particles; i++) {
-                double r1 = (double) (rand()) / ((double) (RAND_MAX));
-                double r2 = (double) (rand()) / ((double) (RAND_MAX));
-
-                double cognitive_component_x = config.cognitive_factor * r1 * (particles[i].best_x - particles[i].x);
-                double cognitive_component_y = config.cognitive_factor * r1 * (particles[i].best_y - particles[i].y);
-
-                double social_component_x = config.social_factor * r2 * (config.global_best_x - particles[i].x);
-                double social_component_y = config.social_factor * r2 * (config.global_best_y - particles[i].y);
-
-                double new_x = particles[i].x + config.inertia_weight + cognitive_component_x + social_component_x;
-                double new_y = particles[i].y + config.inertia_weight + cognitive_component_y + social_component_y;
-
-#ifndef NDEBUG
-                printf("Particle %d: x = %f, y = %f, new_x = %f, new_y = %f\n", i, particles[i].x, particles[i].y, new_x, new_y);
-#endif
-                double new_fitness = fitness_function(new_x, new_y, &this->config);
-                if (new_fitness < particles[i].best_fitness) {
-                    particles[i].best_x = new_x;
-                    particles[i].best_y = new_y;
-                    particles[i].best_fitness = new_fitness;
-                }
-                if (new_fitness < config.global_best_fitness) {
-                    config.global_best_x = new_x;
-                    config.global_best_y = new_y;
-                    config.global_best_fitness = new_fitness;
-                }
-                particles[i].x = new_x;
-                particles[i].y = new_y;
+        // Pool for plot work on the GUI thread, null on a single core.
+        ThreadPool* plot_threads() {
+            unsigned hardware = std::thread::hardware_concurrency();
+            if (!plot_pool && hardware > 1) {
+                plot_pool = std::make_unique<ThreadPool>((int) hardware - 1);
             }
+            return plot_pool.get();
+        }
 
-            cycles.push( next_cycle);
-        };
-
-        void backward_step() override {
-            if (cycles.size() > 1) {
-                delete[] cycles.top().particles;
-                cycles.pop();
+        void upload_tile(const landscape::Tile& tile, TileTexture* texture, float low, float high) {
+            tile_pixels.resize(tile.values.size());
+            float range = high > low ? high - low : 1.0f;
+            for (std::size_t i = 0; i < tile.values.size(); i++) {
+                float t = std::clamp((tile.values[i] - low) / range, 0.0f, 1.0f);
+                tile_pixels[i] = ImGui::ColorConvertFloat4ToU32(ImPlot::SampleColormap(t, ImPlotColormap_Viridis));
             }
-        };
-
-        void reset() override {
-            this->clear_cycles();
-
-            pso::Particle* temp = initialise_particles(config.n_particles, &config);
-            cycles.push(create_stored_cycle(temp, 0, config.n_particles));
-            delete[] temp;
-            config.global_best_x = 0;
-            config.global_best_y = 0;
-            config.global_best_fitness = 1e12;
-        };
+            if (texture->id == 0) {
+                glGenTextures(1, &texture->id);
+            }
+            glBindTexture(GL_TEXTURE_2D, texture->id);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+            glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, landscape::TILE_SAMPLES, landscape::TILE_SAMPLES, 0, GL_RGBA,
+                         GL_UNSIGNED_BYTE, tile_pixels.data());
+            texture->version = tile.version;
+            texture->low = low;
+            texture->high = high;
+        }
 
-        void save_to_file(const std::string &filename) override {
-            FILE* file = fopen(filename.c_str(), "w");
-            if (file == nullptr) {
-                printf("Error opening file\n");
-                return;
+        /*
+         * Draws the objective over the search bounds, sliced through the goal, as cached
+         * tile textures. A tile is sampled only once it comes into view, refined coarse
+         * to fine over a few frames and re-uploaded only when its samples or the colour
+         * scale change. A new goal, plotted dimension or reloaded objective empties the cache.
+         */
+        void plot_landscape(const pso::Snapshot& shown, const plot::View& view) {
+            PSO_PROFILE_SCOPE("gui.landscape");
+            landscape::Slice slice;
+            slice.dimensions = shown.config.dimensions;
+            slice.dim_x = shown.dims[0];
+            slice.dim_y = shown.dims[1];
+            slice.origin.resize(std::max(0, slice.dimensions));
+            for (int d = 0; d < slice.dimensions; d++) {
+                slice.origin[d] = objectives::goal_coordinate(&shown.config, d);
             }
-            // Save config
-            fprintf(file, "n_particles,%d\n", config.n_particles);
-            fprintf(file, "cognitive_factor,%f\n", config.cognitive_factor);
-            fprintf(file, "social_factor,%f\n", config.social_factor);
-            fprintf(file, "inertia_weight,%f\n", config.inertia_weight);
-            fprintf(file, "seconds_per_iteration,%f\n", config.seconds_per_iteration);
-            fprintf(file, "min_x,%d\n", config.min_x);
-            fprintf(file, "max_x,%d\n", config.max_x);
-            fprintf(file, "min_y,%d\n", config.min_y);
-            fprintf(file, "max_y,%d\n", config.max_y);
-            fprintf(file, "max_iterations,%d\n", config.max_iterations);
-            fprintf(file, "goal_x,%f\n", config.goal_x);
-            fprintf(file, "goal_y,%f\n", config.goal_y);
-            fprintf(file, "\n\n\n\n");
-
-            std::vector<pso::StoredCycle> temp;
-
-            while (!cycles.empty()) {
-                temp.push_back(cycles.top());
-                cycles.pop();
+            landscape_cache.set_slice(slice);
+            if (shown.objective_version != landscape_objective_version) {
+                landscape_cache.clear();
+                landscape_objective_version = shown.objective_version;
             }
 
-            for (int i = temp.size() - 1; i >= 0; i--) {
-                for (int j = 0; j < temp[i].n_particles; j++) {
-                    fprintf(file, "%f,%f", temp[i].particles[j].x, temp[i].particles[j].y);
-                    if (j != temp[i].n_particles - 1) {
-                        fprintf(file, ",");
-                    }
+            double min_x, max_x, min_y, max_y;
+            pso::position_bounds(shown.config, slice.dim_x, &min_x, &max_x);
+            pso::position_bounds(shown.config, slice.dim_y, &min_y, &max_y);
+            std::vector<landscape::TileKey> keys = landscape_cache.visible(view, min_x, max_x, min_y, max_y);
+            AppConfig objective_config = shown.config;
+            landscape_cache.refine(this->fitness_function, &objective_config, keys, LANDSCAPE_SAMPLES_PER_FRAME,
+                                   plot_threads());
+
+            // One colour scale across the tiles in view.
+            float low = std::numeric_limits<float>::infinity();
+            float high = -low;
+            for (const landscape::TileKey& key : keys) {
+                const landscape::Tile* tile = landscape_cache.find(key);
+                if (tile != nullptr && tile->passes > 0) {
+                    low = std::min(low, tile->min_value);
+                    high = std::max(high, tile->max_value);
                 }
-                fprintf(file, "\n");
             }
-
-            fclose(file);
-            for (auto i : temp) {
-                cycles.push(i);
+            for (const landscape::TileKey& key : keys) {
+                const landscape::Tile* tile = landscape_cache.find(key);
+                if (tile == nullptr || tile->passes == 0) {
+                    continue;
+                }
+                TileTexture& texture = tile_textures[key];
+                if (texture.id == 0 || texture.version != tile->version || texture.low != low || texture.high != high) {
+                    upload_tile(*tile, &texture, low, high);
+                }
+                // Clip to the bounds, texture row 0 is the tile's lowest y and PlotImage puts uv0 at the top.
+                double x0, y0, x1, y1;
+                landscape::LandscapeCache::bounds_of(key, &x0, &y0, &x1, &y1);
+                double cx0 = std::max(x0, min_x), cx1 = std::min(x1, max_x);
+                double cy0 = std::max(y0, min_y), cy1 = std::min(y1, max_y);
+                ImVec2 uv0((float) ((cx0 - x0) / (x1 - x0)), (float) ((cy1 - y0) / (y1 - y0)));
+                ImVec2 uv1((float) ((cx1 - x0) / (x1 - x0)), (float) ((cy0 - y0) / (y1 - y0)));
+                ImPlot::PlotImage("##Landscape", (ImTextureID) (std::intptr_t) texture.id, ImPlotPoint(cx0, cy0),
+                                  ImPlotPoint(cx1, cy1), uv0, uv1);
             }
-        };
 
-        void load_from_file(const std::string &filename) override {
-            std::stack<pso::StoredCycle> read_cycles;
-            std::fstream file;
-            file.open(filename, std::ios::in);
-            if (!file.is_open()) {
-                printf("Error opening file\n");
-                this->cycles = read_cycles;
-                return;
+            // Textures of evicted tiles.
+            for (auto it = tile_textures.begin(); it != tile_textures.end();) {
+                if (landscape_cache.find(it->first) == nullptr) {
+                    glDeleteTextures(1, &it->second.id);
+                    it = tile_textures.erase(it);
+                } else {
+                    ++it;
+                }
             }
-            std::string line;
-            int iter = 0;
-
-            pso::PSOConfig read_config;
+        }
 
-            // Load config
-            while (std::getline(file, line)){
-                if (line.empty() && line[0] != '\n') {
-                    break;
+        /*
+         * Draws the swarm over the landscape, if shown, as a density heatmap or as points
+         * decimated to one per pixel once there are more particles than pixels. Either
+         * is only recomputed when the snapshot, the view or the mode changed since the
+         * last frame.
+         */
+        void plot_particles(const pso::Snapshot& shown) {
+            PSO_PROFILE_SCOPE("gui.plot_particles");
+            ImPlotRect limits = ImPlot::GetPlotLimits();
+            ImVec2 size = ImPlot::GetPlotSize();
+            plot::View view;
+            view.min_x = limits.X.Min;
+            view.max_x = limits.X.Max;
+            view.min_y = limits.Y.Min;
+            view.max_y = limits.Y.Max;
+            view.width = std::max(1, (int) size.x);
+            view.height = std::max(1, (int) size.y);
+            bool stale = view != plotted_view || snapshot_serial != plotted_serial || plot_mode != plotted_mode;
+            plotted_view = view;
+            plotted_serial = snapshot_serial;
+            plotted_mode = plot_mode;
+            std::size_t n = shown.xs.size();
+
+            if (show_landscape) {
+                plot_landscape(shown, view);
+            }
+            if (plot_mode == PLOT_DENSITY) {
+                if (stale) {
+                    density_cols = std::max(1, view.width / DENSITY_CELL_PIXELS);
+                    density_rows = std::max(1, view.height / DENSITY_CELL_PIXELS);
+                    density_max = plot::bin_density(shown.xs.data(), shown.ys.data(), n, view, density_cols,
+                                                     density_rows, &density, plot_threads());
                 }
-                std::string key = line.substr(0, line.find(","));
-                std::string value = line.substr(line.find(",") + 1);
-                if (key == "n_particles") {
-                    read_config.n_particles = std::stoi(value);
-                } else if (key == "cognitive_factor") {
-                    read_config.cognitive_factor = std::stof(value);
-                } else if (key == "social_factor") {
-                    read_config.social_factor = std::stof(value);
-                } else if (key == "inertia_weight") {
-                    read_config.inertia_weight = std::stof(value);
-                } else if (key == "seconds_per_iteration") {
-                    read_config.seconds_per_iteration = std::stof(value);
-                } else if (key == "min_x") {
-                    read_config.min_x = std::stoi(value);
-                } else if (key == "max_x") {
-                    read_config.max_x = std::stoi(value);
-                } else if (key == "min_y") {
-                    read_config.min_y = std::stoi(value);
-                } else if (key == "max_y") {
-                    read_config.max_y = std::stoi(value);
-                } else if (key == "max_iterations") {
-                    read_config.max_iterations = std::stoi(value);
-                } else if (key == "goal_x") {
-                    read_config.goal_x = std::stof(value);
-                } else if (key == "goal_y") {
-                    read_config.goal_y = std::stof(value);
+                ImPlot::PlotHeatmap("Density", density.data(), density_rows, density_cols, 0.0,
+                                    std::max(1.0f, density_max), nullptr, ImPlotPoint(view.min_x, view.min_y),
+                                    ImPlotPoint(view.max_x, view.max_y));
+            } else if (n > (std::size_t) view.width * view.height) {
+                if (stale) {
+                    plot::decimate(shown.xs.data(), shown.ys.data(), n, view, &plot_xs, &plot_ys, &plot_seen);
                 }
+                ImPlot::PlotScatter("Particles", plot_xs.data(), plot_ys.data(), (int) plot_xs.size());
+            } else {
+                ImPlot::PlotScatter("Particles", shown.xs.data(), shown.ys.data(), (int) n);
             }
+        }
 
-            // Load data
-            while (std::getline(file, line)) {
-                // Skip empty lines
-                if (line.empty()) {
-                    continue;
-                }
+        // Takes the fields the config window edits, leaving the run's progress alone.
+        void apply_settings(const pso::PSOConfig& edit) {
+            config.cognitive_factor = edit.cognitive_factor;
+            config.social_factor = edit.social_factor;
+            config.inertia_weight = edit.inertia_weight;
+            config.seconds_per_iteration = edit.seconds_per_iteration;
+            config.min_x = edit.min_x;
+            config.max_x = edit.max_x;
+            config.min_y = edit.min_y;
+            config.max_y = edit.max_y;
+            config.max_iterations = edit.max_iterations;
+            config.seed = edit.seed;
+            config.n_threads = edit.n_threads;
+            config.topology = edit.topology;
+            config.neighbours = std::max(1, edit.neighbours);
+            Base::set_stopping_criteria(edit.stopping);
+            // If either changes we must reset cycles and reinitialise particles
+            if ((edit.n_particles != cycles.top().n_particles || edit.dimensions != cycles.top().swarm.dimensions) &&
+                edit.n_particles > 0 && edit.dimensions > 0) {
+                config.n_particles = edit.n_particles;
+                config.dimensions = edit.dimensions;
+                // Trajectory blocks have a fixed particle count.
+                stop_recording();
+                clear_cycles();
+                Base::start_fresh_swarm();
+            }
+        }
 
-                int i = 0;
-                auto* particles = new pso::Particle[read_config.n_particles];
-                std::string token;
-                std::istringstream tokenStream(line);
-                while (std::getline(tokenStream, token, ',')) {
-                    if (i % 2 == 0) {
-                        particles[i / 2].x = std::stof(token);
-                    } else {
-                        particles[i / 2].y = std::stof(token);
-                    }
-                    i++;
+    public:
+        template<typename... Args>
+        explicit BasicPSOGui(Args&&... args) : Base(std::forward<Args>(args)...) {
+            SimulationThread::Callbacks callbacks;
+            callbacks.step = [this] {
+                if (Base::get_stop_reason() != convergence::STOP_NONE) {
+                    return false;
                 }
-                read_cycles.push({particles, iter, read_config.n_particles});
-                iter++;
+                Base::step();
+                return true;
+            };
+            callbacks.publish = [this] {
+                PSO_PROFILE_SCOPE("gui.publish_snapshot");
+                Base::fill_snapshot(&snapshots.write_buffer(), published_projection[0].load(),
+                                    published_projection[1].load());
+                snapshots.publish();
+            };
+            callbacks.interval = [this] {
+                return (double) config.seconds_per_iteration;
+            };
+            simulation = std::make_unique<SimulationThread>(std::move(callbacks));
+            simulation->exclusive([] {});
+        }
+
+        ~BasicPSOGui() override {
+            simulation.reset();
+            for (auto& texture : tile_textures) {
+                glDeleteTextures(1, &texture.second.id);
             }
+        }
 
-            file.close();
-            this->cycles = read_cycles;
-            this->config = read_config;
-        };
+        void forward_step() override {
+            simulation->exclusive([this] { Base::step(); });
+        }
 
-        void display_config_window() override {
-            ImGui::InputInt("Number of Particles", &config.n_particles, 1, 1000);
-            // If this changes we must reset cycles and reinitialise particles
-            if (config.n_particles != cycles.top().n_particles) {
-                if (config.n_particles > 0) {
-                    clear_cycles();
-                    pso::Particle* temp = initialise_particles(config.n_particles, &config);
-                    cycles.push(create_stored_cycle(temp, 0, config.n_particles));
-                    delete[] temp;
-                }
-            }
+        void backward_step() override {
+            simulation->exclusive([this] { Base::backward_step(); });
+        }
 
-            ImGui::SliderFloat("Cognitive Factor", &config.cognitive_factor, 0.0, 1.0);
-            ImGui::SliderFloat("Social Factor", &config.social_factor, 0.0, 1.0);
-            ImGui::SliderFloat("Inertia Weight", &config.inertia_weight, 0.0, 1.0);
-            ImGui::InputFloat("Seconds per Iteration", &config.seconds_per_iteration, 0.1, 10.0);
-            ImGui::InputInt("Min X", &config.min_x, -100.0, 100.0);
-            ImGui::InputInt("Max X", &config.max_x, -100.0, 100.0);
-            ImGui::InputInt("Min Y", &config.min_y, -100.0, 100.0);
-            ImGui::InputInt("Max Y", &config.max_y, -100.0, 100.0);
-            ImGui::InputInt("Max Iterations", &config.max_iterations, 1, 10000);
-        };
+        void reset() override {
+            simulation->exclusive([this] { Base::reset(); });
+        }
 
-        AppConfig get_config() override {
-            return config;
-        };
+        void save_to_file(const std::string& filename) override {
+            simulation->exclusive([this, &filename] { Base::save_to_file(filename); });
+        }
+
+        void load_from_file(const std::string& filename) override {
+            simulation->exclusive([this, &filename] { Base::load_from_file(filename); });
+        }
 
         std::string get_title() override {
-            return "Global Best Fitness: " + std::to_string(config.global_best_fitness) + " Iterations: " +
-                std::to_string(cycles.top().iterations+1) + "/" +
-                std::to_string(cycles.size()) + "("  + std::to_string(config.max_iterations) + ")";
+            return latest().title;
+        }
+
+        AppConfig get_config() override {
+            return latest().config;
+        }
+
+        void set_running(bool running, bool fast_forward) override {
+            simulation->set_running(running, fast_forward ? SimulationThread::MODE_FAST_FORWARD
+                                                          : SimulationThread::MODE_TIMED);
+        }
+
+        void display_config_window() override {
+            const pso::Snapshot& shown = latest();
+            pso::PSOConfig edit = shown.config;
+            bool changed = false;
+            changed |= ImGui::InputInt("Number of Particles", &edit.n_particles, 1, 1000);
+            changed |= ImGui::InputInt("Dimensions", &edit.dimensions, 1, 10);
+            changed |= ImGui::SliderFloat("Cognitive Factor", &edit.cognitive_factor, 0.0, 1.0);
+            changed |= ImGui::SliderFloat("Social Factor", &edit.social_factor, 0.0, 1.0);
+            changed |= ImGui::SliderFloat("Inertia Weight", &edit.inertia_weight, 0.0, 1.0);
+            changed |= ImGui::InputFloat("Seconds per Iteration", &edit.seconds_per_iteration, 0.1, 10.0);
+            changed |= ImGui::InputInt("Min X", &edit.min_x, -100.0, 100.0);
+            changed |= ImGui::InputInt("Max X", &edit.max_x, -100.0, 100.0);
+            changed |= ImGui::InputInt("Min Y", &edit.min_y, -100.0, 100.0);
+            changed |= ImGui::InputInt("Max Y", &edit.max_y, -100.0, 100.0);
+            changed |= ImGui::InputInt("Max Iterations", &edit.max_iterations, 1, 10000);
+            changed |= ImGui::InputScalar("Seed", ImGuiDataType_U64, &edit.seed);
+            const char* topologies[] = {"Global", "Ring", "Von Neumann", "Nearest"};
+            int topology = edit.topology;
+            if (ImGui::Combo("Topology", &topology, topologies, 4)) {
+                edit.topology = (neighbourhood::Topology) topology;
+                changed = true;
+            }
+            if (edit.topology == neighbourhood::TOPOLOGY_NEAREST) {
+                changed |= ImGui::InputInt("Neighbours", &edit.neighbours, 1, 8);
+            }
+            if (ImGui::TreeNode("Stopping Criteria")) {
+                bool target = std::isfinite(edit.stopping.target_fitness);
+                if (ImGui::Checkbox("Target Fitness", &target)) {
+                    edit.stopping.target_fitness = target ? 0.0 : -std::numeric_limits<double>::infinity();
+                    changed = true;
+                }
+                if (target) {
+                    ImGui::SameLine();
+                    changed |= ImGui::InputDouble("##target", &edit.stopping.target_fitness, 0.0, 0.0, "%g");
+                }
+                changed |= ImGui::InputInt("Stagnation Iterations", &edit.stopping.stagnation_iterations, 1, 100);
+                changed |= ImGui::InputDouble("Stagnation Tolerance", &edit.stopping.stagnation_tolerance, 0.0, 0.0, "%g");
+                changed |= ImGui::InputDouble("Min Diameter", &edit.stopping.min_diameter, 0.0, 0.0, "%g");
+                changed |= ImGui::InputScalar("Max Evaluations", ImGuiDataType_U64, &edit.stopping.max_evaluations);
+                changed |= ImGui::InputDouble("Max Seconds", &edit.stopping.max_seconds, 0.0, 0.0, "%g");
+                const convergence::Status& status = shown.convergence;
+                ImGui::Text("Diameter %g, RMS radius %g", status.diameter, status.radius);
+                ImGui::Text("Evaluations %llu, %.2f s stepping, last improved at %d",
+                            (unsigned long long) status.evaluations, status.seconds, status.last_improvement);
+                ImGui::Text("Stopped: %s", convergence::stop_reason_name(status.reason));
+                ImGui::TreePop();
+            }
+            int budget = edit.history_memory_budget_mb;
+            if (ImGui::InputInt("History Budget (MB)", &budget, 64, 1024)) {
+                simulation->exclusive([this, budget] { set_history_memory_budget(std::max(0, budget)); });
+            }
+            bool recording = shown.recording;
+            if (ImGui::Checkbox("Record", &recording)) {
+                simulation->exclusive([this, recording] {
+                    if (recording) {
+                        start_recording(record_filename);
+                    } else {
+                        stop_recording();
+                    }
+                });
+            }
+            ImGui::SameLine();
+            ImGui::InputText("Trajectory File", record_filename, sizeof(record_filename));
+            bool projected = ImGui::SliderInt("Plot X Dimension", &projection[0], 0, edit.dimensions - 1);
+            projected |= ImGui::SliderInt("Plot Y Dimension", &projection[1], 0, edit.dimensions - 1);
+            ImGui::RadioButton("Particles", &plot_mode, PLOT_PARTICLES);
+            ImGui::SameLine();
+            ImGui::RadioButton("Density", &plot_mode, PLOT_DENSITY);
+            ImGui::SameLine();
+            ImGui::Checkbox("Landscape", &show_landscape);
+            changed |= ImGui::SliderInt("Threads", &edit.n_threads, 1, (int) std::max(1u, std::thread::hardware_concurrency()));
+            if (projected) {
+                published_projection[0] = projection[0];
+                published_projection[1] = projection[1];
+            }
+            if (changed) {
+                simulation->exclusive([this, edit] { apply_settings(edit); });
+            } else if (projected) {
+                // Republish so the plot switches dimensions even while paused.
+                simulation->exclusive([] {});
+            }
         };
 
         void plot() override {
-            std::string title = this->get_title();
-            ImPlot::SetNextAxesLimits(config.min_x, config.max_x, config.min_y, config.max_y);
-            if (ImPlot::BeginPlot(title.c_str(), "X", "Y", ImVec2(ImGui::GetIO().DisplaySize.x, ImGui::GetIO().DisplaySize.y),
+            PSO_PROFILE_SCOPE("gui.plot");
+            const pso::Snapshot& shown = latest();
+            int dim_x = shown.dims[0];
+            int dim_y = shown.dims[1];
+            double min_x, max_x, min_y, max_y;
+            pso::position_bounds(shown.config, dim_x, &min_x, &max_x);
+            pso::position_bounds(shown.config, dim_y, &min_y, &max_y);
+            ImPlot::SetNextAxesLimits(min_x, max_x, min_y, max_y);
+            if (ImPlot::BeginPlot(shown.title.c_str(), "X", "Y", ImVec2(ImGui::GetIO().DisplaySize.x, ImGui::GetIO().DisplaySize.y),
                                    ImPlotFlags_NoMenus | ImPlotFlags_NoBoxSelect | ImPlotFlags_NoFrame)) {
 
-                auto* xs = new double[config.n_particles];
-                auto* ys = new double[config.n_particles];
-                for (int i = 0; i < config.n_particles; i++) {
-                    xs[i] = cycles.top().particles[i].x;
-                    ys[i] = cycles.top().particles[i].y;
-                }
-
-                ImPlot::PlotScatter("Particles", xs, ys, config.n_particles);
+                plot_particles(shown);
 
-                ys[0] = config.goal_y;
-                xs[0] = config.goal_x;
+                double goal_x = objectives::goal_coordinate(&shown.config, dim_x);
+                double goal_y = objectives::goal_coordinate(&shown.config, dim_y);
                 ImPlot::PushStyleColor(ImPlotCol_MarkerOutline, ImVec4(1, 0, 0, 1));
-                ImPlot::PlotScatter("Goal", xs, ys, 1);
+                ImPlot::PlotScatter("Goal", &goal_x, &goal_y, 1);
                 ImPlot::PopStyleColor();
 
+                // Only the first two dimensions have a movable goal.
                 if (ImGui::GetIO().MouseClicked[1]) {
-                    config.goal_x = ImPlot::GetPlotMousePos().x;
-                    config.goal_y = ImPlot::GetPlotMousePos().y;
+                    ImPlotPoint mouse = ImPlot::GetPlotMousePos();
+                    simulation->exclusive([this, dim_x, dim_y, mouse] {
+                        set_goal(dim_x, mouse.x);
+                        set_goal(dim_y, mouse.y);
+                    });
                 }
 
                 ImPlot::EndPlot();
                                    };
         };
 
-        bool should_step() {
-            return ImGui::GetFrameCount() % (int)(ImGui::GetIO().Framerate * config.seconds_per_iteration) == 0 ||
-                    ImGui::GetFrameCount() == 0;
+        // The simulation thread does the stepping, see set_running().
+        bool should_step() override {
+            return false;
+        }
+    };
+
+    using PSOGui = BasicPSOGui<BatchFitnessFunction>;
+
+    /*
+     * Live view of the profiler: time per phase, counters and the step latency
+     * histogram, with tracing to a Chrome trace-event file.
+     */
+    class ProfilerWindow {
+    private:
+        char trace_filename[1024] = "trace.json";
+        std::vector<float> histogram;
+
+    public:
+        void display() {
+            if (!profile::ENABLED) {
+                ImGui::TextWrapped("%s", "Built without PSO_PROFILE, configure with -DBETTER_PSO_PROFILE=ON to profile.");
+                return;
+            }
+            profile::Profiler& profiler = profile::Profiler::instance();
+            std::vector<profile::SiteStats> sites = profiler.report();
+            if (ImGui::BeginTable("Timers", 5, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg)) {
+                ImGui::TableSetupColumn("Phase");
+                ImGui::TableSetupColumn("Calls");
+                ImGui::TableSetupColumn("Total ms");
+                ImGui::TableSetupColumn("Mean us");
+                ImGui::TableSetupColumn("Max us");
+                ImGui::TableHeadersRow();
+                for (const profile::SiteStats& site : sites) {
+                    if (site.kind != profile::SITE_TIMER) {
+                        continue;
+                    }
+                    ImGui::TableNextRow();
+                    ImGui::TableSetColumnIndex(0);
+                    ImGui::TextUnformatted(site.name);
+                    ImGui::TableSetColumnIndex(1);
+                    ImGui::Text("%llu", (unsigned long long) site.count);
+                    ImGui::TableSetColumnIndex(2);
+                    ImGui::Text("%.2f", site.total_ns / 1e6);
+                    ImGui::TableSetColumnIndex(3);
+                    ImGui::Text("%.2f", site.count > 0 ? site.total_ns / 1e3 / site.count : 0.0);
+                    ImGui::TableSetColumnIndex(4);
+                    ImGui::Text("%.2f", site.max_ns / 1e3);
+                }
+                ImGui::EndTable();
+            }
+            for (const profile::SiteStats& site : sites) {
+                if (site.kind == profile::SITE_COUNTER) {
+                    ImGui::Text("%s: %llu", site.name, (unsigned long long) site.count);
+                }
+                if (site.kind == profile::SITE_TIMER && std::string(site.name) == "step") {
+                    // Trailing empty buckets are left off so the bars use the width.
+                    int used = profile::HISTOGRAM_BUCKETS;
+                    while (used > 1 && site.buckets[used - 1] == 0) {
+                        used--;
+                    }
+                    histogram.assign(site.buckets.begin(), site.buckets.begin() + used);
+                    ImGui::PlotHistogram("Step latency", histogram.data(), used, 0,
+                                         "log2 microseconds per bucket", 0.0f, FLT_MAX, ImVec2(0, 80));
+                }
+            }
+
+            bool tracing = profiler.is_tracing();
+            if (ImGui::Checkbox("Trace", &tracing)) {
+                profiler.set_tracing(tracing);
+            }
+            ImGui::SameLine();
+            ImGui::InputText("Trace File", trace_filename, sizeof(trace_filename));
+            if (ImGui::Button("Export Trace")) {
+                profiler.write_chrome_trace(trace_filename);
+            }
+            ImGui::SameLine();
+            if (ImGui::Button("Reset Profiler")) {
+                profiler.reset();
+            }
         }
     };
-}
\ No newline at end of file
+}
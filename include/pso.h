@@ -0,0 +1,1172 @@
+//
+// Created by jkshi on 27/10/2025.
+//
+// PSO core, kept free of any SDL/ImGui dependency so it can be driven headless.
+#ifndef PSO_H
+#define PSO_H
+#include <utility>
+#include <string>
+#include <string_view>
+#include <istream>
+#include <vector>
+#include <cstdio>
+#include <cstdint>
+#include <memory>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <type_traits>
+
+#include "searchers.h"
+#include "swarm.h"
+#include "thread_pool.h"
+#include "rng.h"
+#include "history.h"
+#include "trajectory.h"
+#include "cycles_csv.h"
+#include "profiler.h"
+#include "neighbourhood.h"
+#include "convergence.h"
+#include "checkpoint.h"
+
+namespace algos {
+    namespace pso {
+        struct PSOConfig : AppConfig {
+            int n_particles = 5;
+            // Search space dimensions. Dimension 0 spans [min_x, max_x], 1 spans [min_y, max_y]
+            // and any further ones reuse the x range.
+            int dimensions = 2;
+            float cognitive_factor = 0.5;
+            float social_factor = 0.8;
+            float inertia_weight = 0.5;
+            float seconds_per_iteration = 1;
+            // Threads used to update and evaluate the swarm. Results do not depend on it,
+            // but above 1 the fitness function is called concurrently on disjoint ranges.
+            int n_threads = 1;
+            // Key for the counter-based RNG, the same seed always gives the same run.
+            std::uint64_t seed = 0;
+            // Every n-th stored iteration is a full copy, the rest are deltas.
+            int history_keyframe_interval = 32;
+            // RAM the history may use before older iterations spill to disk, 0 for unlimited.
+            int history_memory_budget_mb = 0;
+            // Directory for spilled history segments, the system temp directory if empty.
+            std::string history_spill_directory;
+            // Store every iteration for stepping back and saving, otherwise only the current one.
+            bool keep_history = true;
+            // Whose best each particle is drawn towards, and the neighbourhood size for TOPOLOGY_NEAREST.
+            neighbourhood::Topology topology = neighbourhood::TOPOLOGY_GLOBAL;
+            int neighbours = 8;
+            // Rules that end the run before max_iterations.
+            convergence::StoppingCriteria stopping;
+            // Every coordinate of the global best, global_best_x and global_best_y mirror the first two.
+            std::vector<double> global_best_position;
+        };
+
+        /*
+         * What the viewer draws: the settings, the progress and two plotted coordinates
+         * of every particle, so publishing one never copies the whole swarm.
+         */
+        struct Snapshot {
+            PSOConfig config;
+            int iteration = 0;
+            int stored_cycles = 0;
+            bool recording = false;
+            // Dimensions xs and ys hold.
+            int dims[2] = {0, 1};
+            AlignedVector<double> xs;
+            AlignedVector<double> ys;
+            std::string title;
+            // Bumped whenever the objective itself changes, e.g. a reloaded plugin.
+            std::uint64_t objective_version = 0;
+            convergence::Status convergence;
+        };
+
+        // Makes particle's position, or its personal best, the global best position.
+        inline void set_global_best(PSOConfig* config, const Swarm& swarm, int particle, bool personal_best) {
+            config->global_best_position.resize(swarm.dimensions);
+            for (int d = 0; d < swarm.dimensions; d++) {
+                config->global_best_position[d] = personal_best ? swarm.best_column(d)[particle] : swarm.column(d)[particle];
+            }
+            config->global_best_x = swarm.dimensions > 0 ? config->global_best_position[0] : 0;
+            config->global_best_y = swarm.dimensions > 1 ? config->global_best_position[1] : 0;
+        }
+
+        // Where stepping time went, to compare update modes on the same objective.
+        struct WorkStats {
+            std::uint64_t evaluations = 0;
+            // Wall time spent stepping, and the thread time spent updating and evaluating within it.
+            double wall_seconds = 0;
+            double busy_seconds = 0;
+            int threads = 1;
+
+            // Share of the threads' time spent busy, 1 when none ever waited.
+            double utilisation() const {
+                return wall_seconds > 0 ? busy_seconds / (wall_seconds * std::max(1, threads)) : 0.0;
+            }
+        };
+
+        // Objectives with a bool reload() member, such as plugins, can swap in a rebuilt version on reset().
+        template<typename O, typename = void>
+        struct has_reload : std::false_type {};
+        template<typename O>
+        struct has_reload<O, std::void_t<decltype(std::declval<O&>().reload())>> : std::true_type {};
+
+        // A personal best carried from one swarm to another by the island model.
+        struct Migrant {
+            std::vector<double> position;
+            double fitness;
+        };
+
+        inline void position_bounds(const AppConfig& config, int d, double* min, double* max) {
+            *min = d == 1 ? config.min_y : config.min_x;
+            *max = d == 1 ? config.max_y : config.max_x;
+        }
+
+        /*
+         * Philox counter layout: {particle, iteration, purpose, epoch}. Initial positions
+         * are only drawn at iteration 0, so they use that word for the coordinate pair.
+         */
+        enum RandomPurpose : std::uint32_t {
+            RANDOM_INITIAL_POSITION = 0,
+            RANDOM_STEP_COEFFICIENTS = 1,
+            // The asynchronous update counts updates per particle, not iterations.
+            RANDOM_ASYNC_STEP_COEFFICIENTS = 2,
+        };
+
+        inline rng::Counter random_counter(int particle, int iteration, RandomPurpose purpose, std::uint32_t epoch) {
+            return {{(std::uint32_t) particle, (std::uint32_t) iteration, purpose, epoch}};
+        }
+
+        /*
+         * The "key,value" config header of a cycles file, also the config block of a trajectory file.
+         */
+        inline std::string format_config(const PSOConfig& config) {
+            std::string out;
+            auto add = [&out](const char* key, auto value) {
+                out += key;
+                out += ',';
+                cycles_csv::append_number(out, value);
+                out += '\n';
+            };
+            add("n_particles", config.n_particles);
+            add("dimensions", config.dimensions);
+            add("cognitive_factor", config.cognitive_factor);
+            add("social_factor", config.social_factor);
+            add("inertia_weight", config.inertia_weight);
+            add("seconds_per_iteration", config.seconds_per_iteration);
+            add("min_x", config.min_x);
+            add("max_x", config.max_x);
+            add("min_y", config.min_y);
+            add("max_y", config.max_y);
+            add("max_iterations", config.max_iterations);
+            add("goal_x", config.goal_x);
+            add("goal_y", config.goal_y);
+            add("seed", config.seed);
+            add("topology", (int) config.topology);
+            add("neighbours", config.neighbours);
+            add("stop_fitness", config.stopping.target_fitness);
+            add("stop_stagnation_iterations", config.stopping.stagnation_iterations);
+            add("stop_stagnation_tolerance", config.stopping.stagnation_tolerance);
+            add("stop_diameter", config.stopping.min_diameter);
+            add("stop_evaluations", config.stopping.max_evaluations);
+            add("stop_seconds", config.stopping.max_seconds);
+            return out;
+        }
+
+        inline bool ends_with(const std::string& text, const std::string& suffix) {
+            return text.size() >= suffix.size() && text.compare(text.size() - suffix.size(), suffix.size(), suffix) == 0;
+        }
+
+        // Applies one config line, unknown keys and unparsable values are ignored.
+        inline void apply_config_line(std::string_view line, PSOConfig* config) {
+            std::size_t comma = line.find(',');
+            if (comma == std::string_view::npos) {
+                return;
+            }
+            std::string_view key = cycles_csv::trim(line.substr(0, comma));
+            std::string_view value = line.substr(comma + 1);
+            if (key == "n_particles") {
+                cycles_csv::parse_number(value, &config->n_particles);
+            } else if (key == "dimensions") {
+                cycles_csv::parse_number(value, &config->dimensions);
+            } else if (key == "cognitive_factor") {
+                cycles_csv::parse_number(value, &config->cognitive_factor);
+            } else if (key == "social_factor") {
+                cycles_csv::parse_number(value, &config->social_factor);
+            } else if (key == "inertia_weight") {
+                cycles_csv::parse_number(value, &config->inertia_weight);
+            } else if (key == "seconds_per_iteration") {
+                cycles_csv::parse_number(value, &config->seconds_per_iteration);
+            } else if (key == "min_x") {
+                cycles_csv::parse_number(value, &config->min_x);
+            } else if (key == "max_x") {
+                cycles_csv::parse_number(value, &config->max_x);
+            } else if (key == "min_y") {
+                cycles_csv::parse_number(value, &config->min_y);
+            } else if (key == "max_y") {
+                cycles_csv::parse_number(value, &config->max_y);
+            } else if (key == "max_iterations") {
+                cycles_csv::parse_number(value, &config->max_iterations);
+            } else if (key == "goal_x") {
+                cycles_csv::parse_number(value, &config->goal_x);
+            } else if (key == "goal_y") {
+                cycles_csv::parse_number(value, &config->goal_y);
+            } else if (key == "seed") {
+                cycles_csv::parse_number(value, &config->seed);
+            } else if (key == "topology") {
+                int topology;
+                if (cycles_csv::parse_number(value, &topology) && topology >= neighbourhood::TOPOLOGY_GLOBAL &&
+                    topology <= neighbourhood::TOPOLOGY_NEAREST) {
+                    config->topology = (neighbourhood::Topology) topology;
+                }
+            } else if (key == "neighbours") {
+                cycles_csv::parse_number(value, &config->neighbours);
+            } else if (key == "stop_fitness") {
+                cycles_csv::parse_number(value, &config->stopping.target_fitness);
+            } else if (key == "stop_stagnation_iterations") {
+                cycles_csv::parse_number(value, &config->stopping.stagnation_iterations);
+            } else if (key == "stop_stagnation_tolerance") {
+                cycles_csv::parse_number(value, &config->stopping.stagnation_tolerance);
+            } else if (key == "stop_diameter") {
+                cycles_csv::parse_number(value, &config->stopping.min_diameter);
+            } else if (key == "stop_evaluations") {
+                cycles_csv::parse_number(value, &config->stopping.max_evaluations);
+            } else if (key == "stop_seconds") {
+                cycles_csv::parse_number(value, &config->stopping.max_seconds);
+            }
+        }
+
+        /*
+         * Read the "key,value" config header in [begin, end), stopping at the first
+         * blank line. Returns where the header ends.
+         */
+        inline const char* read_config(const char* begin, const char* end, PSOConfig* config) {
+            while (begin < end) {
+                std::string_view line = cycles_csv::line_at(begin, end);
+                begin = cycles_csv::next_line(begin, end);
+                if (cycles_csv::is_blank(line)) {
+                    break;
+                }
+                apply_config_line(line, config);
+            }
+            return begin;
+        }
+
+        inline void read_config(std::istream& in, PSOConfig* config) {
+            std::string line;
+            while (std::getline(in, line)) {
+                if (cycles_csv::is_blank(line)) {
+                    break;
+                }
+                apply_config_line(line, config);
+            }
+        }
+    };
+    /*
+     * PSO over any objective callable as objective(points, fitness, config), see
+     * BatchFitnessFunction. With a concrete functor type the objective is inlined
+     * into the step; PSO below is the std::function instance for objectives only
+     * known at run time. Either way it is an Optimiser to the GUI.
+     */
+    template<typename Objective>
+    class BasicPSO : public Optimiser {
+    protected:
+        Objective fitness_function;
+        pso::PSOConfig config;
+        // Recycles the swarm buffers of dropped iterations, shared with the history.
+        std::shared_ptr<pso::SwarmPool> swarm_pool = std::make_shared<pso::SwarmPool>();
+        pso::History cycles;
+
+        // Per-step scratch for the random coefficients and fitness values, reused across steps.
+        pso::AlignedVector<double> r1;
+        pso::AlignedVector<double> r2;
+        pso::AlignedVector<double> fitness;
+        std::vector<double> global_best;
+        // Index of the best particle found in each chunk, -1 if none beat the global best.
+        std::vector<int> chunk_best;
+
+        std::unique_ptr<ThreadPool> pool;
+
+        // Neighbourhood best of every particle under a local topology, laid out like the positions.
+        neighbourhood::Neighbourhoods neighbourhoods;
+        pso::AlignedVector<double> social;
+
+        // Open while recording to a trajectory file.
+        std::unique_ptr<trajectory::Writer> recorder;
+
+        // Particles a step updates and evaluates together, small enough to stay in L1/L2.
+        static constexpr int STEP_TILE = 512;
+
+        // Bumped by every reset() so a reset draws a fresh swarm while staying reproducible.
+        std::uint32_t epoch = 0;
+
+        // Received from other swarms, they replace the worst personal bests when the next step begins.
+        std::vector<pso::Migrant> pending_migrants;
+
+        pso::WorkStats work_stats;
+
+        // Counts objective reloads, see pso::has_reload.
+        std::uint64_t objective_version = 0;
+
+        // Stopping criteria state, and the spread of the positions each chunk of a step measured.
+        convergence::Monitor monitor;
+        std::vector<convergence::Diversity> chunk_diversity;
+        convergence::Diversity diversity;
+
+        // Open while checkpointing every checkpoint_interval iterations, with the state buffers it hands back.
+        std::unique_ptr<checkpoint::Writer> checkpointer;
+        int checkpoint_interval = 0;
+        checkpoint::State checkpoint_state;
+
+        int chunk_size(int n) {
+            if (config.n_threads <= 1) {
+                return std::max(1, n);
+            }
+            // A few chunks per thread so stealing can even out uneven objectives.
+            int chunks = config.n_threads * 4;
+            return std::max(1, (n + chunks - 1) / chunks);
+        }
+
+        /*
+         * Runs body(begin, end, chunk) over the particles, on the thread pool when
+         * n_threads > 1. Chunks write only to their own particles and slots, so the
+         * outcome does not depend on which thread ran which chunk.
+         */
+        template<typename Body>
+        void for_each_chunk(int n, int grain, const Body& body) {
+            if (config.n_threads <= 1 || n <= grain) {
+                for (int begin = 0; begin < n; begin += grain) {
+                    body(begin, std::min(n, begin + grain), begin / grain);
+                }
+                return;
+            }
+            thread_pool()->parallel_for(0, n, grain, [&body, grain](int begin, int end) {
+                body(begin, end, begin / grain);
+            });
+        }
+
+        // The pool for n_threads, null when stepping on the calling thread alone.
+        ThreadPool* thread_pool() {
+            if (config.n_threads <= 1) {
+                return nullptr;
+            }
+            // The calling thread works through chunks too, so the pool needs one thread fewer.
+            if (!pool || pool->size() != config.n_threads - 1) {
+                pool = std::make_unique<ThreadPool>(config.n_threads - 1);
+            }
+            return pool.get();
+        }
+
+        void evaluate(const pso::Swarm& swarm, int begin, int end, pso::PSOConfig* cfg) {
+            std::size_t count = end - begin;
+            fitness_function(Points(swarm.position.data() + begin, swarm.stride, count, swarm.dimensions),
+                             Span<double>(fitness.data() + begin, count), cfg);
+        }
+
+        /*
+         * Folds the per-chunk winners in chunk order into the global best. Taking the
+         * first strictly lower fitness matches a single pass over the particles in order.
+         */
+        void reduce_global_best(const pso::Swarm& swarm, pso::PSOConfig* cfg) {
+            for (int best : chunk_best) {
+                if (best >= 0 && fitness[best] < cfg->global_best_fitness) {
+                    pso::set_global_best(cfg, swarm, best, false);
+                    cfg->global_best_fitness = fitness[best];
+                }
+            }
+        }
+
+        /*
+         * Folds the evaluated fitness of particles [begin, end) into their personal bests
+         * and records the chunk's best candidate for reduce_global_best(). chunk_best_fitness
+         * carries the chunk's best so far between calls. initial takes the positions as
+         * the personal bests outright.
+         */
+        void update_bests(pso::Swarm& swarm, int begin, int end, int chunk, double* chunk_best_fitness, bool initial) {
+            for (int i = begin; i < end; i++) {
+                double new_fitness = fitness[i];
+                if (initial || new_fitness < swarm.best_fitness[i]) {
+                    for (int d = 0; d < swarm.dimensions; d++) {
+                        swarm.best_column(d)[i] = swarm.column(d)[i];
+                    }
+                    swarm.best_fitness[i] = new_fitness;
+                }
+                if (new_fitness < *chunk_best_fitness) {
+                    chunk_best[chunk] = i;
+                    *chunk_best_fitness = new_fitness;
+                }
+            }
+        }
+
+        /*
+         * Each pending migrant, best first, takes the place of the particle with the worst
+         * personal best left, position and personal best both, if it is better than that
+         * particle's best. The global best already took the migrants in add_migrants().
+         */
+        void apply_migrants(pso::Swarm& swarm) {
+            if (pending_migrants.empty()) {
+                return;
+            }
+            std::sort(pending_migrants.begin(), pending_migrants.end(),
+                      [](const pso::Migrant& a, const pso::Migrant& b) { return a.fitness < b.fitness; });
+            int n = swarm.size();
+            int count = std::min<int>(n, (int) pending_migrants.size());
+            std::vector<int> order(n);
+            for (int i = 0; i < n; i++) {
+                order[i] = i;
+            }
+            // Worst first, ties broken by index so the choice never depends on the sort.
+            std::partial_sort(order.begin(), order.begin() + count, order.end(), [&swarm](int a, int b) {
+                return swarm.best_fitness[a] > swarm.best_fitness[b] ||
+                       (swarm.best_fitness[a] == swarm.best_fitness[b] && a < b);
+            });
+            for (int m = 0; m < count; m++) {
+                const pso::Migrant& migrant = pending_migrants[m];
+                int i = order[m];
+                if (migrant.fitness >= swarm.best_fitness[i] || (int) migrant.position.size() != swarm.dimensions) {
+                    continue;
+                }
+                for (int d = 0; d < swarm.dimensions; d++) {
+                    swarm.column(d)[i] = migrant.position[d];
+                    swarm.best_column(d)[i] = migrant.position[d];
+                }
+                swarm.best_fitness[i] = migrant.fitness;
+            }
+            pending_migrants.clear();
+        }
+
+        // Rebuilds the bests of a loaded swarm whose positions are known, as if it had just been stepped.
+        void rebuild_bests(pso::Swarm& swarm, bool initial, pso::PSOConfig* cfg) {
+            int n = swarm.size();
+            fitness.resize(n);
+            int grain = chunk_size(n);
+            chunk_best.assign((n + grain - 1) / grain, -1);
+            double start_best = cfg->global_best_fitness;
+            for_each_chunk(n, grain, [&](int begin, int end, int chunk) {
+                double chunk_best_fitness = start_best;
+                evaluate(swarm, begin, end, cfg);
+                update_bests(swarm, begin, end, chunk, &chunk_best_fitness, initial);
+            });
+            reduce_global_best(swarm, cfg);
+        }
+
+        pso::Swarm initialise_particles(int n_particles, pso::PSOConfig *config) {
+            config->dimensions = std::max(1, config->dimensions);
+            int dimensions = config->dimensions;
+            // Every position and personal best is written below, so a recycled swarm will do.
+            pso::Swarm swarm = swarm_pool->acquire(n_particles, dimensions);
+
+            fitness.resize(n_particles);
+            int grain = chunk_size(n_particles);
+            chunk_best.assign((n_particles + grain - 1) / grain, -1);
+            double start_best = config->global_best_fitness;
+            for_each_chunk(n_particles, grain, [&](int begin, int end, int chunk) {
+                for (int d = 0; d < dimensions; d += 2) {
+                    double min_a, max_a, min_b, max_b;
+                    pso::position_bounds(*config, d, &min_a, &max_a);
+                    pso::position_bounds(*config, d + 1, &min_b, &max_b);
+                    double* a = swarm.column(d);
+                    double* b = d + 1 < dimensions ? swarm.column(d + 1) : nullptr;
+                    for (int i = begin; i < end; i++) {
+                        double u, v;
+                        rng::uniform2(pso::random_counter(i, d / 2, pso::RANDOM_INITIAL_POSITION, epoch), config->seed,
+                                      &u, &v);
+                        a[i] = min_a + u * (max_a - min_a);
+                        if (b != nullptr) {
+                            b[i] = min_b + v * (max_b - min_b);
+                        }
+                    }
+                }
+                double chunk_best_fitness = start_best;
+                evaluate(swarm, begin, end, config);
+                update_bests(swarm, begin, end, chunk, &chunk_best_fitness, true);
+            });
+            reduce_global_best(swarm, config);
+            return swarm;
+        };
+
+        void clear_cycles() {
+            this->cycles.clear();
+        }
+
+        // Starts the stopping criteria over from the current swarm, which took evaluations to get to.
+        void start_monitor(std::uint64_t evaluations) {
+            monitor.start(config.stopping, cycles.top().iterations, config.global_best_fitness, evaluations);
+        }
+
+        void record_top() {
+            if (!recorder) {
+                return;
+            }
+            PSO_PROFILE_SCOPE("io.record");
+            if (!recorder->append(cycles.top().swarm, cycles.top().iterations, config.global_best_fitness)) {
+                printf("Stopped recording\n");
+                stop_recording();
+                return;
+            }
+            // Publish progress to readers now and then rather than paying for a header rewrite every step.
+            if (recorder->iteration_count() % 64 == 0) {
+                recorder->flush();
+            }
+        }
+
+        // Replaces the run with a loaded one, keeping the settings that belong to this process.
+        void adopt_loaded(pso::History read_cycles, pso::PSOConfig read_config) {
+            if (read_cycles.empty()) {
+                printf("No iterations in file\n");
+                return;
+            }
+            stop_recording();
+            read_config.n_threads = config.n_threads;
+            read_config.history_keyframe_interval = config.history_keyframe_interval;
+            read_config.history_memory_budget_mb = config.history_memory_budget_mb;
+            read_config.history_spill_directory = config.history_spill_directory;
+            read_config.keep_history = config.keep_history;
+            this->cycles = std::move(read_cycles);
+            this->config = read_config;
+            pending_migrants.clear();
+            start_monitor(0);
+        }
+
+        /*
+         * Forgets the global best and pushes a newly initialised swarm as iteration 0, in
+         * a new epoch so its random numbers differ from the last one's. The history
+         * must be empty.
+         */
+        void start_fresh_swarm() {
+            config.global_best_x = 0;
+            config.global_best_y = 0;
+            config.global_best_position.clear();
+            config.global_best_fitness = 1e12;
+            pending_migrants.clear();
+            epoch++;
+            cycles.push({initialise_particles(config.n_particles, &config), 0, config.n_particles});
+            start_monitor(config.n_particles);
+        }
+
+        // The update mode's own state beyond the swarm, none for the synchronous update.
+        virtual void capture_update_state(checkpoint::State* state) const {
+            state->updates.clear();
+            state->ready.clear();
+        }
+
+        // Takes the update mode's state from a checkpoint, or starts it afresh for null or another file.
+        virtual void restore_update_state(const checkpoint::State*) {}
+
+        void fill_checkpoint(checkpoint::State* state) const {
+            state->config_block = pso::format_config(config);
+            state->iteration = cycles.top().iterations;
+            state->epoch = epoch;
+            state->global_best_fitness = config.global_best_fitness;
+            state->global_best_position = config.global_best_position;
+            state->swarm = cycles.top().swarm;
+            state->status = monitor.get_status();
+            state->stagnation_best = monitor.get_stagnation_best();
+            capture_update_state(state);
+            state->migrants.clear();
+            for (const pso::Migrant& migrant : pending_migrants) {
+                state->migrants.push_back(migrant.fitness);
+                state->migrants.insert(state->migrants.end(), migrant.position.begin(), migrant.position.end());
+            }
+        }
+
+        // Hands a checkpoint to the writer if one fell due since previous_iteration.
+        void checkpoint_if_due(int previous_iteration) {
+            if (!checkpointer || checkpoint_interval <= 0) {
+                return;
+            }
+            int iteration = cycles.top().iterations;
+            if (iteration / checkpoint_interval != previous_iteration / checkpoint_interval) {
+                PSO_PROFILE_SCOPE("io.checkpoint_capture");
+                fill_checkpoint(&checkpoint_state);
+                checkpointer->submit(&checkpoint_state);
+            }
+        }
+
+        pso::HistoryOptions history_options() const {
+            return {config.history_keyframe_interval, (std::size_t) std::max(0, config.history_memory_budget_mb) << 20,
+                    config.history_spill_directory, config.keep_history, swarm_pool};
+        }
+    public:
+        BasicPSO(Objective func, pso::PSOConfig cfg) : config(cfg), cycles(history_options()) {
+            this->fitness_function = std::move(func);
+            cycles.push({initialise_particles(config.n_particles, &config), 0, config.n_particles});
+            start_monitor(config.n_particles);
+        };
+
+        // Point-wise objectives are adapted with make_batch(), for the std::function instance only.
+        template<typename O = Objective,
+                 typename = std::enable_if_t<std::is_same<O, BatchFitnessFunction>::value>>
+        BasicPSO(FitnessFunction func, pso::PSOConfig cfg) : BasicPSO(make_batch(std::move(func)), cfg) {};
+
+        void forward_step() override {
+            this->step();
+        }
+
+        void step() override {
+            if (cycles.top().iterations == config.max_iterations) {
+#ifndef NDEBUG
+                printf("Max iterations reached\n");
+#endif
+                return;
+            }
+            if (monitor.get_status().reason != convergence::STOP_NONE) {
+                return;
+            }
+            PSO_PROFILE_SCOPE("step");
+            auto step_start = std::chrono::steady_clock::now();
+            pso::StoredCycle next_cycle;
+            {
+                PSO_PROFILE_SCOPE("step.copy_swarm");
+                next_cycle = {swarm_pool->acquire_copy(cycles.top().swarm), cycles.top().iterations + 1,
+                              this->config.n_particles};
+            }
+            pso::Swarm& swarm = next_cycle.swarm;
+            int n = config.n_particles;
+            apply_migrants(swarm);
+
+            r1.resize(n);
+            r2.resize(n);
+
+            // Every particle is pulled towards the global best as it stood at the start of the step.
+            global_best.assign(config.global_best_position.begin(), config.global_best_position.end());
+            global_best.resize(swarm.dimensions);
+            pso::UpdateParams params = {config.cognitive_factor, config.social_factor, config.inertia_weight,
+                                        global_best.data()};
+            // Under a local topology each particle is pulled towards its neighbourhood's best instead.
+            if (config.topology != neighbourhood::TOPOLOGY_GLOBAL) {
+                PSO_PROFILE_SCOPE("step.neighbourhoods");
+                neighbourhoods.compute(swarm, config.topology, config.neighbours, &social, thread_pool());
+                params.social = social.data();
+            }
+            double start_best = config.global_best_fitness;
+
+            fitness.resize(n);
+            int grain = chunk_size(n);
+            chunk_best.assign((n + grain - 1) / grain, -1);
+            chunk_diversity.resize(chunk_best.size());
+            int iteration = next_cycle.iterations;
+            std::atomic<std::int64_t> busy_nanoseconds{0};
+            for_each_chunk(n, grain, [&](int begin, int end, int chunk) {
+                auto chunk_start = std::chrono::steady_clock::now();
+                double chunk_best_fitness = start_best;
+                chunk_diversity[chunk].clear(swarm.dimensions);
+                // Update, evaluate and fold each tile while it is still in cache.
+                for (int tile = begin; tile < end; tile += STEP_TILE) {
+                    int tile_end = std::min(end, tile + STEP_TILE);
+                    {
+                        PSO_PROFILE_SCOPE("step.update");
+                        // Each particle draws from its own counter, so chunks can fill their coefficients independently.
+                        for (int i = tile; i < tile_end; i++) {
+                            rng::uniform2(pso::random_counter(i, iteration, pso::RANDOM_STEP_COEFFICIENTS, epoch),
+                                          config.seed, &r1[i], &r2[i]);
+                        }
+                        pso::update_positions(params, r1.data(), r2.data(), swarm, tile, tile_end);
+                    }
+                    {
+                        PSO_PROFILE_SCOPE("step.evaluate");
+                        evaluate(swarm, tile, tile_end, &this->config);
+                    }
+#ifdef PSO_TRACE
+                    for (int i = tile; i < tile_end; i++) {
+                        printf("Particle %d:", i);
+                        for (int d = 0; d < swarm.dimensions; d++) {
+                            printf(" %f", swarm.column(d)[i]);
+                        }
+                        printf("\n");
+                    }
+#endif
+                    update_bests(swarm, tile, tile_end, chunk, &chunk_best_fitness, false);
+                    chunk_diversity[chunk].add(swarm, tile, tile_end);
+                }
+                busy_nanoseconds.fetch_add(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                        std::chrono::steady_clock::now() - chunk_start).count(), std::memory_order_relaxed);
+            });
+            reduce_global_best(swarm, &this->config);
+            diversity.clear(swarm.dimensions);
+            for (const convergence::Diversity& chunk : chunk_diversity) {
+                diversity.merge(chunk);
+            }
+            double step_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - step_start).count();
+            work_stats.evaluations += n;
+            work_stats.busy_seconds += busy_nanoseconds.load() * 1e-9;
+            work_stats.wall_seconds += step_seconds;
+            work_stats.threads = std::max(1, std::min(config.n_threads, (int) chunk_best.size()));
+            PSO_PROFILE_COUNT("evaluations", n);
+            monitor.update(iteration, config.global_best_fitness, diversity, n, step_seconds);
+
+            {
+                PSO_PROFILE_SCOPE("step.history_push");
+                cycles.push(std::move(next_cycle));
+            }
+            record_top();
+            checkpoint_if_due(iteration - 1);
+        };
+
+        void backward_step() override {
+            if (cycles.size() > 1) {
+                cycles.pop();
+                if (recorder) {
+                    recorder->truncate(cycles.size());
+                }
+                monitor.resume();
+            }
+        };
+
+        void reset() override {
+            this->clear_cycles();
+            if constexpr (pso::has_reload<Objective>::value) {
+                if (fitness_function.reload()) {
+                    objective_version++;
+                }
+            }
+            start_fresh_swarm();
+            if (recorder) {
+                recorder->truncate(0);
+                record_top();
+            }
+        };
+
+        /*
+         * Saves to the binary trajectory format when the name ends in ".psot", a
+         * checkpoint of the current iteration for ".psoc", otherwise exports the text
+         * cycles.csv format.
+         */
+        void save_to_file(const std::string &filename) override {
+            if (pso::ends_with(filename, ".psot")) {
+                save_trajectory(filename);
+            } else if (pso::ends_with(filename, ".psoc")) {
+                save_checkpoint(filename);
+            } else {
+                save_csv(filename);
+            }
+        };
+
+        void load_from_file(const std::string &filename) override {
+            if (checkpoint::is_checkpoint_file(filename)) {
+                load_checkpoint(filename);
+                return;
+            }
+            if (trajectory::is_trajectory_file(filename)) {
+                load_trajectory(filename);
+            } else {
+                load_csv(filename);
+            }
+            restore_update_state(nullptr);
+        };
+
+        bool save_checkpoint(const std::string &filename) {
+            PSO_PROFILE_SCOPE("io.save_checkpoint");
+            checkpoint::State state;
+            fill_checkpoint(&state);
+            return checkpoint::write(filename, state);
+        }
+
+        /*
+         * Carries on from a checkpoint exactly where it was taken: stepping on gives the
+         * same iterations, bit for bit, as the run that wrote it. Only the checkpointed
+         * iteration is stored, the ones before it are not in the file.
+         */
+        void load_checkpoint(const std::string &filename) {
+            PSO_PROFILE_SCOPE("io.load_checkpoint");
+            checkpoint::State state;
+            if (!checkpoint::read(filename, &state)) {
+                return;
+            }
+            pso::PSOConfig read_config;
+            pso::read_config(state.config_block.data(), state.config_block.data() + state.config_block.size(),
+                             &read_config);
+            read_config.n_particles = state.swarm.size();
+            read_config.dimensions = state.swarm.dimensions;
+            read_config.global_best_position = state.global_best_position;
+            read_config.global_best_x = state.global_best_position[0];
+            read_config.global_best_y = state.swarm.dimensions > 1 ? state.global_best_position[1] : 0;
+            read_config.global_best_fitness = state.global_best_fitness;
+            pso::History read_cycles(history_options());
+            read_cycles.push({state.swarm, state.iteration, state.swarm.size()});
+            adopt_loaded(std::move(read_cycles), read_config);
+
+            epoch = state.epoch;
+            monitor.restore(config.stopping, state.status, state.stagnation_best);
+            int dimensions = state.swarm.dimensions;
+            for (std::size_t m = 0; m + dimensions < state.migrants.size(); m += dimensions + 1) {
+                pending_migrants.push_back({std::vector<double>(state.migrants.begin() + m + 1,
+                                                                state.migrants.begin() + m + 1 + dimensions),
+                                            state.migrants[m]});
+            }
+            restore_update_state(&state);
+        }
+
+        /*
+         * Checkpoints to filename every interval iterations from now on. The state is
+         * copied between two steps and written on a thread of its own, each checkpoint
+         * replacing the last.
+         */
+        void start_checkpointing(const std::string &filename, int interval) {
+            checkpointer = std::make_unique<checkpoint::Writer>(filename);
+            checkpoint_interval = std::max(1, interval);
+        }
+
+        // Checkpoints now rather than when the next one falls due.
+        void checkpoint_now() {
+            if (checkpointer) {
+                fill_checkpoint(&checkpoint_state);
+                checkpointer->submit(&checkpoint_state);
+            }
+        }
+
+        // Waits for checkpoints still being written and stops checkpointing.
+        void stop_checkpointing() {
+            checkpointer.reset();
+        }
+
+        bool is_checkpointing() const {
+            return checkpointer != nullptr;
+        }
+
+        /*
+         * Writes the cycles.csv text format. Each row is formatted in chunks on the
+         * thread pool and the chunks are written out in order.
+         */
+        void save_csv(const std::string &filename) {
+            PSO_PROFILE_SCOPE("io.save_csv");
+            FILE* file = fopen(filename.c_str(), "w");
+            if (file == nullptr) {
+                printf("Error opening file\n");
+                return;
+            }
+            setvbuf(file, nullptr, _IOFBF, 1 << 20);
+            // Save config
+            std::string header = pso::format_config(config) + "\n\n\n\n";
+            bool ok = fwrite(header.data(), 1, header.size(), file) == header.size();
+
+            std::vector<std::string> text;
+            cycles.for_each([&](const pso::StoredCycle& cycle) {
+                int n = cycle.n_particles;
+                int grain = chunk_size(n);
+                text.resize((n + grain - 1) / grain);
+                for_each_chunk(n, grain, [&](int begin, int end, int chunk) {
+                    std::string& out = text[chunk];
+                    out.clear();
+                    if (begin != 0) {
+                        out += ',';
+                    }
+                    cycles_csv::append_points(out, cycle.swarm.position.data(), cycle.swarm.stride,
+                                              cycle.swarm.dimensions, begin, end);
+                });
+                for (const std::string& part : text) {
+                    ok = ok && fwrite(part.data(), 1, part.size(), file) == part.size();
+                }
+                ok = ok && fputc('\n', file) != EOF;
+            });
+
+            if (fclose(file) != 0 || !ok) {
+                printf("Error writing file\n");
+            }
+        };
+
+        /*
+         * Reads the cycles.csv text format straight from a mapping of the file. Rows
+         * are parsed in parallel batches, then pushed in order. The format only holds
+         * positions, so the personal and global bests are rebuilt by evaluating each
+         * row the way step() would have.
+         */
+        void load_csv(const std::string &filename) {
+            PSO_PROFILE_SCOPE("io.load_csv");
+            MappedFile map;
+            if (!map.open(filename)) {
+                printf("Error opening file\n");
+                return;
+            }
+            const char* begin = reinterpret_cast<const char*>(map.data());
+            const char* end = begin + map.size();
+
+            // Load config
+            pso::PSOConfig read_config;
+            const char* data = pso::read_config(begin, end, &read_config);
+            int n = read_config.n_particles;
+            int dimensions = read_config.dimensions;
+            if (n <= 0 || dimensions <= 0) {
+                printf("Error reading file\n");
+                return;
+            }
+
+            // Load data
+            pso::Swarm swarm;
+            swarm.resize(n, dimensions);
+            std::vector<std::string_view> rows = cycles_csv::split_rows(data, end);
+            int batch = (int) std::min<std::size_t>(rows.size(), std::max(1, config.n_threads) * 4);
+            std::vector<pso::AlignedVector<double>> positions(batch, pso::AlignedVector<double>(swarm.position.size()));
+            std::vector<char> parsed(batch);
+
+            pso::History read_cycles(history_options());
+            bool malformed = false;
+            for (std::size_t first = 0; first < rows.size() && !malformed; first += batch) {
+                int count = (int) std::min<std::size_t>(batch, rows.size() - first);
+                for_each_chunk(count, 1, [&](int row, int, int) {
+                    parsed[row] = cycles_csv::parse_row(rows[first + row], positions[row].data(), swarm.stride,
+                                                        dimensions, n);
+                });
+                for (int row = 0; row < count; row++) {
+                    std::size_t iter = first + row;
+                    if (!parsed[row]) {
+                        printf("Malformed row %zu, loaded the %zu rows before it\n", iter + 1, iter);
+                        malformed = true;
+                        break;
+                    }
+                    // Swapping hands the previous row's buffers back for the next batch.
+                    swarm.position.swap(positions[row]);
+                    rebuild_bests(swarm, iter == 0, &read_config);
+                    read_cycles.push({swarm, (int) iter, n});
+                }
+            }
+            adopt_loaded(std::move(read_cycles), read_config);
+        };
+
+        void save_trajectory(const std::string &filename, std::uint32_t columns = trajectory::COLUMNS_ALL) {
+            PSO_PROFILE_SCOPE("io.save_trajectory");
+            trajectory::Writer writer;
+            if (!writer.open(filename, pso::format_config(config), config.n_particles, config.dimensions, columns)) {
+                return;
+            }
+            cycles.for_each([&writer](const pso::StoredCycle& cycle) {
+                int best = pso::best_particle(cycle.swarm);
+                writer.append(cycle.swarm, cycle.iterations, best >= 0 ? cycle.swarm.best_fitness[best] : 0.0);
+            });
+            writer.close();
+        }
+
+        void load_trajectory(const std::string &filename) {
+            PSO_PROFILE_SCOPE("io.load_trajectory");
+            trajectory::Reader reader;
+            if (!reader.open(filename)) {
+                printf("Error opening file\n");
+                return;
+            }
+            pso::PSOConfig read_config;
+            std::string config_block = reader.config_block();
+            pso::read_config(config_block.data(), config_block.data() + config_block.size(), &read_config);
+            read_config.n_particles = reader.n_particles();
+            read_config.dimensions = reader.dimensions();
+
+            pso::History read_cycles(history_options());
+            std::size_t n = reader.n_particles();
+            auto copy_column = [&reader, n](std::uint64_t index, trajectory::Column column, int d, double* out) {
+                const double* values = reader.column(index, column, d);
+                if (values != nullptr) {
+                    std::copy(values, values + n, out);
+                }
+            };
+            // A file of positions alone has its bests rebuilt by evaluating each block, as load_csv does.
+            bool has_bests = (reader.columns() & trajectory::COLUMNS_ALL) == trajectory::COLUMNS_ALL;
+            pso::Swarm rebuilt;
+            rebuilt.resize(reader.n_particles(), reader.dimensions());
+            for (std::uint64_t i = 0; i < reader.iteration_count(); i++) {
+                if (!has_bests) {
+                    for (int d = 0; d < rebuilt.dimensions; d++) {
+                        copy_column(i, trajectory::COLUMN_POSITION, d, rebuilt.column(d));
+                    }
+                    rebuild_bests(rebuilt, i == 0, &read_config);
+                    read_cycles.push({rebuilt, reader.block(i).iteration, reader.n_particles()});
+                    continue;
+                }
+                pso::Swarm swarm;
+                swarm.resize(reader.n_particles(), reader.dimensions());
+                for (int d = 0; d < swarm.dimensions; d++) {
+                    copy_column(i, trajectory::COLUMN_POSITION, d, swarm.column(d));
+                    copy_column(i, trajectory::COLUMN_BEST_POSITION, d, swarm.best_column(d));
+                }
+                copy_column(i, trajectory::COLUMN_BEST_FITNESS, 0, swarm.best_fitness.data());
+                read_cycles.push({std::move(swarm), reader.block(i).iteration, reader.n_particles()});
+            }
+            adopt_loaded(std::move(read_cycles), read_config);
+
+            // The global best is the lowest personal best; rebuilt bests already set it in read_config.
+            if (!cycles.empty() && has_bests) {
+                const pso::Swarm& swarm = cycles.top().swarm;
+                int best = pso::best_particle(swarm);
+                if (best >= 0) {
+                    pso::set_global_best(&config, swarm, best, true);
+                    config.global_best_fitness = swarm.best_fitness[best];
+                }
+            }
+        }
+
+        /*
+         * Streams every stored iteration, then each new one as it is stepped, to a
+         * trajectory file. Backward steps and resets rewind the file to match.
+         */
+        bool start_recording(const std::string &filename, std::uint32_t columns = trajectory::COLUMNS_ALL) {
+            auto writer = std::make_unique<trajectory::Writer>();
+            if (!writer->open(filename, pso::format_config(config), config.n_particles, config.dimensions, columns)) {
+                return false;
+            }
+            cycles.for_each([&writer](const pso::StoredCycle& cycle) {
+                int best = pso::best_particle(cycle.swarm);
+                writer->append(cycle.swarm, cycle.iterations, best >= 0 ? cycle.swarm.best_fitness[best] : 0.0);
+            });
+            writer->flush();
+            recorder = std::move(writer);
+            return true;
+        }
+
+        void stop_recording() {
+            recorder.reset();
+        }
+
+        bool is_recording() const {
+            return recorder != nullptr;
+        }
+
+        AppConfig get_config() override {
+            return config;
+        };
+
+        pso::PSOConfig get_pso_config() const {
+            return config;
+        }
+
+        int get_iteration() const {
+            return cycles.top().iterations;
+        }
+
+        // Rebuilds stored iteration index (0 is the oldest) without disturbing the current one.
+        bool get_stored_cycle(int index, pso::StoredCycle* out) const {
+            if (index < 0 || index >= (int) cycles.size()) {
+                return false;
+            }
+            cycles.seek(index, out);
+            return true;
+        }
+
+        int get_stored_cycle_count() const {
+            return (int) cycles.size();
+        }
+
+        // Copies the current iteration into out, reusing its buffers. Dimensions are clamped to the swarm's.
+        void fill_snapshot(pso::Snapshot* out, int dim_x, int dim_y) {
+            const pso::Swarm& swarm = cycles.top().swarm;
+            int last = std::max(0, swarm.dimensions - 1);
+            out->dims[0] = std::clamp(dim_x, 0, last);
+            out->dims[1] = std::clamp(dim_y, 0, last);
+            out->config = config;
+            out->iteration = get_iteration();
+            out->stored_cycles = get_stored_cycle_count();
+            out->recording = is_recording();
+            if (swarm.dimensions > 0) {
+                out->xs.assign(swarm.column(out->dims[0]), swarm.column(out->dims[0]) + swarm.size());
+                out->ys.assign(swarm.column(out->dims[1]), swarm.column(out->dims[1]) + swarm.size());
+            } else {
+                out->xs.clear();
+                out->ys.clear();
+            }
+            char title[256];
+            format_title(title, sizeof(title));
+            out->title.assign(title);
+            out->objective_version = objective_version;
+            out->convergence = monitor.get_status();
+        }
+
+        // The count particles with the lowest personal bests in the current iteration, best first.
+        std::vector<pso::Migrant> best_particles(int count) const {
+            const pso::Swarm& swarm = cycles.top().swarm;
+            std::vector<int> order(swarm.size());
+            for (int i = 0; i < swarm.size(); i++) {
+                order[i] = i;
+            }
+            count = std::max(0, std::min(count, swarm.size()));
+            std::partial_sort(order.begin(), order.begin() + count, order.end(), [&swarm](int a, int b) {
+                return swarm.best_fitness[a] < swarm.best_fitness[b] ||
+                       (swarm.best_fitness[a] == swarm.best_fitness[b] && a < b);
+            });
+            std::vector<pso::Migrant> out(count);
+            for (int m = 0; m < count; m++) {
+                out[m].position.resize(swarm.dimensions);
+                for (int d = 0; d < swarm.dimensions; d++) {
+                    out[m].position[d] = swarm.best_column(d)[order[m]];
+                }
+                out[m].fitness = swarm.best_fitness[order[m]];
+            }
+            return out;
+        }
+
+        /*
+         * Hands particles from another swarm to this one. A migrant better than the global
+         * best becomes it straight away; the swarm itself takes them in at the next step.
+         */
+        void add_migrants(const std::vector<pso::Migrant>& migrants) {
+            for (const pso::Migrant& migrant : migrants) {
+                if ((int) migrant.position.size() != config.dimensions) {
+                    continue;
+                }
+                if (migrant.fitness < config.global_best_fitness) {
+                    config.global_best_position = migrant.position;
+                    config.global_best_x = migrant.position[0];
+                    config.global_best_y = migrant.position.size() > 1 ? migrant.position[1] : 0;
+                    config.global_best_fitness = migrant.fitness;
+                }
+                pending_migrants.push_back(migrant);
+            }
+        }
+
+        // Why stepping has stopped, STOP_NONE while it can go on.
+        convergence::StopReason get_stop_reason() const {
+            if (monitor.get_status().reason != convergence::STOP_NONE) {
+                return monitor.get_status().reason;
+            }
+            return cycles.top().iterations >= config.max_iterations ? convergence::STOP_MAX_ITERATIONS
+                                                                   : convergence::STOP_NONE;
+        }
+
+        const convergence::Status& get_convergence_status() const {
+            return monitor.get_status();
+        }
+
+        // Changes the stopping criteria mid-run, a stopped run whose rule no longer holds can step again.
+        void set_stopping_criteria(const convergence::StoppingCriteria& stopping) {
+            config.stopping = stopping;
+            monitor.set_criteria(stopping);
+        }
+
+        // Totals over every step() since construction.
+        pso::WorkStats get_work_stats() const {
+            return work_stats;
+        }
+
+        // Swarms handed out for steps, copies and resets, and how many of them needed fresh buffers.
+        std::size_t get_swarms_acquired() const {
+            return swarm_pool->acquired_count();
+        }
+
+        std::size_t get_swarms_allocated() const {
+            return swarm_pool->allocated_count();
+        }
+
+        pso::HistoryStats get_history_stats() const {
+            return cycles.stats();
+        }
+
+        void set_history_memory_budget(int megabytes) {
+            config.history_memory_budget_mb = megabytes;
+            cycles.set_memory_budget(history_options().memory_budget);
+        }
+
+        std::string get_title() override {
+            char title[256];
+            format_title(title, sizeof(title));
+            return title;
+        };
+
+        // The title into a caller's buffer, so a snapshot per frame can take it without allocating.
+        void format_title(char* out, std::size_t size) const {
+            convergence::StopReason reason = monitor.get_status().reason;
+            snprintf(out, size, "Global Best Fitness: %f Iterations: %d/%d(%d)%s%s", config.global_best_fitness,
+                     cycles.top().iterations + 1, (int) cycles.size(), config.max_iterations,
+                     reason != convergence::STOP_NONE ? " Stopped: " : "",
+                     reason != convergence::STOP_NONE ? convergence::stop_reason_name(reason) : "");
+        }
+    };
+
+    using PSO = BasicPSO<BatchFitnessFunction>;
+}
+#endif //PSO_H
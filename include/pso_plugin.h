@@ -0,0 +1,58 @@
+/*
+ * C ABI for objective plugins: shared libraries the PSO loads at run time.
+ *
+ * A plugin exports pso_objective_plugin(), returning a PsoObjectivePlugin that
+ * lives as long as the library. The host rejects a table whose abi_version differs
+ * from its own PSO_PLUGIN_ABI_VERSION; later versions only append fields, and
+ * struct_size says how much of the table the plugin filled in.
+ *
+ * evaluate() gets a whole batch at once: coordinate d of point i is
+ * positions[d * stride + i], and it writes fitness[i] for i < count, lower being
+ * better. It is called from several threads at once on disjoint batches, so it
+ * must not keep state between calls.
+ */
+#ifndef PSO_PLUGIN_H
+#define PSO_PLUGIN_H
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define PSO_PLUGIN_ABI_VERSION 1u
+#define PSO_PLUGIN_ENTRY_POINT "pso_objective_plugin"
+
+#if defined(_WIN32)
+#define PSO_PLUGIN_EXPORT __declspec(dllexport)
+#else
+#define PSO_PLUGIN_EXPORT __attribute__((visibility("default")))
+#endif
+
+/* The run's settings an objective may depend on. */
+typedef struct PsoPluginContext {
+    double goal_x;
+    double goal_y;
+    double min_x;
+    double max_x;
+    double min_y;
+    double max_y;
+} PsoPluginContext;
+
+typedef void (*PsoEvaluateFunction)(const double* positions, size_t stride, size_t count, int dimensions,
+                                    double* fitness, const PsoPluginContext* context);
+
+typedef struct PsoObjectivePlugin {
+    uint32_t abi_version;
+    uint32_t struct_size;
+    /* Shown in the GUI and the headless report. */
+    const char* name;
+    PsoEvaluateFunction evaluate;
+} PsoObjectivePlugin;
+
+typedef const PsoObjectivePlugin* (*PsoPluginEntryPoint)(void);
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* PSO_PLUGIN_H */
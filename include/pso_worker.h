@@ -0,0 +1,150 @@
+/*
+ * Protocol for objective worker processes: separate programs, such as simulators,
+ * that evaluate batches for the PSO (see worker_pool.h). POSIX only.
+ *
+ * The PSO starts each worker with one end of a Unix domain socket on the file
+ * descriptor named by the PSO_WORKER_FD environment variable. The worker sends a
+ * PsoWorkerHello, then answers requests one at a time until the socket closes:
+ *
+ *   request   PsoWorkerRequest, then dimensions columns of count doubles
+ *   response  PsoWorkerResponse with the request's id, then count fitness values
+ *
+ * Both ends run on the same host, so everything is in its native byte order. A
+ * worker that exits, crashes, hangs past the timeout or answers anything else is
+ * restarted, and its request is sent again.
+ *
+ * pso_worker_serve() runs the worker's side around a PsoEvaluateFunction, the same
+ * one a plugin exports, so an objective can be built either way.
+ */
+#ifndef PSO_WORKER_H
+#define PSO_WORKER_H
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "pso_plugin.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define PSO_WORKER_PROTOCOL_VERSION 1u
+/* "PSOW" in memory on little-endian hosts. */
+#define PSO_WORKER_MAGIC 0x574F5350u
+#define PSO_WORKER_FD_ENV "PSO_WORKER_FD"
+
+typedef struct PsoWorkerHello {
+    uint32_t magic;
+    uint32_t version;
+} PsoWorkerHello;
+
+typedef struct PsoWorkerRequest {
+    uint32_t magic;
+    uint32_t count;
+    uint64_t id;
+    int32_t dimensions;
+    uint32_t reserved;
+    PsoPluginContext context;
+} PsoWorkerRequest;
+
+typedef struct PsoWorkerResponse {
+    uint32_t magic;
+    uint32_t count;
+    uint64_t id;
+} PsoWorkerResponse;
+
+static inline int pso_worker_read_all(int fd, void* data, size_t size) {
+    char* p = (char*) data;
+    while (size > 0) {
+        ssize_t got = read(fd, p, size);
+        if (got < 0 && errno == EINTR) {
+            continue;
+        }
+        if (got <= 0) {
+            return 0;
+        }
+        p += got;
+        size -= (size_t) got;
+    }
+    return 1;
+}
+
+static inline int pso_worker_write_all(int fd, const void* data, size_t size) {
+    const char* p = (const char*) data;
+    while (size > 0) {
+        ssize_t put = write(fd, p, size);
+        if (put < 0 && errno == EINTR) {
+            continue;
+        }
+        if (put <= 0) {
+            return 0;
+        }
+        p += put;
+        size -= (size_t) put;
+    }
+    return 1;
+}
+
+/*
+ * Answers the PSO's requests with evaluate until it closes the socket. Returns 0
+ * then, 1 if the socket is missing or a message could not be read or written.
+ */
+static inline int pso_worker_serve(PsoEvaluateFunction evaluate) {
+    const char* fd_value = getenv(PSO_WORKER_FD_ENV);
+    int fd = fd_value != NULL ? atoi(fd_value) : -1;
+    PsoWorkerHello hello = {PSO_WORKER_MAGIC, PSO_WORKER_PROTOCOL_VERSION};
+    PsoWorkerRequest request;
+    PsoWorkerResponse response;
+    double* positions = NULL;
+    double* fitness = NULL;
+    size_t capacity = 0;
+    int status = 1;
+    if (fd < 0 || !pso_worker_write_all(fd, &hello, sizeof(hello))) {
+        return 1;
+    }
+    while (1) {
+        size_t count, values;
+        if (!pso_worker_read_all(fd, &request, sizeof(request))) {
+            /* The PSO closed the socket, or went away. */
+            status = 0;
+            break;
+        }
+        if (request.magic != PSO_WORKER_MAGIC || request.dimensions <= 0) {
+            break;
+        }
+        count = request.count;
+        values = count * (size_t) request.dimensions;
+        if (values > capacity) {
+            double* grown_positions = (double*) realloc(positions, values * sizeof(double));
+            double* grown_fitness = grown_positions != NULL ? (double*) realloc(fitness, values * sizeof(double)) : NULL;
+            if (grown_positions != NULL) {
+                positions = grown_positions;
+            }
+            if (grown_fitness == NULL) {
+                break;
+            }
+            fitness = grown_fitness;
+            capacity = values;
+        }
+        if (!pso_worker_read_all(fd, positions, values * sizeof(double))) {
+            break;
+        }
+        evaluate(positions, count, count, request.dimensions, fitness, &request.context);
+        response.magic = PSO_WORKER_MAGIC;
+        response.count = request.count;
+        response.id = request.id;
+        if (!pso_worker_write_all(fd, &response, sizeof(response)) ||
+            !pso_worker_write_all(fd, fitness, count * sizeof(double))) {
+            break;
+        }
+    }
+    free(positions);
+    free(fitness);
+    return status;
+}
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* PSO_WORKER_H */
@@ -0,0 +1,100 @@
+//
+// Counter-based random numbers (Philox4x32-10, Salmon et al. 2011).
+//
+#ifndef RNG_H
+#define RNG_H
+#include <cstdint>
+
+namespace algos {
+    namespace rng {
+        /*
+         * Philox maps a 128-bit counter and a 64-bit key to 128 random bits with no
+         * hidden state, so any draw can be made from any thread, in any order, and
+         * the same (key, counter) always gives the same numbers.
+         */
+        struct Counter {
+            std::uint32_t v[4];
+        };
+
+        inline std::uint32_t mulhilo(std::uint32_t a, std::uint32_t b, std::uint32_t* hi) {
+            std::uint64_t product = (std::uint64_t) a * b;
+            *hi = (std::uint32_t) (product >> 32);
+            return (std::uint32_t) product;
+        }
+
+        inline Counter philox4x32(Counter ctr, std::uint64_t key) {
+            const std::uint32_t M0 = 0xD2511F53, M1 = 0xCD9E8D57;
+            const std::uint32_t W0 = 0x9E3779B9, W1 = 0xBB67AE85;
+            std::uint32_t k0 = (std::uint32_t) key;
+            std::uint32_t k1 = (std::uint32_t) (key >> 32);
+            for (int round = 0; round < 10; round++) {
+                std::uint32_t hi0, hi1;
+                std::uint32_t lo0 = mulhilo(M0, ctr.v[0], &hi0);
+                std::uint32_t lo1 = mulhilo(M1, ctr.v[2], &hi1);
+                ctr = {{hi1 ^ ctr.v[1] ^ k0, lo1, hi0 ^ ctr.v[3] ^ k1, lo0}};
+                k0 += W0;
+                k1 += W1;
+            }
+            return ctr;
+        }
+
+        // Uniform double in [0, 1) from the top 53 bits.
+        inline double to_unit(std::uint32_t hi, std::uint32_t lo) {
+            std::uint64_t bits = ((std::uint64_t) hi << 32) | lo;
+            return (double) (bits >> 11) * (1.0 / 9007199254740992.0);
+        }
+
+        // Two uniform doubles in [0, 1) from one Philox block.
+        inline void uniform2(Counter ctr, std::uint64_t key, double* a, double* b) {
+            Counter out = philox4x32(ctr, key);
+            *a = to_unit(out.v[0], out.v[1]);
+            *b = to_unit(out.v[2], out.v[3]);
+        }
+
+        /*
+         * A sequential stream on top of Philox. split() derives an independent child
+         * stream, e.g. one per particle or per thread, without touching this one.
+         */
+        class Stream {
+        private:
+            std::uint64_t key = 0;
+            std::uint64_t stream = 0;
+            std::uint64_t position = 0;
+            Counter block{};
+            int used = 4;
+
+        public:
+            Stream() = default;
+            Stream(std::uint64_t seed, std::uint64_t stream_id) : key(seed), stream(stream_id) {}
+
+            std::uint32_t next_u32() {
+                if (used == 4) {
+                    Counter ctr = {{(std::uint32_t) position, (std::uint32_t) (position >> 32),
+                                    (std::uint32_t) stream, (std::uint32_t) (stream >> 32)}};
+                    block = philox4x32(ctr, key);
+                    position++;
+                    used = 0;
+                }
+                return block.v[used++];
+            }
+
+            double uniform() {
+                std::uint32_t hi = next_u32();
+                std::uint32_t lo = next_u32();
+                return to_unit(hi, lo);
+            }
+
+            double uniform(double min, double max) {
+                return min + uniform() * (max - min);
+            }
+
+            Stream split(std::uint64_t child) const {
+                // Hash the child id into the key so children never share counters with the parent.
+                Counter mixed = philox4x32({{(std::uint32_t) child, (std::uint32_t) (child >> 32),
+                                             (std::uint32_t) stream, (std::uint32_t) (stream >> 32)}}, key);
+                return Stream(((std::uint64_t) mixed.v[0] << 32) | mixed.v[1], child);
+            }
+        };
+    }
+}
+#endif //RNG_H
@@ -2,6 +2,7 @@
 #define SEARCHERS_H
 #include <string>
 #include <functional>
+#include <cstddef>
 
 namespace algos {
     struct AppConfig {
@@ -41,8 +42,62 @@ namespace algos {
 
         virtual void plot();
         virtual bool should_step();
+        // Starts or pauses optimisers that step on their own thread, fast_forward steps without waiting.
+        virtual void set_running(bool running, bool fast_forward);
     };
 
     typedef std::function<double(double, double, AppConfig*)> FitnessFunction;
+
+    // Non-owning view over a contiguous array, stand-in for C++20 std::span.
+    template<typename T>
+    struct Span {
+        T* ptr = nullptr;
+        std::size_t count = 0;
+
+        Span() = default;
+        Span(T* data, std::size_t size) : ptr(data), count(size) {}
+
+        T* data() const { return ptr; }
+        std::size_t size() const { return count; }
+        T& operator[](std::size_t i) const { return ptr[i]; }
+        T* begin() const { return ptr; }
+        T* end() const { return ptr + count; }
+    };
+
+    /*
+     * Non-owning view of a batch of points stored column by column: coordinate d of
+     * point i is column(d)[i]. Columns are stride doubles apart.
+     */
+    struct Points {
+        const double* ptr = nullptr;
+        std::size_t stride = 0;
+        std::size_t count = 0;
+        int dims = 0;
+
+        Points() = default;
+        Points(const double* data, std::size_t column_stride, std::size_t size, int dimensions)
+            : ptr(data), stride(column_stride), count(size), dims(dimensions) {}
+
+        const double* column(int d) const { return ptr + d * stride; }
+        std::size_t size() const { return count; }
+        int dimensions() const { return dims; }
+    };
+
+    /*
+     * Evaluates a whole batch of points in one call: fitness[i] = f(point i).
+     * fitness has one entry per point.
+     */
+    typedef std::function<void(Points points, Span<double> fitness, AppConfig*)> BatchFitnessFunction;
+
+    // Adapts a two-dimensional point-wise fitness function to the batch interface.
+    inline BatchFitnessFunction make_batch(FitnessFunction func) {
+        return [func = std::move(func)](Points points, Span<double> fitness, AppConfig* config) {
+            const double* xs = points.column(0);
+            const double* ys = points.dimensions() > 1 ? points.column(1) : nullptr;
+            for (std::size_t i = 0; i < fitness.size(); i++) {
+                fitness[i] = func(xs[i], ys != nullptr ? ys[i] : 0.0, config);
+            }
+        };
+    }
 }
 #endif //SEARCHERS_H
\ No newline at end of file
@@ -0,0 +1,163 @@
+//
+// Dedicated thread that steps an optimiser independently of the render loop.
+//
+#ifndef SIMULATION_THREAD_H
+#define SIMULATION_THREAD_H
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+namespace algos {
+    /*
+     * Steps an optimiser on its own thread, either one step per interval (timed) or
+     * as fast as it can (fast-forward), and publishes its state after stepping.
+     * Fast-forward publishes at most every PUBLISH_INTERVAL, nobody can look faster.
+     *
+     * Anything else touching the optimiser goes through exclusive(), which runs
+     * between two steps and publishes afterwards. The callbacks always run under
+     * the same lock, so they never overlap.
+     */
+    class SimulationThread {
+    public:
+        enum Mode {
+            MODE_TIMED = 0,
+            MODE_FAST_FORWARD = 1,
+        };
+
+        struct Callbacks {
+            // Advances one step, returns false when there was nothing left to step.
+            std::function<bool()> step;
+            // Copies the optimiser's state out for the viewer.
+            std::function<void()> publish;
+            // Seconds between steps in timed mode.
+            std::function<double()> interval;
+        };
+
+        static constexpr std::chrono::milliseconds PUBLISH_INTERVAL{8};
+
+    private:
+        Callbacks callbacks;
+
+        // Held while the callbacks or an exclusive() function run.
+        std::mutex state_mutex;
+        // exclusive() callers waiting for state_mutex, the worker lets them in before stepping again.
+        std::atomic<int> waiting{0};
+
+        std::mutex control_mutex;
+        std::condition_variable wake;
+        bool running = false;
+        bool stopping = false;
+        // The last step had nothing to do, so wait for exclusive() or set_running() to change something.
+        bool exhausted = false;
+        Mode mode = MODE_TIMED;
+
+        std::chrono::steady_clock::time_point last_publish{};
+        std::thread worker;
+
+        void loop() {
+            bool unpublished = false;
+            while (true) {
+                Mode current;
+                {
+                    std::unique_lock<std::mutex> lock(control_mutex);
+                    if ((!running || exhausted) && unpublished) {
+                        lock.unlock();
+                        std::lock_guard<std::mutex> state(lock_state());
+                        callbacks.publish();
+                        unpublished = false;
+                        continue;
+                    }
+                    wake.wait(lock, [this] { return stopping || (running && !exhausted); });
+                    if (stopping) {
+                        return;
+                    }
+                    current = mode;
+                }
+
+                bool stepped;
+                double interval;
+                {
+                    std::lock_guard<std::mutex> state(lock_state());
+                    stepped = callbacks.step();
+                    interval = callbacks.interval();
+                    auto now = std::chrono::steady_clock::now();
+                    if (current == MODE_TIMED || !stepped || now - last_publish >= PUBLISH_INTERVAL) {
+                        callbacks.publish();
+                        last_publish = now;
+                        unpublished = false;
+                    } else {
+                        unpublished = true;
+                    }
+                }
+
+                std::unique_lock<std::mutex> lock(control_mutex);
+                if (!stepped) {
+                    exhausted = true;
+                } else if (current == MODE_TIMED) {
+                    // Pausing, switching mode or stopping cuts the wait short.
+                    wake.wait_for(lock, std::chrono::duration<double>(std::max(0.0, interval)),
+                                  [this] { return stopping || !running || mode != MODE_TIMED; });
+                }
+            }
+        }
+
+        // Takes state_mutex after yielding to any exclusive() caller queued for it.
+        std::mutex& lock_state() {
+            while (waiting.load(std::memory_order_acquire) > 0) {
+                std::this_thread::yield();
+            }
+            return state_mutex;
+        }
+
+    public:
+        explicit SimulationThread(Callbacks cbs) : callbacks(std::move(cbs)) {
+            worker = std::thread(&SimulationThread::loop, this);
+        }
+
+        ~SimulationThread() {
+            {
+                std::lock_guard<std::mutex> lock(control_mutex);
+                stopping = true;
+            }
+            wake.notify_all();
+            worker.join();
+        }
+
+        SimulationThread(const SimulationThread&) = delete;
+        SimulationThread& operator=(const SimulationThread&) = delete;
+
+        void set_running(bool run, Mode new_mode) {
+            {
+                std::lock_guard<std::mutex> lock(control_mutex);
+                if (running == run && mode == new_mode) {
+                    return;
+                }
+                running = run;
+                mode = new_mode;
+                exhausted = false;
+            }
+            wake.notify_all();
+        }
+
+        // Runs body with the optimiser to itself, between two steps, then publishes.
+        void exclusive(const std::function<void()>& body) {
+            {
+                waiting.fetch_add(1, std::memory_order_acq_rel);
+                std::lock_guard<std::mutex> state(state_mutex);
+                waiting.fetch_sub(1, std::memory_order_acq_rel);
+                body();
+                callbacks.publish();
+            }
+            {
+                std::lock_guard<std::mutex> lock(control_mutex);
+                exhausted = false;
+            }
+            wake.notify_all();
+        }
+    };
+}
+#endif //SIMULATION_THREAD_H
@@ -0,0 +1,311 @@
+//
+// Structure-of-arrays swarm storage and the vectorised particle update kernel.
+//
+#ifndef SWARM_H
+#define SWARM_H
+#include <cstddef>
+#include <new>
+#include <utility>
+#include <vector>
+
+// Define PSO_SCALAR_KERNEL to force the portable loop, e.g. to compare against the SIMD paths.
+#if !defined(PSO_SCALAR_KERNEL) && (defined(__AVX2__) || defined(__SSE2__) || defined(_M_X64))
+#include <immintrin.h>
+#endif
+
+namespace algos {
+    namespace pso {
+        // Cache line alignment, also enough for any AVX/AVX-512 load.
+        constexpr std::size_t SWARM_ALIGNMENT = 64;
+
+        template<typename T>
+        struct AlignedAllocator {
+            typedef T value_type;
+
+            AlignedAllocator() = default;
+            template<typename U>
+            AlignedAllocator(const AlignedAllocator<U>&) {}
+
+            T* allocate(std::size_t n) {
+                return static_cast<T*>(::operator new(n * sizeof(T), std::align_val_t(SWARM_ALIGNMENT)));
+            }
+
+            void deallocate(T* p, std::size_t) {
+                ::operator delete(p, std::align_val_t(SWARM_ALIGNMENT));
+            }
+
+            template<typename U>
+            bool operator==(const AlignedAllocator<U>&) const { return true; }
+            template<typename U>
+            bool operator!=(const AlignedAllocator<U>&) const { return false; }
+        };
+
+        template<typename T>
+        using AlignedVector = std::vector<T, AlignedAllocator<T>>;
+
+        /*
+         * The swarm stored as structure-of-arrays so the update loop streams through
+         * contiguous memory and can be vectorised. Positions and personal bests are
+         * each one array of dimensions columns, coordinate d of particle i at
+         * d * stride + i, with stride padded so every column starts on a cache line.
+         */
+        struct Swarm {
+            AlignedVector<double> position;
+            AlignedVector<double> best_position;
+            AlignedVector<double> best_fitness;
+            int n_particles = 0;
+            int dimensions = 0;
+            std::size_t stride = 0;
+
+            int size() const {
+                return n_particles;
+            }
+
+            // Lays the swarm out for n particles in dims dimensions, contents are not kept.
+            void resize(int n, int dims) {
+                const std::size_t per_line = SWARM_ALIGNMENT / sizeof(double);
+                n_particles = n;
+                dimensions = dims;
+                stride = (n + per_line - 1) / per_line * per_line;
+                // Columns a multiple of 4 KiB apart alias in L1 and in store forwarding, so skip a line.
+                if (stride * sizeof(double) % 4096 == 0) {
+                    stride += per_line;
+                }
+                position.assign(stride * dims, 0.0);
+                best_position.assign(stride * dims, 0.0);
+                best_fitness.assign(n, 0.0);
+            }
+
+            double* column(int d) {
+                return position.data() + d * stride;
+            }
+
+            const double* column(int d) const {
+                return position.data() + d * stride;
+            }
+
+            double* best_column(int d) {
+                return best_position.data() + d * stride;
+            }
+
+            const double* best_column(int d) const {
+                return best_position.data() + d * stride;
+            }
+        };
+
+        /*
+         * Spare swarm buffers kept for reuse, so that once a run is going, stepping
+         * forward and back recycles the buffers of the swarms it drops instead of
+         * allocating. Only a few are kept, a spare full-size swarm costs as much RAM as
+         * the live one. Used from the stepping thread only.
+         */
+        class SwarmPool {
+        private:
+            static constexpr std::size_t MAX_SPARE = 4;
+
+            std::vector<Swarm> spare;
+            std::size_t acquired = 0;
+            std::size_t allocated = 0;
+
+        public:
+            SwarmPool() {
+                spare.reserve(MAX_SPARE);
+            }
+
+            // A swarm laid out for n particles in dims dimensions, its contents are unspecified.
+            Swarm acquire(int n, int dims) {
+                acquired++;
+                for (std::size_t i = spare.size(); i-- > 0;) {
+                    if (spare[i].n_particles == n && spare[i].dimensions == dims) {
+                        Swarm swarm = std::move(spare[i]);
+                        spare[i] = std::move(spare.back());
+                        spare.pop_back();
+                        return swarm;
+                    }
+                }
+                allocated++;
+                Swarm swarm;
+                swarm.resize(n, dims);
+                return swarm;
+            }
+
+            Swarm acquire_copy(const Swarm& from) {
+                Swarm swarm = acquire(from.n_particles, from.dimensions);
+                // Same layout, so the copy reuses the buffers.
+                swarm = from;
+                return swarm;
+            }
+
+            // Takes swarm's buffers back, or frees them if the pool is full.
+            void release(Swarm&& swarm) {
+                if (swarm.position.empty() || spare.size() == MAX_SPARE) {
+                    return;
+                }
+                spare.push_back(std::move(swarm));
+            }
+
+            // Swarms handed out, and how many of them needed fresh buffers.
+            std::size_t acquired_count() const {
+                return acquired;
+            }
+
+            std::size_t allocated_count() const {
+                return allocated;
+            }
+        };
+
+        // Index of the particle with the lowest personal best, -1 for an empty swarm.
+        inline int best_particle(const Swarm& swarm) {
+            int best = -1;
+            for (int i = 0; i < swarm.size(); i++) {
+                if (best < 0 || swarm.best_fitness[i] < swarm.best_fitness[best]) {
+                    best = i;
+                }
+            }
+            return best;
+        }
+
+        struct UpdateParams {
+            double cognitive_factor;
+            double social_factor;
+            double inertia_weight;
+            // One coordinate per dimension.
+            const double* global_best;
+            // Each particle's own social attractor, laid out like the positions. Replaces global_best when set.
+            const double* social = nullptr;
+        };
+
+        /*
+         * x_d += inertia + c * r1 * (best_d - x_d) + s * r2 * (global_best_d - x_d) for every
+         * dimension d, with r1 and r2 drawn once per particle. Coordinate d of particle i
+         * is x[d * stride + i]. Every path evaluates in the same order without FMA so they
+         * agree bit for bit.
+         */
+        inline void update_positions_scalar(const UpdateParams& p, const double* r1, const double* r2,
+                                            double* x, const double* best, std::size_t stride, int dimensions,
+                                            int begin, int end) {
+            for (int i = begin; i < end; i++) {
+                double cr1 = p.cognitive_factor * r1[i];
+                double sr2 = p.social_factor * r2[i];
+                for (int d = 0; d < dimensions; d++) {
+                    double& xd = x[d * stride + i];
+                    double cognitive_component = cr1 * (best[d * stride + i] - xd);
+                    double social_component = sr2 * (p.global_best[d] - xd);
+                    xd = xd + p.inertia_weight + cognitive_component + social_component;
+                }
+            }
+        }
+
+        /*
+         * The update for a dimension count fixed at compile time: the loop over dimensions
+         * unrolls and each particle's r1/r2 products are shared by all of its coordinates.
+         */
+#if defined(PSO_SCALAR_KERNEL)
+        template<int D>
+        inline void update_positions_fixed(const UpdateParams& p, const double* r1, const double* r2,
+                                           double* x, const double* best, std::size_t stride, int begin, int end) {
+            update_positions_scalar(p, r1, r2, x, best, stride, D, begin, end);
+        }
+#elif defined(__AVX2__)
+        template<int D>
+        inline void update_positions_fixed(const UpdateParams& p, const double* r1, const double* r2,
+                                           double* x, const double* best, std::size_t stride, int begin, int end) {
+            const __m256d c = _mm256_set1_pd(p.cognitive_factor);
+            const __m256d s = _mm256_set1_pd(p.social_factor);
+            const __m256d w = _mm256_set1_pd(p.inertia_weight);
+            int i = begin;
+            for (; i + 4 <= end; i += 4) {
+                __m256d cr1 = _mm256_mul_pd(c, _mm256_loadu_pd(r1 + i));
+                __m256d sr2 = _mm256_mul_pd(s, _mm256_loadu_pd(r2 + i));
+                double* xd = x + i;
+                const double* bd = best + i;
+                for (int d = 0; d < D; d++, xd += stride, bd += stride) {
+                    __m256d v = _mm256_loadu_pd(xd);
+                    __m256d cog = _mm256_mul_pd(cr1, _mm256_sub_pd(_mm256_loadu_pd(bd), v));
+                    __m256d soc = _mm256_mul_pd(sr2, _mm256_sub_pd(_mm256_broadcast_sd(p.global_best + d), v));
+                    _mm256_storeu_pd(xd, _mm256_add_pd(_mm256_add_pd(_mm256_add_pd(v, w), cog), soc));
+                }
+            }
+            update_positions_scalar(p, r1, r2, x, best, stride, D, i, end);
+        }
+#elif defined(__SSE2__) || defined(_M_X64)
+        template<int D>
+        inline void update_positions_fixed(const UpdateParams& p, const double* r1, const double* r2,
+                                           double* x, const double* best, std::size_t stride, int begin, int end) {
+            const __m128d c = _mm_set1_pd(p.cognitive_factor);
+            const __m128d s = _mm_set1_pd(p.social_factor);
+            const __m128d w = _mm_set1_pd(p.inertia_weight);
+            int i = begin;
+            for (; i + 2 <= end; i += 2) {
+                __m128d cr1 = _mm_mul_pd(c, _mm_loadu_pd(r1 + i));
+                __m128d sr2 = _mm_mul_pd(s, _mm_loadu_pd(r2 + i));
+                double* xd = x + i;
+                const double* bd = best + i;
+                for (int d = 0; d < D; d++, xd += stride, bd += stride) {
+                    __m128d v = _mm_loadu_pd(xd);
+                    __m128d cog = _mm_mul_pd(cr1, _mm_sub_pd(_mm_loadu_pd(bd), v));
+                    __m128d soc = _mm_mul_pd(sr2, _mm_sub_pd(_mm_set1_pd(p.global_best[d]), v));
+                    _mm_storeu_pd(xd, _mm_add_pd(_mm_add_pd(_mm_add_pd(v, w), cog), soc));
+                }
+            }
+            update_positions_scalar(p, r1, r2, x, best, stride, D, i, end);
+        }
+#else
+        template<int D>
+        inline void update_positions_fixed(const UpdateParams& p, const double* r1, const double* r2,
+                                           double* x, const double* best, std::size_t stride, int begin, int end) {
+            update_positions_scalar(p, r1, r2, x, best, stride, D, begin, end);
+        }
+#endif
+
+        /*
+         * The update with p.social in place of the global best, for local-best topologies.
+         * Column by column the loop is contiguous in every array, so the compiler can
+         * vectorise it; the arithmetic is in the same order as the other kernels.
+         */
+        inline void update_positions_local(const UpdateParams& p, const double* r1, const double* r2,
+                                           Swarm& swarm, int begin, int end) {
+            for (int d = 0; d < swarm.dimensions; d++) {
+                double* x = swarm.column(d);
+                const double* best = swarm.best_column(d);
+                const double* social = p.social + d * swarm.stride;
+                for (int i = begin; i < end; i++) {
+                    double cognitive_component = p.cognitive_factor * r1[i] * (best[i] - x[i]);
+                    double social_component = p.social_factor * r2[i] * (social[i] - x[i]);
+                    x[i] = x[i] + p.inertia_weight + cognitive_component + social_component;
+                }
+            }
+        }
+
+        /*
+         * Updates particles [begin, end). Common dimension counts run a kernel specialised
+         * for them, any other count runs the one-dimensional kernel column by column.
+         */
+        inline void update_positions(const UpdateParams& p, const double* r1, const double* r2,
+                                     Swarm& swarm, int begin, int end) {
+            if (p.social != nullptr) {
+                update_positions_local(p, r1, r2, swarm, begin, end);
+                return;
+            }
+            double* x = swarm.position.data();
+            const double* best = swarm.best_position.data();
+            std::size_t stride = swarm.stride;
+            switch (swarm.dimensions) {
+                case 1: update_positions_fixed<1>(p, r1, r2, x, best, stride, begin, end); return;
+                case 2: update_positions_fixed<2>(p, r1, r2, x, best, stride, begin, end); return;
+                case 3: update_positions_fixed<3>(p, r1, r2, x, best, stride, begin, end); return;
+                case 4: update_positions_fixed<4>(p, r1, r2, x, best, stride, begin, end); return;
+                case 8: update_positions_fixed<8>(p, r1, r2, x, best, stride, begin, end); return;
+                case 16: update_positions_fixed<16>(p, r1, r2, x, best, stride, begin, end); return;
+                default: break;
+            }
+            for (int d = 0; d < swarm.dimensions; d++) {
+                UpdateParams column_params = p;
+                column_params.global_best = p.global_best + d;
+                update_positions_fixed<1>(column_params, r1, r2, swarm.column(d), swarm.best_column(d), stride,
+                                          begin, end);
+            }
+        }
+    }
+}
+#endif //SWARM_H
@@ -0,0 +1,269 @@
+//
+// Hyperparameter sweeps: many PSO runs over a grid or random sample of PSOConfig
+// fields and several seeds, run concurrently and reduced to a summary table.
+//
+#ifndef SWEEP_H
+#define SWEEP_H
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "pso.h"
+
+namespace algos {
+    namespace sweep {
+        struct Field {
+            const char* name;
+            bool integer;
+        };
+
+        // PSOConfig fields a sweep can vary, set through their cycles.csv config keys.
+        constexpr Field FIELDS[] = {
+                {"n_particles", true},
+                {"dimensions", true},
+                {"max_iterations", true},
+                {"cognitive_factor", false},
+                {"social_factor", false},
+                {"inertia_weight", false},
+                {"topology", true},
+                {"neighbours", true},
+                {"stop_stagnation_iterations", true},
+                {"stop_stagnation_tolerance", false},
+                {"stop_diameter", false},
+        };
+
+        inline const Field* find_field(const std::string& name) {
+            for (const Field& field : FIELDS) {
+                if (name == field.name) {
+                    return &field;
+                }
+            }
+            return nullptr;
+        }
+
+        struct Parameter {
+            std::string name;
+            // Grid values.
+            std::vector<double> values;
+            // Random search range, used when values is empty.
+            double min = 0;
+            double max = 0;
+        };
+
+        struct SweepSpec {
+            std::vector<Parameter> parameters;
+            // 0 runs every combination of the values, otherwise this many configurations drawn at random.
+            int random_samples = 0;
+            // Each configuration runs with seeds first_seed, first_seed + 1, ...
+            int n_seeds = 1;
+            std::uint64_t first_seed = 0;
+            // A run reaches the threshold at the first iteration whose global best is at or below it.
+            double threshold = 1e-3;
+            // Runs in flight at once, each on one thread.
+            int n_threads = 1;
+        };
+
+        // One configuration reduced over its seeds.
+        struct Summary {
+            // Value of each spec parameter, in spec order.
+            std::vector<double> values;
+            int runs = 0;
+            double mean_fitness = 0;
+            double best_fitness = 0;
+            double worst_fitness = 0;
+            // Runs that reached the threshold, and their mean iteration when they did.
+            int reached = 0;
+            double mean_threshold_iterations = 0;
+            double mean_seconds = 0;
+            // Objective evaluations per run, the initial ones included, and runs a stopping criterion ended early.
+            double mean_evaluations = 0;
+            int stopped_early = 0;
+        };
+
+        struct RunResult {
+            double fitness;
+            int threshold_iteration;
+            double seconds;
+            std::uint64_t evaluations;
+            convergence::StopReason stop_reason;
+        };
+
+        inline double apply_parameter(const Parameter& parameter, double value, pso::PSOConfig* config) {
+            const Field* field = find_field(parameter.name);
+            std::string line = parameter.name + ",";
+            if (field != nullptr && field->integer) {
+                value = (double) std::llround(value);
+                cycles_csv::append_number(line, (long long) value);
+            } else {
+                cycles_csv::append_number(line, value);
+            }
+            pso::apply_config_line(line, config);
+            return value;
+        }
+
+        // Number of configurations the spec describes.
+        inline std::size_t configuration_count(const SweepSpec& spec) {
+            if (spec.random_samples > 0) {
+                return spec.random_samples;
+            }
+            std::size_t count = 1;
+            for (const Parameter& parameter : spec.parameters) {
+                count *= std::max<std::size_t>(1, parameter.values.size());
+            }
+            return count;
+        }
+
+        /*
+         * Values of configuration index. A grid counts through the combinations with the
+         * last parameter changing fastest; random samples draw from a stream per index,
+         * so any configuration can be rebuilt on its own.
+         */
+        inline std::vector<double> configuration_values(const SweepSpec& spec, std::size_t index) {
+            std::vector<double> values(spec.parameters.size());
+            if (spec.random_samples > 0) {
+                rng::Stream stream = rng::Stream(spec.first_seed, 0x5EE9).split(index);
+                for (std::size_t p = 0; p < spec.parameters.size(); p++) {
+                    values[p] = stream.uniform(spec.parameters[p].min, spec.parameters[p].max);
+                }
+                return values;
+            }
+            for (std::size_t p = spec.parameters.size(); p-- > 0;) {
+                const std::vector<double>& grid = spec.parameters[p].values;
+                if (grid.empty()) {
+                    continue;
+                }
+                values[p] = grid[index % grid.size()];
+                index /= grid.size();
+            }
+            return values;
+        }
+
+        inline Summary summarise(std::vector<double> values, const RunResult* runs, int count) {
+            Summary summary;
+            summary.values = std::move(values);
+            summary.runs = count;
+            double fitness_total = 0, seconds_total = 0, iterations_total = 0, evaluations_total = 0;
+            for (int i = 0; i < count; i++) {
+                const RunResult& run = runs[i];
+                fitness_total += run.fitness;
+                seconds_total += run.seconds;
+                evaluations_total += (double) run.evaluations;
+                if (run.stop_reason != convergence::STOP_MAX_ITERATIONS) {
+                    summary.stopped_early++;
+                }
+                summary.best_fitness = i == 0 ? run.fitness : std::min(summary.best_fitness, run.fitness);
+                summary.worst_fitness = i == 0 ? run.fitness : std::max(summary.worst_fitness, run.fitness);
+                if (run.threshold_iteration >= 0) {
+                    summary.reached++;
+                    iterations_total += run.threshold_iteration;
+                }
+            }
+            summary.mean_fitness = count > 0 ? fitness_total / count : 0;
+            summary.mean_seconds = count > 0 ? seconds_total / count : 0;
+            summary.mean_evaluations = count > 0 ? evaluations_total / count : 0;
+            summary.mean_threshold_iterations = summary.reached > 0 ? iterations_total / summary.reached : -1;
+            return summary;
+        }
+
+        /*
+         * Runs every configuration with every seed on a pool of spec.n_threads and
+         * returns one summary per configuration, in configuration order. Runs keep no
+         * history and only a few numbers each survive them, so memory stays at about
+         * n_threads live swarms however large the sweep. Results do not depend on
+         * n_threads, apart from the wall times.
+         */
+        template<typename Objective>
+        std::vector<Summary> run(const Objective& objective, const pso::PSOConfig& base, const SweepSpec& spec) {
+            std::size_t configurations = configuration_count(spec);
+            int seeds = std::max(1, spec.n_seeds);
+            std::vector<RunResult> results(configurations * seeds);
+
+            auto run_one = [&](int begin, int end) {
+                for (int index = begin; index < end; index++) {
+                    std::size_t configuration = index / seeds;
+                    pso::PSOConfig config = base;
+                    std::vector<double> values = configuration_values(spec, configuration);
+                    for (std::size_t p = 0; p < spec.parameters.size(); p++) {
+                        apply_parameter(spec.parameters[p], values[p], &config);
+                    }
+                    config.seed = spec.first_seed + index % seeds;
+                    config.n_threads = 1;
+                    config.keep_history = false;
+
+                    RunResult& result = results[index];
+                    result.threshold_iteration = -1;
+                    auto start = std::chrono::steady_clock::now();
+                    BasicPSO<Objective> pso(objective, config);
+                    if (pso.get_pso_config().global_best_fitness <= spec.threshold) {
+                        result.threshold_iteration = 0;
+                    }
+                    while (pso.get_stop_reason() == convergence::STOP_NONE) {
+                        pso.step();
+                        if (result.threshold_iteration < 0 && pso.get_pso_config().global_best_fitness <= spec.threshold) {
+                            result.threshold_iteration = pso.get_iteration();
+                        }
+                    }
+                    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+                    result.fitness = pso.get_pso_config().global_best_fitness;
+                    result.evaluations = pso.get_convergence_status().evaluations;
+                    result.stop_reason = pso.get_stop_reason();
+                }
+            };
+            int total = (int) results.size();
+            if (spec.n_threads <= 1) {
+                run_one(0, total);
+            } else {
+                // The calling thread runs configurations too, so the pool needs one thread fewer.
+                ThreadPool pool(spec.n_threads - 1);
+                pool.parallel_for(0, total, 1, run_one);
+            }
+
+            std::vector<Summary> summaries;
+            summaries.reserve(configurations);
+            for (std::size_t c = 0; c < configurations; c++) {
+                std::vector<double> values = configuration_values(spec, c);
+                pso::PSOConfig config = base;
+                for (std::size_t p = 0; p < spec.parameters.size(); p++) {
+                    values[p] = apply_parameter(spec.parameters[p], values[p], &config);
+                }
+                summaries.push_back(summarise(std::move(values), results.data() + c * seeds, seeds));
+            }
+            return summaries;
+        }
+
+        // The summaries as CSV, one row per configuration under a header row.
+        inline std::string format_table(const SweepSpec& spec, const std::vector<Summary>& summaries) {
+            std::string out;
+            for (const Parameter& parameter : spec.parameters) {
+                out += parameter.name + ",";
+            }
+            out += "runs,mean_fitness,best_fitness,worst_fitness,reached,mean_threshold_iterations,mean_seconds,"
+                   "mean_evaluations,stopped_early\n";
+            for (const Summary& summary : summaries) {
+                for (double value : summary.values) {
+                    cycles_csv::append_number(out, value);
+                    out += ',';
+                }
+                cycles_csv::append_number(out, summary.runs);
+                for (double value : {summary.mean_fitness, summary.best_fitness, summary.worst_fitness}) {
+                    out += ',';
+                    cycles_csv::append_number(out, value);
+                }
+                out += ',';
+                cycles_csv::append_number(out, summary.reached);
+                for (double value : {summary.mean_threshold_iterations, summary.mean_seconds, summary.mean_evaluations}) {
+                    out += ',';
+                    cycles_csv::append_number(out, value);
+                }
+                out += ',';
+                cycles_csv::append_number(out, summary.stopped_early);
+                out += '\n';
+            }
+            return out;
+        }
+    }
+}
+#endif //SWEEP_H
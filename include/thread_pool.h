@@ -0,0 +1,253 @@
+//
+// Work-stealing thread pool used to spread swarm work across cores.
+//
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace algos {
+    /*
+     * Each worker owns a deque: it pops its own work from the back and, when
+     * that runs dry, steals from the front of the other workers' deques. The
+     * deques are ring buffers that only ever grow, so a pool that has run a
+     * parallel_for once runs the next without allocating.
+     * Threads waiting in parallel_for() run queued tasks first and sleep only
+     * once there is nothing left to take, so parallel_for() may be nested
+     * inside a task.
+     */
+    class ThreadPool {
+    private:
+        // One parallel_for() call. remaining and error are written under sleep_mutex.
+        struct Job {
+            ThreadPool* pool;
+            const std::function<void(int, int)>* body;
+            std::atomic<int> remaining;
+            std::exception_ptr error;
+        };
+
+        // Counts a chunk of job as done even when its body throws.
+        struct ChunkGuard {
+            Job* job;
+            std::exception_ptr error;
+
+            ~ChunkGuard() {
+                job->pool->finish_chunk(job, error);
+            }
+        };
+
+        struct Queue {
+            std::mutex mutex;
+            std::vector<std::function<void()>> ring;
+            std::size_t head = 0;
+            std::size_t count = 0;
+
+            void push_back(std::function<void()> task) {
+                if (count == ring.size()) {
+                    std::vector<std::function<void()>> grown(std::max<std::size_t>(16, ring.size() * 2));
+                    for (std::size_t i = 0; i < count; i++) {
+                        grown[i] = std::move(ring[(head + i) % ring.size()]);
+                    }
+                    ring.swap(grown);
+                    head = 0;
+                }
+                ring[(head + count) % ring.size()] = std::move(task);
+                count++;
+            }
+
+            std::function<void()> pop_back() {
+                count--;
+                return std::move(ring[(head + count) % ring.size()]);
+            }
+
+            std::function<void()> pop_front() {
+                std::function<void()> task = std::move(ring[head]);
+                head = (head + 1) % ring.size();
+                count--;
+                return task;
+            }
+        };
+
+        std::vector<std::unique_ptr<Queue>> queues;
+        std::vector<std::thread> workers;
+        std::mutex sleep_mutex;
+        std::condition_variable wake;
+        std::atomic<int> queued{0};
+        std::atomic<unsigned> next_queue{0};
+        bool stopping = false;
+
+        // Index of the calling thread's own queue in this pool, -1 for outside threads.
+        int own_queue() const {
+            return current_pool() == this ? current_index() : -1;
+        }
+
+        static const ThreadPool*& current_pool() {
+            static thread_local const ThreadPool* pool = nullptr;
+            return pool;
+        }
+
+        static int& current_index() {
+            static thread_local int index = -1;
+            return index;
+        }
+
+        bool pop(int index, std::function<void()>& task) {
+            Queue& queue = *queues[index];
+            std::lock_guard<std::mutex> lock(queue.mutex);
+            if (queue.count == 0) {
+                return false;
+            }
+            task = queue.pop_back();
+            return true;
+        }
+
+        bool steal(int index, std::function<void()>& task) {
+            Queue& queue = *queues[index];
+            std::lock_guard<std::mutex> lock(queue.mutex);
+            if (queue.count == 0) {
+                return false;
+            }
+            task = queue.pop_front();
+            return true;
+        }
+
+        // Nothing touches job once its last chunk is counted, the caller may already have returned.
+        void finish_chunk(Job* job, const std::exception_ptr& error) {
+            bool last;
+            {
+                std::lock_guard<std::mutex> lock(sleep_mutex);
+                if (error && !job->error) {
+                    job->error = error;
+                }
+                last = job->remaining.fetch_sub(1) == 1;
+            }
+            if (last) {
+                wake.notify_all();
+            }
+        }
+
+        void worker_loop(int index) {
+            current_pool() = this;
+            current_index() = index;
+            while (true) {
+                if (run_one()) {
+                    continue;
+                }
+                std::unique_lock<std::mutex> lock(sleep_mutex);
+                wake.wait(lock, [this] { return stopping || queued.load() > 0; });
+                if (stopping && queued.load() == 0) {
+                    return;
+                }
+            }
+        }
+
+    public:
+        explicit ThreadPool(int n_threads) {
+            n_threads = std::max(1, n_threads);
+            for (int i = 0; i < n_threads; i++) {
+                queues.push_back(std::make_unique<Queue>());
+            }
+            for (int i = 0; i < n_threads; i++) {
+                workers.emplace_back(&ThreadPool::worker_loop, this, i);
+            }
+        }
+
+        ~ThreadPool() {
+            {
+                std::lock_guard<std::mutex> lock(sleep_mutex);
+                stopping = true;
+            }
+            wake.notify_all();
+            for (auto& worker : workers) {
+                worker.join();
+            }
+        }
+
+        ThreadPool(const ThreadPool&) = delete;
+        ThreadPool& operator=(const ThreadPool&) = delete;
+
+        int size() const {
+            return (int) workers.size();
+        }
+
+        void submit(std::function<void()> task) {
+            int index = own_queue();
+            if (index < 0) {
+                index = (int) (next_queue.fetch_add(1) % queues.size());
+            }
+            {
+                std::lock_guard<std::mutex> lock(queues[index]->mutex);
+                queues[index]->push_back(std::move(task));
+            }
+            {
+                std::lock_guard<std::mutex> lock(sleep_mutex);
+                queued.fetch_add(1);
+            }
+            wake.notify_one();
+        }
+
+        // Runs one queued task on the calling thread, returns false if there was nothing to run.
+        bool run_one() {
+            std::function<void()> task;
+            int self = own_queue();
+            int n = (int) queues.size();
+            bool found = self >= 0 && pop(self, task);
+            for (int i = 1; !found && i <= n; i++) {
+                int victim = ((self < 0 ? 0 : self) + i) % n;
+                found = steal(victim, task);
+            }
+            if (!found) {
+                return false;
+            }
+            queued.fetch_sub(1);
+            task();
+            return true;
+        }
+
+        /*
+         * Calls body(chunk_begin, chunk_end) over [begin, end) in chunks of at most
+         * grain items and returns once every chunk has run. Chunk boundaries depend
+         * only on begin, end and grain, never on the number of threads. If a chunk
+         * throws, the others still run and the first exception is rethrown here.
+         */
+        void parallel_for(int begin, int end, int grain, const std::function<void(int, int)>& body) {
+            if (end <= begin) {
+                return;
+            }
+            grain = std::max(1, grain);
+            Job job{this, &body, (end - begin + grain - 1) / grain, nullptr};
+            for (int chunk_begin = begin; chunk_begin < end; chunk_begin += grain) {
+                int chunk_end = std::min(end, chunk_begin + grain);
+                // One pointer and two ints fit std::function's inline storage, so a task allocates nothing.
+                Job* shared = &job;
+                submit([shared, chunk_begin, chunk_end] {
+                    ChunkGuard guard{shared, nullptr};
+                    try {
+                        (*shared->body)(chunk_begin, chunk_end);
+                    } catch (...) {
+                        guard.error = std::current_exception();
+                    }
+                });
+            }
+            while (job.remaining.load() > 0) {
+                if (run_one()) {
+                    continue;
+                }
+                // The last chunk, or a newly queued task, wakes us.
+                std::unique_lock<std::mutex> lock(sleep_mutex);
+                wake.wait(lock, [this, &job] { return job.remaining.load() == 0 || queued.load() > 0; });
+            }
+            if (job.error) {
+                std::rethrow_exception(job.error);
+            }
+        }
+    };
+}
+#endif //THREAD_POOL_H
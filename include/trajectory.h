@@ -0,0 +1,347 @@
+//
+// Versioned binary trajectory format: streaming writer and zero-copy mmap reader.
+//
+#ifndef TRAJECTORY_H
+#define TRAJECTORY_H
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <initializer_list>
+#include <string>
+
+#include "swarm.h"
+#include "mapped_file.h"
+
+namespace algos {
+    namespace trajectory {
+        /*
+         * Layout, all integers little-endian, all offsets multiples of 64:
+         *
+         *   FileHeader       64 bytes
+         *   config block     config_size bytes of "key,value" lines (the cycles.csv header), zero padded
+         *   iteration blocks block_size bytes each:
+         *                      BlockHeader (16 bytes), padded to 64,
+         *                      then for each field set in columns, in the order below, one column
+         *                      of n_particles doubles per dimension (one for best fitness), each
+         *                      padded to 64
+         *
+         * Every block has the same size, so iteration i lives at data_offset + i * block_size.
+         * Version 1 files are two-dimensional with separate x and y bits; with both bits of a
+         * pair set their layout is the version 2 layout for two dimensions, so they still read.
+         * iteration_count is rewritten on every flush; a reader also trusts the file length,
+         * so a run cut short still opens.
+         */
+        constexpr char MAGIC[8] = {'P', 'S', 'O', 'T', 'R', 'A', 'J', '\0'};
+        constexpr std::uint32_t VERSION = 2;
+        constexpr std::uint32_t ENDIAN_CHECK = 0x01020304;
+        constexpr std::size_t ALIGNMENT = 64;
+
+        enum Column : std::uint32_t {
+            COLUMN_POSITION = 1 << 0,
+            COLUMN_BEST_POSITION = 1 << 2,
+            COLUMN_BEST_FITNESS = 1 << 4,
+            COLUMNS_POSITIONS = COLUMN_POSITION,
+            COLUMNS_ALL = COLUMN_POSITION | COLUMN_BEST_POSITION | COLUMN_BEST_FITNESS,
+        };
+
+        // The y halves of the version 1 position pairs.
+        constexpr std::uint32_t V1_COLUMN_Y = 1 << 1;
+        constexpr std::uint32_t V1_COLUMN_BEST_Y = 1 << 3;
+
+        struct FileHeader {
+            char magic[8];
+            std::uint32_t version;
+            std::uint32_t endian_check;
+            std::uint32_t columns;
+            std::uint32_t n_particles;
+            std::uint64_t config_size;
+            std::uint64_t block_size;
+            std::uint64_t iteration_count;
+            // 0 in version 1 files, which are two-dimensional.
+            std::uint32_t dimensions;
+            std::uint8_t reserved[12];
+        };
+        static_assert(sizeof(FileHeader) == 64, "trajectory header must stay 64 bytes");
+
+        struct BlockHeader {
+            std::int32_t iteration;
+            std::uint32_t reserved;
+            double global_best_fitness;
+        };
+
+        inline std::size_t align_up(std::size_t n) {
+            return (n + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+        }
+
+        // Columns a field takes up in a block.
+        inline int field_width(Column field, std::uint32_t dimensions) {
+            return field == COLUMN_BEST_FITNESS ? 1 : (int) dimensions;
+        }
+
+        inline int column_count(std::uint32_t columns, std::uint32_t dimensions) {
+            int count = 0;
+            for (Column field : {COLUMN_POSITION, COLUMN_BEST_POSITION, COLUMN_BEST_FITNESS}) {
+                count += (columns & field) ? field_width(field, dimensions) : 0;
+            }
+            return count;
+        }
+
+        inline std::size_t block_size(std::uint32_t columns, std::uint32_t n_particles, std::uint32_t dimensions) {
+            return ALIGNMENT + column_count(columns, dimensions) * align_up(n_particles * sizeof(double));
+        }
+
+        // Position of dimension d of a field inside a block, fields in order position, best position, best fitness.
+        inline std::size_t column_offset(std::uint32_t columns, std::uint32_t n_particles, std::uint32_t dimensions,
+                                         Column column, int d) {
+            std::size_t offset = ALIGNMENT;
+            for (Column field : {COLUMN_POSITION, COLUMN_BEST_POSITION, COLUMN_BEST_FITNESS}) {
+                if (field == column) {
+                    break;
+                }
+                if (columns & field) {
+                    offset += field_width(field, dimensions) * align_up(n_particles * sizeof(double));
+                }
+            }
+            return offset + d * align_up(n_particles * sizeof(double));
+        }
+
+        // 64-bit safe absolute seek, plain fseek takes a 32-bit long on Windows.
+        inline bool seek_to(FILE* file, std::uint64_t offset) {
+#ifdef _WIN32
+            return _fseeki64(file, (__int64) offset, SEEK_SET) == 0;
+#else
+            return fseeko(file, (off_t) offset, SEEK_SET) == 0;
+#endif
+        }
+
+        inline bool is_trajectory_file(const std::string& filename) {
+            FILE* file = fopen(filename.c_str(), "rb");
+            if (file == nullptr) {
+                return false;
+            }
+            char magic[sizeof(MAGIC)] = {};
+            bool match = fread(magic, 1, sizeof(magic), file) == sizeof(magic) && std::memcmp(magic, MAGIC, sizeof(MAGIC)) == 0;
+            fclose(file);
+            return match;
+        }
+
+        /*
+         * Appends one block per iteration as the swarm runs. truncate() rewinds after
+         * a backward step so the next block overwrites the popped iterations.
+         */
+        class Writer {
+        private:
+            FILE* file = nullptr;
+            FileHeader header{};
+            std::uint64_t data_offset = 0;
+
+            bool write_padding(std::size_t bytes) {
+                static const std::uint8_t zeros[ALIGNMENT] = {};
+                while (bytes > 0) {
+                    std::size_t chunk = bytes < ALIGNMENT ? bytes : ALIGNMENT;
+                    if (fwrite(zeros, 1, chunk, file) != chunk) {
+                        return false;
+                    }
+                    bytes -= chunk;
+                }
+                return true;
+            }
+
+            bool write_column(const double* values) {
+                std::size_t n = header.n_particles;
+                if (fwrite(values, sizeof(double), n, file) != n) {
+                    return false;
+                }
+                return write_padding(align_up(n * sizeof(double)) - n * sizeof(double));
+            }
+
+            // Rewrites the header and returns to the end of the last counted block.
+            bool write_header() {
+                bool ok = seek_to(file, 0) && fwrite(&header, sizeof(header), 1, file) == 1;
+                return seek_to(file, data_offset + header.iteration_count * header.block_size) && ok;
+            }
+
+        public:
+            Writer() = default;
+
+            ~Writer() {
+                close();
+            }
+
+            Writer(const Writer&) = delete;
+            Writer& operator=(const Writer&) = delete;
+
+            bool open(const std::string& filename, const std::string& config_block, int n_particles, int dimensions,
+                      std::uint32_t columns = COLUMNS_ALL) {
+                close();
+                file = fopen(filename.c_str(), "wb");
+                if (file == nullptr) {
+                    printf("Error opening file\n");
+                    return false;
+                }
+                std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+                header.version = VERSION;
+                header.endian_check = ENDIAN_CHECK;
+                header.columns = columns & COLUMNS_ALL;
+                header.n_particles = (std::uint32_t) n_particles;
+                header.dimensions = (std::uint32_t) dimensions;
+                header.config_size = config_block.size();
+                header.block_size = block_size(header.columns, header.n_particles, header.dimensions);
+                header.iteration_count = 0;
+                data_offset = sizeof(FileHeader) + align_up(config_block.size());
+
+                bool ok = fwrite(&header, sizeof(header), 1, file) == 1 &&
+                          fwrite(config_block.data(), 1, config_block.size(), file) == config_block.size() &&
+                          write_padding(align_up(config_block.size()) - config_block.size());
+                if (!ok) {
+                    printf("Error writing file\n");
+                    close();
+                }
+                return ok;
+            }
+
+            bool is_open() const {
+                return file != nullptr;
+            }
+
+            std::uint64_t iteration_count() const {
+                return header.iteration_count;
+            }
+
+            bool append(const pso::Swarm& swarm, int iteration, double global_best_fitness) {
+                if (file == nullptr || swarm.size() != (int) header.n_particles ||
+                    swarm.dimensions != (int) header.dimensions) {
+                    return false;
+                }
+                BlockHeader block{iteration, 0, global_best_fitness};
+                bool ok = fwrite(&block, sizeof(block), 1, file) == 1 && write_padding(ALIGNMENT - sizeof(block));
+                for (int d = 0; ok && (header.columns & COLUMN_POSITION) && d < swarm.dimensions; d++) {
+                    ok = write_column(swarm.column(d));
+                }
+                for (int d = 0; ok && (header.columns & COLUMN_BEST_POSITION) && d < swarm.dimensions; d++) {
+                    ok = write_column(swarm.best_column(d));
+                }
+                if (ok && (header.columns & COLUMN_BEST_FITNESS)) ok = write_column(swarm.best_fitness.data());
+                if (!ok) {
+                    printf("Error writing file\n");
+                    return false;
+                }
+                header.iteration_count++;
+                return true;
+            }
+
+            // Drops every block from index count onwards; later appends overwrite them.
+            void truncate(std::uint64_t count) {
+                if (file == nullptr || count >= header.iteration_count) {
+                    return;
+                }
+                header.iteration_count = count;
+                write_header();
+            }
+
+            // Publishes the blocks written so far to readers of the file.
+            void flush() {
+                if (file != nullptr) {
+                    write_header();
+                    fflush(file);
+                }
+            }
+
+            void close() {
+                if (file != nullptr) {
+                    write_header();
+                    fclose(file);
+                    file = nullptr;
+                }
+            }
+        };
+
+        /*
+         * Maps a trajectory file and hands out pointers straight into the mapping,
+         * nothing is copied or parsed beyond the header.
+         */
+        class Reader {
+        private:
+            MappedFile map;
+            FileHeader header{};
+            std::uint64_t data_offset = 0;
+            std::uint64_t count = 0;
+
+        public:
+            bool open(const std::string& filename) {
+                count = 0;
+                if (!map.open(filename) || map.size() < sizeof(FileHeader)) {
+                    map.close();
+                    return false;
+                }
+                std::memcpy(&header, map.data(), sizeof(header));
+                std::uint32_t stored_columns = header.columns;
+                if (header.version == 1) {
+                    // Only whole x/y pairs map onto the version 2 layout.
+                    bool paired = ((header.columns & COLUMN_POSITION) != 0) == ((header.columns & V1_COLUMN_Y) != 0) &&
+                                  ((header.columns & COLUMN_BEST_POSITION) != 0) == ((header.columns & V1_COLUMN_BEST_Y) != 0);
+                    header.columns = paired ? header.columns & COLUMNS_ALL : 0;
+                    header.dimensions = 2;
+                }
+                if (std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0 || header.endian_check != ENDIAN_CHECK ||
+                    header.version > VERSION || header.dimensions == 0 || (stored_columns != 0 && header.columns == 0) ||
+                    header.block_size != block_size(header.columns, header.n_particles, header.dimensions)) {
+                    printf("Unsupported trajectory file\n");
+                    map.close();
+                    return false;
+                }
+                data_offset = sizeof(FileHeader) + align_up(header.config_size);
+                if (data_offset > map.size()) {
+                    map.close();
+                    return false;
+                }
+                std::uint64_t complete = (map.size() - data_offset) / header.block_size;
+                count = complete < header.iteration_count ? complete : header.iteration_count;
+                return true;
+            }
+
+            bool is_open() const {
+                return map.is_open();
+            }
+
+            std::string config_block() const {
+                return std::string(reinterpret_cast<const char*>(map.data()) + sizeof(FileHeader), header.config_size);
+            }
+
+            int n_particles() const {
+                return (int) header.n_particles;
+            }
+
+            int dimensions() const {
+                return (int) header.dimensions;
+            }
+
+            std::uint32_t columns() const {
+                return header.columns;
+            }
+
+            std::uint64_t iteration_count() const {
+                return count;
+            }
+
+            const BlockHeader& block(std::uint64_t index) const {
+                return *reinterpret_cast<const BlockHeader*>(map.data() + data_offset + index * header.block_size);
+            }
+
+            /*
+             * n_particles doubles of dimension d of a field for stored iteration index,
+             * nullptr if the file lacks it. Best fitness only has d = 0.
+             */
+            const double* column(std::uint64_t index, Column column, int d = 0) const {
+                if (!(header.columns & column) || index >= count || d < 0 ||
+                    d >= field_width(column, header.dimensions)) {
+                    return nullptr;
+                }
+                return reinterpret_cast<const double*>(map.data() + data_offset + index * header.block_size +
+                                                       column_offset(header.columns, header.n_particles,
+                                                                     header.dimensions, column, d));
+            }
+        };
+    }
+}
+#endif //TRAJECTORY_H
@@ -0,0 +1,52 @@
+//
+// Lock-free handoff of the latest value from one thread to another.
+//
+#ifndef TRIPLE_BUFFER_H
+#define TRIPLE_BUFFER_H
+#include <atomic>
+
+namespace algos {
+    /*
+     * Triple buffer: the writer fills its back slot and publishes it by swapping it
+     * with the middle one, the reader swaps the middle slot for its front one when
+     * it holds something newer. Neither side ever waits for the other, and the reader
+     * always sees the newest complete value. Slots are reused, so a T that keeps its
+     * capacity (vectors, strings) stops allocating after the first few publishes.
+     * One writer and one reader at a time.
+     */
+    template<typename T>
+    class TripleBuffer {
+    private:
+        static constexpr int FRESH = 4;
+
+        T slots[3];
+        // Index of the middle slot, with FRESH set when the reader has not taken it yet.
+        std::atomic<int> middle{1};
+        // Owned by the writer and the reader respectively.
+        int back = 0;
+        int front = 2;
+
+    public:
+        T& write_buffer() {
+            return slots[back];
+        }
+
+        void publish() {
+            back = middle.exchange(back | FRESH, std::memory_order_acq_rel) & 3;
+        }
+
+        // Takes the newest published value if there is one, returns whether it did.
+        bool update() {
+            if ((middle.load(std::memory_order_relaxed) & FRESH) == 0) {
+                return false;
+            }
+            front = middle.exchange(front, std::memory_order_acq_rel) & 3;
+            return true;
+        }
+
+        const T& read_buffer() const {
+            return slots[front];
+        }
+    };
+}
+#endif //TRIPLE_BUFFER_H
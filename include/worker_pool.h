@@ -0,0 +1,655 @@
+//
+// Objectives evaluated by a pool of worker processes (see pso_worker.h), for
+// simulators that cannot safely run as threads inside the PSO's own process.
+//
+#ifndef WORKER_POOL_H
+#define WORKER_POOL_H
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#ifndef _WIN32
+#include <cerrno>
+#include <csignal>
+#include <fcntl.h>
+#include <poll.h>
+#include <spawn.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "pso_worker.h"
+
+extern char** environ;
+#endif
+
+#include "searchers.h"
+#include "plugin.h"
+
+namespace algos {
+    namespace workers {
+        struct WorkerPoolConfig {
+            // Program and arguments each worker runs, the program looked up on PATH.
+            std::vector<std::string> command;
+            int n_workers = 4;
+            // Most points sent in one request, 0 splits each batch evenly over the workers.
+            int batch_size = 0;
+            // A worker that takes longer than this over one request is killed and restarted, 0 waits forever.
+            double timeout_seconds = 0;
+            // Times a request is sent before its points get infinite fitness, and a worker
+            // slot is started in a row without becoming ready before it is given up.
+            int max_attempts = 3;
+        };
+
+        struct WorkerStats {
+            // Requests answered.
+            std::uint64_t requests = 0;
+            // Workers that exited, crashed, timed out or broke the protocol, restarted unless given up.
+            std::uint64_t restarts = 0;
+            std::uint64_t timeouts = 0;
+            // Requests sent again after their worker was lost.
+            std::uint64_t retries = 0;
+            // Points given infinite fitness once their request ran out of attempts.
+            std::uint64_t failed_points = 0;
+        };
+
+        // Splits a command line on whitespace; no quoting.
+        inline std::vector<std::string> split_command(const std::string& line) {
+            std::vector<std::string> words;
+            std::size_t begin = line.find_first_not_of(" \t");
+            while (begin != std::string::npos) {
+                std::size_t end = line.find_first_of(" \t", begin);
+                words.push_back(line.substr(begin, end == std::string::npos ? std::string::npos : end - begin));
+                begin = end == std::string::npos ? end : line.find_first_not_of(" \t", end);
+            }
+            return words;
+        }
+
+        /*
+         * A fixed number of worker processes and a thread that talks to them. evaluate()
+         * may be called from several threads at once: each call's batch is split into
+         * requests that join one queue, go out to whichever workers are free, and the
+         * call returns once all its answers are in. The I/O thread waits on every
+         * socket at once, so answers are collected in whatever order they arrive.
+         *
+         * A worker that is lost mid-request is restarted and the request goes back to
+         * the front of the queue. A slot whose worker keeps failing before it is ready
+         * is given up; with every slot given up, batches get infinite fitness.
+         */
+        class WorkerPool {
+        private:
+            // Descriptor the worker finds its socket on.
+            static constexpr int WORKER_FD = 3;
+            // Time a worker gets from starting to sending its hello.
+            static constexpr int STARTUP_SECONDS = 10;
+
+            struct Call {
+                Points points;
+                Span<double> fitness;
+                PsoPluginContext context;
+                std::size_t remaining;
+            };
+
+            struct Request {
+                Call* call;
+                std::size_t begin;
+                std::size_t count;
+                int attempts;
+            };
+
+            struct Worker {
+                int pid = -1;
+                int fd = -1;
+                // Sent its hello since it was last started.
+                bool ready = false;
+                bool retired = false;
+                int failed_starts = 0;
+                Request* request = nullptr;
+                std::uint64_t id = 0;
+                // When it must have sent its hello, or answered its request when there is a timeout.
+                std::chrono::steady_clock::time_point deadline;
+                std::vector<char> outbox;
+                std::size_t sent = 0;
+                std::vector<char> inbox;
+            };
+
+            WorkerPoolConfig config;
+            std::vector<Worker> workers;
+            std::uint64_t next_id = 1;
+            // Guards the queue, the calls' remaining counts and fitness, stats and the fields below.
+            std::mutex mutex;
+            std::condition_variable changed;
+            std::deque<Request*> queue;
+            WorkerStats stats;
+            int ready_workers = 0;
+            int live_workers = 0;
+            std::string start_error;
+            // Set while start() waits, when a worker that fails gets reported rather than restarted.
+            bool starting = false;
+            bool stopping = false;
+            // The I/O thread's wake-up pipe, written when requests are queued or the pool stops.
+            int wake[2] = {-1, -1};
+            std::thread io_thread;
+
+#ifndef _WIN32
+            static bool set_flags(int fd, bool nonblocking) {
+                int fd_flags = fcntl(fd, F_GETFD);
+                int status_flags = fcntl(fd, F_GETFL);
+                return fd_flags >= 0 && status_flags >= 0 && fcntl(fd, F_SETFD, fd_flags | FD_CLOEXEC) == 0 &&
+                       (!nonblocking || fcntl(fd, F_SETFL, status_flags | O_NONBLOCK) == 0);
+            }
+
+            // Starts worker w on a new socket, or returns false with the reason in error.
+            bool spawn(Worker& w, std::string* error) {
+                int fds[2];
+                if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0) {
+                    *error = std::string("Error creating socket: ") + std::strerror(errno);
+                    return false;
+                }
+                // Moved above WORKER_FD, so the dup2 onto it below always clears close-on-exec.
+                int child_fd = fcntl(fds[1], F_DUPFD_CLOEXEC, WORKER_FD + 1);
+                close(fds[1]);
+                if (child_fd < 0 || !set_flags(fds[0], true)) {
+                    *error = std::string("Error creating socket: ") + std::strerror(errno);
+                    close(fds[0]);
+                    if (child_fd >= 0) {
+                        close(child_fd);
+                    }
+                    return false;
+                }
+#ifdef SO_NOSIGPIPE
+                int on = 1;
+                setsockopt(fds[0], SOL_SOCKET, SO_NOSIGPIPE, &on, sizeof(on));
+#endif
+                std::vector<char*> argv;
+                for (const std::string& word : config.command) {
+                    argv.push_back(const_cast<char*>(word.c_str()));
+                }
+                argv.push_back(nullptr);
+                std::string fd_variable = std::string(PSO_WORKER_FD_ENV "=") + std::to_string(WORKER_FD);
+                std::vector<char*> envp;
+                for (char** variable = environ; *variable != nullptr; variable++) {
+                    if (std::strncmp(*variable, PSO_WORKER_FD_ENV "=", sizeof(PSO_WORKER_FD_ENV)) != 0) {
+                        envp.push_back(*variable);
+                    }
+                }
+                envp.push_back(const_cast<char*>(fd_variable.c_str()));
+                envp.push_back(nullptr);
+
+                posix_spawn_file_actions_t actions;
+                posix_spawn_file_actions_init(&actions);
+                posix_spawn_file_actions_adddup2(&actions, child_fd, WORKER_FD);
+                pid_t pid = -1;
+                int result = posix_spawnp(&pid, argv[0], &actions, nullptr, argv.data(), envp.data());
+                posix_spawn_file_actions_destroy(&actions);
+                close(child_fd);
+                if (result != 0) {
+                    *error = "Error starting " + config.command[0] + ": " + std::strerror(result);
+                    close(fds[0]);
+                    return false;
+                }
+                w.pid = pid;
+                w.fd = fds[0];
+                w.ready = false;
+                w.deadline = std::chrono::steady_clock::now() + std::chrono::seconds(STARTUP_SECONDS);
+                w.request = nullptr;
+                w.outbox.clear();
+                w.sent = 0;
+                w.inbox.clear();
+                return true;
+            }
+
+            // Whether worker w has a deadline: getting ready, or a request under a timeout.
+            bool has_deadline(const Worker& w) const {
+                return !w.ready || (w.request != nullptr && config.timeout_seconds > 0);
+            }
+
+            // Ends worker w's process and waits for it.
+            static void terminate(Worker& w, bool force) {
+                if (w.fd >= 0) {
+                    close(w.fd);
+                    w.fd = -1;
+                }
+                if (w.pid <= 0) {
+                    return;
+                }
+                // Closing the socket asks a worker to exit; one that does not in time is killed.
+                auto give_up = std::chrono::steady_clock::now() + std::chrono::seconds(1);
+                while (!force && waitpid(w.pid, nullptr, WNOHANG) == 0) {
+                    if (std::chrono::steady_clock::now() > give_up) {
+                        force = true;
+                        break;
+                    }
+                    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+                }
+                if (force) {
+                    kill(w.pid, SIGKILL);
+                    waitpid(w.pid, nullptr, 0);
+                }
+                w.pid = -1;
+            }
+
+            /*
+             * Called on the I/O thread when worker w is lost: its request goes back to the
+             * front of the queue, or fails once out of attempts, and the slot is restarted
+             * unless it keeps failing before it gets ready.
+             */
+            void restart(Worker& w, bool timed_out) {
+                terminate(w, true);
+                std::string error;
+                std::unique_lock<std::mutex> lock(mutex);
+                stats.restarts++;
+                stats.timeouts += timed_out ? 1 : 0;
+                bool was_ready = w.ready;
+                if (w.ready) {
+                    ready_workers--;
+                    w.ready = false;
+                } else {
+                    w.failed_starts++;
+                }
+                if (Request* request = w.request) {
+                    w.request = nullptr;
+                    if (++request->attempts >= std::max(1, config.max_attempts)) {
+                        finish(request, nullptr);
+                    } else {
+                        stats.retries++;
+                        queue.push_front(request);
+                    }
+                }
+                if (starting || w.failed_starts >= std::max(1, config.max_attempts)) {
+                    retire(w, was_ready ? "Worker exited while the others started"
+                                        : timed_out ? "Worker did not get ready in time"
+                                                    : "Worker exited before it was ready");
+                    return;
+                }
+                lock.unlock();
+                bool started = spawn(w, &error);
+                lock.lock();
+                if (!started) {
+                    retire(w, error);
+                }
+            }
+
+            // Gives up slot w, with the mutex held.
+            void retire(Worker& w, const std::string& reason) {
+                w.retired = true;
+                live_workers--;
+                if (start_error.empty()) {
+                    start_error = reason;
+                }
+                if (live_workers == 0) {
+                    if (!starting) {
+                        printf("Error: every worker process failed, %s\n", start_error.c_str());
+                    }
+                    fail_queue();
+                }
+                changed.notify_all();
+            }
+
+            // Gives every queued request infinite fitness, with the mutex held.
+            void fail_queue() {
+                while (!queue.empty()) {
+                    Request* request = queue.front();
+                    queue.pop_front();
+                    finish(request, nullptr);
+                }
+            }
+
+            // Hands a request's answer, or infinite fitness when fitness is null, back to its call, with the mutex held.
+            void finish(Request* request, const double* fitness) {
+                double* out = request->call->fitness.data() + request->begin;
+                if (fitness != nullptr) {
+                    std::memcpy(out, fitness, request->count * sizeof(double));
+                    stats.requests++;
+                } else {
+                    std::fill(out, out + request->count, std::numeric_limits<double>::infinity());
+                    stats.failed_points += request->count;
+                }
+                if (--request->call->remaining == 0) {
+                    changed.notify_all();
+                }
+            }
+
+            // Packs request into worker w's outbox.
+            void encode(Worker& w, Request* request) {
+                const Points& points = request->call->points;
+                int dimensions = points.dimensions();
+                PsoWorkerRequest header{};
+                header.magic = PSO_WORKER_MAGIC;
+                header.count = (std::uint32_t) request->count;
+                header.id = w.id = next_id++;
+                header.dimensions = dimensions;
+                header.context = request->call->context;
+                std::size_t column_bytes = request->count * sizeof(double);
+                w.outbox.resize(sizeof(header) + dimensions * column_bytes);
+                std::memcpy(w.outbox.data(), &header, sizeof(header));
+                for (int d = 0; d < dimensions; d++) {
+                    std::memcpy(w.outbox.data() + sizeof(header) + d * column_bytes, points.column(d) + request->begin,
+                                column_bytes);
+                }
+                w.sent = 0;
+                w.request = request;
+                if (config.timeout_seconds > 0) {
+                    w.deadline = std::chrono::steady_clock::now() +
+                                 std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                                         std::chrono::duration<double>(config.timeout_seconds));
+                }
+            }
+
+            // Sends what it can of w's outbox; false if the worker is gone.
+            static bool send_some(Worker& w) {
+#ifdef MSG_NOSIGNAL
+                constexpr int flags = MSG_NOSIGNAL;
+#else
+                constexpr int flags = 0;
+#endif
+                while (w.sent < w.outbox.size()) {
+                    ssize_t put = send(w.fd, w.outbox.data() + w.sent, w.outbox.size() - w.sent, flags);
+                    if (put < 0 && errno == EINTR) {
+                        continue;
+                    }
+                    if (put < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+                        return true;
+                    }
+                    if (put <= 0) {
+                        return false;
+                    }
+                    w.sent += put;
+                }
+                return true;
+            }
+
+            /*
+             * Reads what has arrived from w and takes in a whole hello or answer once it
+             * is there. False if the worker is gone or sent something unexpected.
+             */
+            bool receive(Worker& w) {
+                // An answer may arrive just before the worker goes, so it is taken in first.
+                bool closed = false;
+                while (!closed) {
+                    std::size_t had = w.inbox.size();
+                    w.inbox.resize(had + (1 << 16));
+                    ssize_t got = recv(w.fd, w.inbox.data() + had, 1 << 16, 0);
+                    w.inbox.resize(had + std::max<ssize_t>(got, 0));
+                    if (got < 0 && errno == EINTR) {
+                        continue;
+                    }
+                    if (got < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+                        break;
+                    }
+                    closed = got <= 0;
+                }
+                if (!w.ready) {
+                    if (w.inbox.size() < sizeof(PsoWorkerHello)) {
+                        return !closed;
+                    }
+                    PsoWorkerHello hello;
+                    std::memcpy(&hello, w.inbox.data(), sizeof(hello));
+                    if (w.inbox.size() > sizeof(hello) || hello.magic != PSO_WORKER_MAGIC ||
+                        hello.version != PSO_WORKER_PROTOCOL_VERSION) {
+                        return false;
+                    }
+                    w.inbox.clear();
+                    std::lock_guard<std::mutex> lock(mutex);
+                    w.ready = true;
+                    w.failed_starts = 0;
+                    ready_workers++;
+                    changed.notify_all();
+                    return !closed;
+                }
+                if (w.inbox.size() < sizeof(PsoWorkerResponse)) {
+                    return !closed;
+                }
+                if (w.request == nullptr) {
+                    return false;
+                }
+                PsoWorkerResponse response;
+                std::memcpy(&response, w.inbox.data(), sizeof(response));
+                std::size_t size = sizeof(response) + w.request->count * sizeof(double);
+                if (response.magic != PSO_WORKER_MAGIC || response.id != w.id || response.count != w.request->count ||
+                    w.inbox.size() > size) {
+                    return false;
+                }
+                if (w.inbox.size() < size) {
+                    return !closed;
+                }
+                std::lock_guard<std::mutex> lock(mutex);
+                finish(w.request, reinterpret_cast<const double*>(w.inbox.data() + sizeof(response)));
+                w.request = nullptr;
+                w.inbox.clear();
+                return !closed;
+            }
+
+            void run_io() {
+                std::vector<pollfd> fds;
+                std::vector<Worker*> polled;
+                while (true) {
+                    {
+                        std::lock_guard<std::mutex> lock(mutex);
+                        if (stopping) {
+                            return;
+                        }
+                        for (Worker& w : workers) {
+                            if (queue.empty()) {
+                                break;
+                            }
+                            if (w.ready && w.request == nullptr) {
+                                encode(w, queue.front());
+                                queue.pop_front();
+                            }
+                        }
+                    }
+                    fds.clear();
+                    polled.clear();
+                    fds.push_back({wake[0], POLLIN, 0});
+                    int timeout_ms = -1;
+                    auto now = std::chrono::steady_clock::now();
+                    for (Worker& w : workers) {
+                        if (w.fd < 0) {
+                            continue;
+                        }
+                        short events = POLLIN;
+                        if (w.request != nullptr && w.sent < w.outbox.size()) {
+                            events |= POLLOUT;
+                        }
+                        if (has_deadline(w)) {
+                            auto left = std::chrono::duration_cast<std::chrono::milliseconds>(w.deadline - now).count();
+                            int wait_ms = (int) std::max<long long>(0, left + 1);
+                            timeout_ms = timeout_ms < 0 ? wait_ms : std::min(timeout_ms, wait_ms);
+                        }
+                        fds.push_back({w.fd, events, 0});
+                        polled.push_back(&w);
+                    }
+                    if (poll(fds.data(), fds.size(), timeout_ms) < 0 && errno != EINTR) {
+                        printf("Error waiting for workers: %s\n", std::strerror(errno));
+                        return;
+                    }
+                    if (fds[0].revents != 0) {
+                        char drain[64];
+                        while (read(wake[0], drain, sizeof(drain)) > 0) {}
+                    }
+                    now = std::chrono::steady_clock::now();
+                    for (std::size_t k = 0; k < polled.size(); k++) {
+                        Worker& w = *polled[k];
+                        short revents = fds[k + 1].revents;
+                        bool alive = true;
+                        if (revents & POLLOUT) {
+                            alive = send_some(w);
+                        }
+                        if (alive && (revents & (POLLIN | POLLHUP | POLLERR))) {
+                            alive = receive(w);
+                        }
+                        bool timed_out = alive && has_deadline(w) && now >= w.deadline;
+                        if (!alive || timed_out) {
+                            restart(w, timed_out);
+                        }
+                    }
+                }
+            }
+
+            void wake_io() {
+                char byte = 0;
+                ssize_t ignored = write(wake[1], &byte, 1);
+                (void) ignored;
+            }
+#endif
+
+            void shut_down() {
+#ifndef _WIN32
+                if (io_thread.joinable()) {
+                    {
+                        std::lock_guard<std::mutex> lock(mutex);
+                        stopping = true;
+                    }
+                    wake_io();
+                    io_thread.join();
+                }
+                // Every worker is asked to exit before waiting on any of them.
+                for (Worker& w : workers) {
+                    if (w.fd >= 0) {
+                        close(w.fd);
+                        w.fd = -1;
+                    }
+                }
+                for (Worker& w : workers) {
+                    terminate(w, false);
+                }
+                for (int& fd : wake) {
+                    if (fd >= 0) {
+                        close(fd);
+                        fd = -1;
+                    }
+                }
+#endif
+                workers.clear();
+            }
+
+        public:
+            WorkerPool() = default;
+
+            ~WorkerPool() {
+                shut_down();
+            }
+
+            WorkerPool(const WorkerPool&) = delete;
+            WorkerPool& operator=(const WorkerPool&) = delete;
+
+            // Starts the workers and waits for each to say it is ready; false with the reason in error otherwise.
+            bool start(const WorkerPoolConfig& cfg, std::string* error) {
+                shut_down();
+#ifdef _WIN32
+                *error = "Worker processes need a POSIX system";
+                return false;
+#else
+                config = cfg;
+                config.n_workers = std::max(1, config.n_workers);
+                if (config.command.empty()) {
+                    *error = "No worker command";
+                    return false;
+                }
+                if (pipe(wake) != 0 || !set_flags(wake[0], true) || !set_flags(wake[1], true)) {
+                    *error = std::string("Error creating pipe: ") + std::strerror(errno);
+                    shut_down();
+                    return false;
+                }
+                starting = true;
+                stopping = false;
+                stats = WorkerStats();
+                start_error.clear();
+                ready_workers = 0;
+                workers.resize(config.n_workers);
+                live_workers = config.n_workers;
+                for (Worker& w : workers) {
+                    if (!spawn(w, error)) {
+                        shut_down();
+                        return false;
+                    }
+                }
+                io_thread = std::thread([this] { run_io(); });
+                std::unique_lock<std::mutex> lock(mutex);
+                changed.wait_for(lock, std::chrono::seconds(STARTUP_SECONDS), [this] {
+                    return ready_workers == config.n_workers || !start_error.empty();
+                });
+                starting = false;
+                if (ready_workers == config.n_workers && start_error.empty()) {
+                    return true;
+                }
+                *error = !start_error.empty() ? start_error : "Workers did not get ready in time";
+                lock.unlock();
+                shut_down();
+                return false;
+#endif
+            }
+
+            // Evaluates the batch on the workers, blocking until every point has its fitness.
+            void evaluate(Points points, Span<double> fitness, const AppConfig* app_config) {
+                std::size_t count = fitness.size();
+                if (count == 0) {
+                    return;
+                }
+                std::size_t size = config.batch_size > 0 ? (std::size_t) config.batch_size
+                                                         : (count + config.n_workers - 1) / config.n_workers;
+                size = std::min<std::size_t>(std::max<std::size_t>(1, size), std::numeric_limits<std::uint32_t>::max());
+                Call call = {points, fitness, plugin::context_of(app_config), (count + size - 1) / size};
+                std::vector<Request> requests(call.remaining);
+                std::unique_lock<std::mutex> lock(mutex);
+                for (std::size_t r = 0; r < requests.size(); r++) {
+                    requests[r] = {&call, r * size, std::min(size, count - r * size), 0};
+                    queue.push_back(&requests[r]);
+                }
+                if (live_workers == 0) {
+                    fail_queue();
+                }
+#ifndef _WIN32
+                else {
+                    wake_io();
+                }
+#endif
+                changed.wait(lock, [&call] { return call.remaining == 0; });
+            }
+
+            WorkerStats get_stats() {
+                std::lock_guard<std::mutex> lock(mutex);
+                return stats;
+            }
+
+            const WorkerPoolConfig& get_config() const {
+                return config;
+            }
+        };
+
+        /*
+         * Batch objective backed by a worker pool. Copies share the pool, and the last
+         * one to go stops the workers.
+         */
+        struct WorkerObjective {
+            std::shared_ptr<WorkerPool> pool;
+
+            void operator()(Points points, Span<double> fitness, AppConfig* config) const {
+                pool->evaluate(points, fitness, config);
+            }
+        };
+
+        // Starts a pool for config, or returns false with the reason in error.
+        inline bool open_objective(const WorkerPoolConfig& config, WorkerObjective* out, std::string* error) {
+            auto pool = std::make_shared<WorkerPool>();
+            if (!pool->start(config, error)) {
+                return false;
+            }
+            out->pool = std::move(pool);
+            return true;
+        }
+    }
+}
+#endif //WORKER_POOL_H
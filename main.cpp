@@ -11,15 +11,9 @@
 #include <string>
 #include <cmath>
 #include "pso.cpp"
-
-/*
- * Fitness function, the lower the better
- * hence why we use the euclidean distance
- */
-double fitness_function(double x, double y, algos::AppConfig* config) {
-    return std::sqrt(std::pow(x - config->goal_x, 2) + std::pow(y - config->goal_y, 2));
-}
-
+#include "objectives.h"
+#include "plugin.h"
+#include "worker_pool.h"
 
 // Main code
 int main(int, char**)
@@ -93,8 +87,15 @@ int main(int, char**)
     /*algos::pso::PSOConfig config = algos::pso::PSOConfig();
     optimiser = algos::PSO(fitness_function, config); */
     char filename[1024] = "cycles.csv";
+    char plugin_filename[1024] = "libpso_sample_plugin.so";
+    std::string plugin_error;
+    char worker_command[1024] = "./pso_sample_worker";
+    int n_workers = 4;
+    std::string worker_error;
+    algos::ProfilerWindow profiler_window;
 
     bool do_pso = false;
+    bool fast_forward = false;
 
     bool done = false;
     while (!done)
@@ -145,10 +146,45 @@ int main(int, char**)
             if (ImGui::CollapsingHeader("Particle Swarm Optimisation (PSO)")) {
                 ImGui::TextWrapped("%s", "Particle Swarm Optimisation (PSO) is a computational method that optimizes a problem by iteratively trying to improve a candidate solution with regard to a given measure of quality. It solves problems by having a population of candidate solutions, here dubbed particles, and moving these particles around in the search-space according to simple mathematical formulae over the particle's position and velocity. Each particle's movement is influenced by its local best known position, but is also guided toward the best known positions in the search-space, which are updated as better positions are found by other particles. This is expected to move the swarm toward the best solutions.");
                 if (ImGui::Button("Select PSO")) {
-                    optimiser = new algos::PSO(fitness_function, algos::pso::PSOConfig());
+                    optimiser = new algos::BasicPSOGui<algos::objectives::Euclidean>(algos::objectives::Euclidean(),
+                                                                                      algos::pso::PSOConfig());
                     chosen_optimiser = true;
                 }
             }
+            if (ImGui::CollapsingHeader("PSO with a Plugin Objective")) {
+                ImGui::TextWrapped("%s", "PSO over an objective loaded from a shared library built against include/pso_plugin.h, such as the pso_sample_plugin target. Rebuild the library while running and Reset picks up the new version.");
+                ImGui::InputText("Plugin", plugin_filename, 1024);
+                if (ImGui::Button("Select Plugin PSO")) {
+                    algos::plugin::PluginObjective objective;
+                    if (algos::plugin::open_objective(plugin_filename, &objective, &plugin_error)) {
+                        optimiser = new algos::BasicPSOGui<algos::plugin::PluginObjective>(objective,
+                                                                                            algos::pso::PSOConfig());
+                        chosen_optimiser = true;
+                    }
+                }
+                if (!chosen_optimiser && !plugin_error.empty()) {
+                    ImGui::TextWrapped("%s", plugin_error.c_str());
+                }
+            }
+            if (ImGui::CollapsingHeader("PSO with Worker Processes")) {
+                ImGui::TextWrapped("%s", "PSO over an objective evaluated in separate processes speaking the protocol in include/pso_worker.h, such as the pso_sample_worker target. A worker that crashes or hangs is restarted and its batch sent again.");
+                ImGui::InputText("Command", worker_command, 1024);
+                ImGui::InputInt("Workers", &n_workers);
+                if (ImGui::Button("Select Worker PSO")) {
+                    algos::workers::WorkerPoolConfig worker_config;
+                    worker_config.command = algos::workers::split_command(worker_command);
+                    worker_config.n_workers = std::max(1, n_workers);
+                    algos::workers::WorkerObjective objective;
+                    if (algos::workers::open_objective(worker_config, &objective, &worker_error)) {
+                        optimiser = new algos::BasicPSOGui<algos::workers::WorkerObjective>(objective,
+                                                                                             algos::pso::PSOConfig());
+                        chosen_optimiser = true;
+                    }
+                }
+                if (!chosen_optimiser && !worker_error.empty()) {
+                    ImGui::TextWrapped("%s", worker_error.c_str());
+                }
+            }
             ImGui::End();
         }
         else {
@@ -169,6 +205,8 @@ int main(int, char**)
             if (ImGui::Button("Reset")) {
                 optimiser->reset();
             }
+            ImGui::SameLine();
+            ImGui::Checkbox("Fast Forward", &fast_forward);
 
             ImGui::SameLine();
             // Backward arrow
@@ -197,6 +235,11 @@ int main(int, char**)
             optimiser->display_config_window();
             ImGui::End();
 
+            ImGui::Begin("Profiler");
+            profiler_window.display();
+            ImGui::End();
+
+            optimiser->set_running(do_pso, fast_forward);
             if ( do_pso && optimiser->should_step()) {
                 optimiser->forward_step();
                     }
@@ -249,6 +292,7 @@ int main(int, char**)
     }
 
     // Cleanup
+    delete optimiser;
     ImGui_ImplOpenGL2_Shutdown();
     ImGui_ImplSDL2_Shutdown();
     ImPlot::DestroyContext();
@@ -0,0 +1,38 @@
+/*
+ * Sample objective plugin: Rastrigin shifted so its global minimum, 0, sits at the
+ * goal (goal_x, goal_y, then the origin in any further dimensions). Build it with
+ * the pso_sample_plugin target and open the library from the optimiser picker or
+ * with pso_headless --plugin.
+ */
+#include <math.h>
+
+#include "pso_plugin.h"
+
+static void evaluate(const double* positions, size_t stride, size_t count, int dimensions, double* fitness,
+                     const PsoPluginContext* context) {
+    const double two_pi = 6.28318530717958647692;
+    size_t i;
+    int d;
+    for (i = 0; i < count; i++) {
+        fitness[i] = 10.0 * dimensions;
+    }
+    for (d = 0; d < dimensions; d++) {
+        const double* x = positions + d * stride;
+        double goal = d == 0 ? context->goal_x : d == 1 ? context->goal_y : 0.0;
+        for (i = 0; i < count; i++) {
+            double offset = x[i] - goal;
+            fitness[i] += offset * offset - 10.0 * cos(two_pi * offset);
+        }
+    }
+}
+
+static const PsoObjectivePlugin PLUGIN = {
+        PSO_PLUGIN_ABI_VERSION,
+        sizeof(PsoObjectivePlugin),
+        "Shifted Rastrigin (sample plugin)",
+        evaluate,
+};
+
+PSO_PLUGIN_EXPORT const PsoObjectivePlugin* pso_objective_plugin(void) {
+    return &PLUGIN;
+}
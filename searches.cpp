@@ -17,5 +17,6 @@ namespace algos {
     AppConfig Optimiser::get_config() { return AppConfig(); }
     void Optimiser::plot() {};
     bool Optimiser::should_step() {return false;};
+    void Optimiser::set_running(bool, bool) {}
 
 } // namespace algos
@@ -0,0 +1,150 @@
+//
+// Checks that stepping settles into reusing its buffers: once warmed up, stepping
+// without history, stepping back and forth through history and taking snapshots
+// make no heap allocations. Every operator new in the program is counted.
+//
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <string>
+
+#include "pso.h"
+#include "objectives.h"
+
+static std::atomic<std::uint64_t> heap_allocations{0};
+
+// GCC takes free() in a replaced operator delete for a mismatch once it is inlined.
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+
+void* operator new(std::size_t size) {
+    heap_allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = std::malloc(size > 0 ? size : 1)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void* operator new(std::size_t size, std::align_val_t alignment) {
+    heap_allocations.fetch_add(1, std::memory_order_relaxed);
+    std::size_t align = std::max(sizeof(void*), (std::size_t) alignment);
+#ifdef _WIN32
+    void* p = _aligned_malloc(size > 0 ? size : 1, align);
+#else
+    void* p = nullptr;
+    if (posix_memalign(&p, align, size > 0 ? size : 1) != 0) {
+        p = nullptr;
+    }
+#endif
+    if (p != nullptr) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept {
+    std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept {
+    std::free(p);
+}
+
+void operator delete(void* p, std::align_val_t) noexcept {
+#ifdef _WIN32
+    _aligned_free(p);
+#else
+    std::free(p);
+#endif
+}
+
+void operator delete(void* p, std::size_t, std::align_val_t alignment) noexcept {
+    operator delete(p, alignment);
+}
+
+using namespace algos;
+
+static int failures = 0;
+
+static void expect_none(const std::string& name, std::uint64_t allocations) {
+    printf("%-56s %s (%llu allocations)\n", name.c_str(), allocations == 0 ? "ok" : "FAIL",
+           (unsigned long long) allocations);
+    failures += allocations == 0 ? 0 : 1;
+}
+
+static pso::PSOConfig base_config(neighbourhood::Topology topology, int n_threads, bool keep_history) {
+    pso::PSOConfig config;
+    config.n_particles = 1000;
+    config.dimensions = 5;
+    config.max_iterations = 1000;
+    config.seed = 12345;
+    config.topology = topology;
+    config.n_threads = n_threads;
+    config.keep_history = keep_history;
+    // Nothing may stop the run early and leave the counted steps doing nothing.
+    config.stopping.stagnation_iterations = 0;
+    return config;
+}
+
+static void step_forward(Optimiser& optimiser, int steps) {
+    for (int i = 0; i < steps; i++) {
+        optimiser.forward_step();
+    }
+}
+
+static void step_back(Optimiser& optimiser, int steps) {
+    for (int i = 0; i < steps; i++) {
+        optimiser.backward_step();
+    }
+}
+
+static void check(neighbourhood::Topology topology, int n_threads) {
+    std::string name = std::string(neighbourhood::topology_name(topology)) + ", " + std::to_string(n_threads) +
+                       " thread(s)";
+    {
+        BasicPSO<objectives::Euclidean> pso(objectives::Euclidean(), base_config(topology, n_threads, false));
+        step_forward(pso, 20);
+        std::uint64_t before = heap_allocations.load();
+        step_forward(pso, 50);
+        expect_none("forward without history, " + name, heap_allocations.load() - before);
+    }
+    {
+        BasicPSO<objectives::Euclidean> pso(objectives::Euclidean(), base_config(topology, n_threads, true));
+        step_forward(pso, 60);
+        // The first pass back and forth sizes the buffers the next passes reuse.
+        step_back(pso, 30);
+        step_forward(pso, 30);
+        std::uint64_t before = heap_allocations.load();
+        for (int pass = 0; pass < 3; pass++) {
+            step_back(pso, 30);
+            step_forward(pso, 30);
+        }
+        expect_none("back and forth through history, " + name, heap_allocations.load() - before);
+
+        pso::Snapshot snapshot;
+        pso.fill_snapshot(&snapshot, 0, 1);
+        before = heap_allocations.load();
+        for (int i = 0; i < 10; i++) {
+            step_back(pso, 1);
+            pso.fill_snapshot(&snapshot, 0, 1);
+        }
+        expect_none("snapshots, " + name, heap_allocations.load() - before);
+    }
+}
+
+int main() {
+    for (neighbourhood::Topology topology : {neighbourhood::TOPOLOGY_GLOBAL, neighbourhood::TOPOLOGY_NEAREST}) {
+        for (int n_threads : {1, 3}) {
+            check(topology, n_threads);
+        }
+    }
+    if (failures > 0) {
+        printf("%d check(s) failed\n", failures);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,169 @@
+//
+// Checks the runs that are promised to be reproducible are, bit for bit: the
+// synchronous update for any thread count and topology, and resuming a checkpoint
+// in either update mode, and that a checkpoint whose header was damaged is refused
+// rather than sized from. Returns non-zero if any check fails.
+//
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <string>
+
+#include "async_pso.h"
+#include "objectives.h"
+
+using namespace algos;
+
+static int failures = 0;
+
+static bool same_bits(const void* a, const void* b, std::size_t size) {
+    return std::memcmp(a, b, size) == 0;
+}
+
+// Compares the current iteration of two runs, swarm, global best and stop reason included.
+template<typename A, typename B>
+static void expect_same(const char* name, const A& a, const B& b) {
+    pso::StoredCycle x, y;
+    a.get_stored_cycle(a.get_stored_cycle_count() - 1, &x);
+    b.get_stored_cycle(b.get_stored_cycle_count() - 1, &y);
+    pso::PSOConfig ca = a.get_pso_config(), cb = b.get_pso_config();
+    bool same = x.iterations == y.iterations && x.swarm.size() == y.swarm.size() &&
+                x.swarm.dimensions == y.swarm.dimensions && x.swarm.stride == y.swarm.stride &&
+                same_bits(x.swarm.position.data(), y.swarm.position.data(), x.swarm.position.size() * sizeof(double)) &&
+                same_bits(x.swarm.best_position.data(), y.swarm.best_position.data(),
+                          x.swarm.best_position.size() * sizeof(double)) &&
+                same_bits(x.swarm.best_fitness.data(), y.swarm.best_fitness.data(),
+                          x.swarm.best_fitness.size() * sizeof(double)) &&
+                same_bits(&ca.global_best_fitness, &cb.global_best_fitness, sizeof(double)) &&
+                ca.global_best_position.size() == cb.global_best_position.size() &&
+                same_bits(ca.global_best_position.data(), cb.global_best_position.data(),
+                          ca.global_best_position.size() * sizeof(double)) &&
+                a.get_stop_reason() == b.get_stop_reason();
+    printf("%-48s %s (iteration %d, best %.17g)\n", name, same ? "ok" : "FAIL", x.iterations, ca.global_best_fitness);
+    failures += same ? 0 : 1;
+}
+
+static pso::PSOConfig base_config() {
+    pso::PSOConfig config;
+    config.n_particles = 1500;
+    config.dimensions = 5;
+    config.max_iterations = 60;
+    config.seed = 12345;
+    config.keep_history = false;
+    return config;
+}
+
+static void run(Optimiser& optimiser, int iterations) {
+    for (int i = 0; i < iterations; i++) {
+        optimiser.forward_step();
+    }
+}
+
+static void thread_counts() {
+    const char* names[] = {"global", "ring", "von-neumann", "nearest"};
+    for (int topology = neighbourhood::TOPOLOGY_GLOBAL; topology <= neighbourhood::TOPOLOGY_NEAREST; topology++) {
+        pso::PSOConfig config = base_config();
+        config.topology = (neighbourhood::Topology) topology;
+        config.n_threads = 1;
+        BasicPSO<objectives::Euclidean> single(objectives::Euclidean(), config);
+        config.n_threads = 4;
+        BasicPSO<objectives::Euclidean> threaded(objectives::Euclidean(), config);
+        run(single, config.max_iterations);
+        run(threaded, config.max_iterations);
+        std::string name = std::string("1 vs 4 threads, ") + names[topology];
+        expect_same(name.c_str(), single, threaded);
+    }
+}
+
+// Steps straight through, and separately steps half way, checkpoints and resumes in a new instance.
+template<typename P>
+static void resume(const char* name, pso::PSOConfig config) {
+    std::string file = (std::filesystem::temp_directory_path() / "pso_determinism_test.psoc").string();
+    P straight(objectives::Euclidean(), config);
+    run(straight, config.max_iterations);
+
+    P first(objectives::Euclidean(), config);
+    run(first, config.max_iterations / 2);
+    if (!first.save_checkpoint(file)) {
+        printf("%-48s FAIL (could not write %s)\n", name, file.c_str());
+        failures++;
+        return;
+    }
+    pso::PSOConfig other = base_config();
+    other.seed = 999;
+    P resumed(objectives::Euclidean(), other);
+    resumed.load_checkpoint(file);
+    std::filesystem::remove(file);
+    run(resumed, config.max_iterations);
+    expect_same(name, straight, resumed);
+}
+
+static void checkpoints() {
+    pso::PSOConfig config = base_config();
+    resume<BasicPSO<objectives::Euclidean>>("checkpoint resume, sync", config);
+
+    config.topology = neighbourhood::TOPOLOGY_NEAREST;
+    config.n_threads = 3;
+    resume<BasicPSO<objectives::Euclidean>>("checkpoint resume, sync nearest 3 threads", config);
+
+    config = base_config();
+    config.max_iterations = 400;
+    config.stopping.stagnation_iterations = 5;
+    resume<BasicPSO<objectives::Euclidean>>("checkpoint resume, sync stagnation stop", config);
+
+    // Only a single worker fixes the order of asynchronous updates.
+    config = base_config();
+    resume<BasicAsyncPSO<objectives::Euclidean>>("checkpoint resume, async", config);
+}
+
+// Each count in the header in turn set to 0x7fffffff, far more than the file holds.
+static void corrupt_headers() {
+    std::string file = (std::filesystem::temp_directory_path() / "pso_determinism_test.psoc").string();
+    BasicPSO<objectives::Euclidean> pso(objectives::Euclidean(), base_config());
+    run(pso, 5);
+    if (!pso.save_checkpoint(file)) {
+        printf("%-48s FAIL (could not write %s)\n", "corrupt checkpoint header", file.c_str());
+        failures++;
+        return;
+    }
+    std::string bytes;
+    {
+        std::ifstream in(file, std::ios::binary);
+        bytes.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    }
+    const char* fields[] = {"n_particles", "dimensions", "config_size", "n_updates", "n_migrants"};
+    const std::size_t offsets[] = {offsetof(checkpoint::FileHeader, n_particles),
+                                   offsetof(checkpoint::FileHeader, dimensions),
+                                   offsetof(checkpoint::FileHeader, config_size) + 4,
+                                   offsetof(checkpoint::FileHeader, n_updates),
+                                   offsetof(checkpoint::FileHeader, n_migrants)};
+    for (int f = 0; f < 5; f++) {
+        std::string damaged = bytes;
+        const unsigned char huge[4] = {0xff, 0xff, 0xff, 0x7f};
+        std::memcpy(&damaged[offsets[f]], huge, sizeof(huge));
+        {
+            std::ofstream out(file, std::ios::binary | std::ios::trunc);
+            out.write(damaged.data(), (std::streamsize) damaged.size());
+        }
+        checkpoint::State state;
+        bool refused = !checkpoint::read(file, &state);
+        std::string name = std::string("corrupt checkpoint header, ") + fields[f];
+        printf("%-48s %s\n", name.c_str(), refused ? "ok" : "FAIL");
+        failures += refused ? 0 : 1;
+    }
+    std::filesystem::remove(file);
+}
+
+int main() {
+    thread_counts();
+    checkpoints();
+    corrupt_headers();
+    if (failures > 0) {
+        printf("%d check(s) failed\n", failures);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,115 @@
+//
+// Checks the k-d tree behind the nearest topology: in one and two dimensions its
+// searches match a brute-force search exactly, and in 10 and 30 dimensions a step's
+// neighbourhood pass grows about linearly with the swarm. Returns non-zero if any
+// check fails.
+//
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "neighbourhood.h"
+
+using namespace algos;
+
+static int failures = 0;
+
+static void expect(const std::string& name, bool ok, const std::string& detail) {
+    printf("%-40s %s (%s)\n", name.c_str(), ok ? "ok" : "FAIL", detail.c_str());
+    failures += ok ? 0 : 1;
+}
+
+static pso::Swarm random_swarm(int n, int dimensions, unsigned seed) {
+    pso::Swarm swarm;
+    swarm.resize(n, dimensions);
+    std::mt19937_64 random(seed);
+    std::uniform_real_distribution<double> uniform(-64.0, 64.0);
+    for (int d = 0; d < dimensions; d++) {
+        for (int i = 0; i < n; i++) {
+            swarm.column(d)[i] = uniform(random);
+            swarm.best_column(d)[i] = swarm.column(d)[i];
+        }
+    }
+    for (int i = 0; i < n; i++) {
+        swarm.best_fitness[i] = uniform(random);
+    }
+    return swarm;
+}
+
+// Every query against a sort of all distances, ties in particle order.
+static void exact(int n, int dimensions, int k) {
+    pso::Swarm swarm = random_swarm(n, dimensions, 7);
+    neighbourhood::KdTree tree;
+    tree.build(swarm, nullptr);
+    std::vector<int> found(k);
+    std::vector<double> distances(k);
+    std::vector<neighbourhood::KdTree::Branch> queue;
+    std::vector<std::pair<double, int>> all(n);
+    int mismatches = 0;
+    for (int slot = 0; slot < n; slot++) {
+        int count = tree.nearest(slot, k, found.data(), distances.data(), &queue);
+        int i = tree.particle(slot);
+        for (int j = 0; j < n; j++) {
+            double distance = 0;
+            for (int d = 0; d < dimensions; d++) {
+                double delta = swarm.column(d)[j] - swarm.column(d)[i];
+                distance += delta * delta;
+            }
+            all[j] = {distance, j};
+        }
+        std::partial_sort(all.begin(), all.begin() + k, all.end());
+        bool same = count == k;
+        for (int f = 0; same && f < k; f++) {
+            same = tree.particle(found[f]) == all[f].second;
+        }
+        mismatches += same ? 0 : 1;
+    }
+    expect("exact, " + std::to_string(dimensions) + " dimensions", mismatches == 0,
+           std::to_string(mismatches) + " of " + std::to_string(n) + " queries differ");
+}
+
+// Fastest of a few neighbourhood passes, tree build included, on the calling thread.
+static double pass_seconds(int n, int dimensions, int k) {
+    pso::Swarm swarm = random_swarm(n, dimensions, 11);
+    neighbourhood::Neighbourhoods neighbourhoods;
+    pso::AlignedVector<double> social;
+    double fastest = 0;
+    for (int repeat = 0; repeat < 3; repeat++) {
+        auto start = std::chrono::steady_clock::now();
+        neighbourhoods.compute(swarm, neighbourhood::TOPOLOGY_NEAREST, k, &social, nullptr);
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        fastest = repeat == 0 ? seconds : std::min(fastest, seconds);
+    }
+    return fastest;
+}
+
+/*
+ * Four times the particles should cost about four times as long, a little more for
+ * the tree's depth. Eight leaves room for a noisy machine and still fails a pass
+ * that is quadratic, which would take sixteen.
+ */
+static void scaling(int dimensions) {
+    const int n = 5000, k = 8;
+    double small = pass_seconds(n, dimensions, k);
+    double large = pass_seconds(4 * n, dimensions, k);
+    char detail[128];
+    snprintf(detail, sizeof(detail), "%d particles %.1f ms, %d particles %.1f ms, x%.1f", n, small * 1e3, 4 * n,
+             large * 1e3, large / small);
+    expect("scaling, " + std::to_string(dimensions) + " dimensions", large < 8.0 * small, detail);
+}
+
+int main() {
+    exact(3000, 1, 8);
+    exact(3000, 2, 8);
+    scaling(10);
+    scaling(30);
+    if (failures > 0) {
+        printf("%d check(s) failed\n", failures);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,114 @@
+//
+// Loads the sample plugin built in-tree, given as the only argument, and checks its
+// batch evaluate against a reference shifted Rastrigin and that reload() picks up a
+// changed file and only a changed one. Returns non-zero if any check fails.
+//
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include "plugin.h"
+
+using namespace algos;
+
+static int failures = 0;
+
+static void expect(const std::string& name, bool ok) {
+    printf("%-48s %s\n", name.c_str(), ok ? "ok" : "FAIL");
+    failures += ok ? 0 : 1;
+}
+
+// Rastrigin with its minimum at the goal in the first two coordinates and the origin in the rest.
+static double reference(const std::vector<double>& point, const AppConfig& config) {
+    const double two_pi = 6.28318530717958647692;
+    double fitness = 10.0 * point.size();
+    for (std::size_t d = 0; d < point.size(); d++) {
+        double goal = d == 0 ? config.goal_x : d == 1 ? config.goal_y : 0.0;
+        double offset = point[d] - goal;
+        fitness += offset * offset - 10.0 * std::cos(two_pi * offset);
+    }
+    return fitness;
+}
+
+static void evaluate(const plugin::PluginObjective& objective, const std::string& name) {
+    AppConfig config;
+    config.goal_x = 3.5;
+    config.goal_y = -12.25;
+    for (int dimensions : {1, 2, 3, 10}) {
+        // A stride wider than the batch checks the plugin walks columns by stride, not count.
+        const std::size_t count = 7, stride = 9;
+        std::vector<double> positions(stride * dimensions, 1e300);
+        for (std::size_t i = 0; i < count; i++) {
+            for (int d = 0; d < dimensions; d++) {
+                positions[d * stride + i] = -20.0 + 5.3 * i + 1.7 * d;
+            }
+        }
+        // The goal itself is the minimum, 0.
+        positions[0] = config.goal_x;
+        if (dimensions > 1) {
+            positions[stride] = config.goal_y;
+        }
+        for (int d = 2; d < dimensions; d++) {
+            positions[d * stride] = 0.0;
+        }
+
+        std::vector<double> fitness(count, -1.0);
+        objective(Points(positions.data(), stride, count, dimensions), Span<double>(fitness.data(), count), &config);
+        bool ok = fitness[0] == 0.0;
+        for (std::size_t i = 0; i < count; i++) {
+            std::vector<double> point(dimensions);
+            for (int d = 0; d < dimensions; d++) {
+                point[d] = positions[d * stride + i];
+            }
+            double expected = reference(point, config);
+            ok = ok && std::fabs(fitness[i] - expected) <= 1e-12 * std::max(1.0, std::fabs(expected));
+        }
+        expect(name + ", " + std::to_string(dimensions) + " dimension(s)", ok);
+    }
+}
+
+// Works on a copy, so bumping its time leaves the build's own file alone.
+static void reload(const std::string& built) {
+    std::filesystem::path copy = std::filesystem::temp_directory_path() /
+                                 ("pso_plugin_test_" + std::filesystem::path(built).filename().string());
+    std::error_code ec;
+    std::filesystem::copy_file(built, copy, std::filesystem::copy_options::overwrite_existing, ec);
+    plugin::PluginObjective objective;
+    std::string error;
+    if (ec || !plugin::open_objective(copy.string(), &objective, &error)) {
+        expect("reload, could not open " + copy.string() + " " + error, false);
+        std::filesystem::remove(copy, ec);
+        return;
+    }
+    expect("reload, unchanged file", !objective.reload());
+    std::filesystem::last_write_time(copy, std::filesystem::last_write_time(copy) + std::chrono::seconds(2), ec);
+    expect("reload, touched file", !ec && objective.reload());
+    expect("reload, unchanged again", !objective.reload());
+    evaluate(objective, "evaluate after reload");
+    std::filesystem::remove(copy, ec);
+}
+
+int main(int argc, char** argv) {
+    if (argc != 2) {
+        printf("Usage: %s <sample plugin library>\n", argv[0]);
+        return 2;
+    }
+    plugin::PluginObjective objective;
+    std::string error;
+    if (!plugin::open_objective(argv[1], &objective, &error)) {
+        printf("Error loading plugin %s: %s\n", argv[1], error.c_str());
+        return 1;
+    }
+    expect("name", objective.plugin->name() == "Shifted Rastrigin (sample plugin)");
+    evaluate(objective, "evaluate");
+    reload(argv[1]);
+    if (failures > 0) {
+        printf("%d check(s) failed\n", failures);
+        return 1;
+    }
+    return 0;
+}
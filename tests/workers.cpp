@@ -0,0 +1,119 @@
+//
+// Runs the worker pool against the bundled sample worker, given as the only
+// argument: a normal run must match the sample objective evaluated in-process bit
+// for bit, workers that crash must be restarted without losing points, and workers
+// that hang must be timed out. Returns non-zero if any check fails.
+//
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "worker_pool.h"
+
+extern "C" {
+// From plugins/sample_objective.c, linked in as the worker links it.
+const PsoObjectivePlugin* pso_objective_plugin(void);
+}
+
+using namespace algos;
+
+static int failures = 0;
+
+static void expect(const std::string& name, bool ok, const std::string& detail) {
+    printf("%-48s %s (%s)\n", name.c_str(), ok ? "ok" : "FAIL", detail.c_str());
+    failures += ok ? 0 : 1;
+}
+
+struct Batch {
+    static constexpr int N = 600;
+    static constexpr int DIMENSIONS = 5;
+    std::vector<double> positions;
+    std::vector<double> expected;
+    AppConfig config;
+
+    Batch() : positions((std::size_t) N * DIMENSIONS), expected(N) {
+        config.goal_x = 7.25;
+        config.goal_y = -3.5;
+        std::uint64_t state = 12345;
+        for (double& x : positions) {
+            state = state * 6364136223846793005ull + 1442695040888963407ull;
+            x = (double) (state >> 11) / (double) (1ull << 53) * 128.0 - 64.0;
+        }
+        PsoPluginContext context = plugin::context_of(&config);
+        pso_objective_plugin()->evaluate(positions.data(), N, N, DIMENSIONS, expected.data(), &context);
+    }
+
+    // Evaluates the batch on the pool several times over, true if every answer matched in-process bit for bit.
+    bool run(workers::WorkerPool& pool, int repeats) {
+        std::vector<double> fitness(N);
+        bool same = true;
+        for (int r = 0; r < repeats; r++) {
+            std::fill(fitness.begin(), fitness.end(), -1.0);
+            pool.evaluate(Points(positions.data(), N, N, DIMENSIONS), Span<double>(fitness.data(), N), &config);
+            same = same && std::memcmp(fitness.data(), expected.data(), N * sizeof(double)) == 0;
+        }
+        return same;
+    }
+};
+
+static std::string describe(const workers::WorkerStats& stats, double seconds) {
+    char text[160];
+    snprintf(text, sizeof(text), "%llu requests, %llu restarts, %llu timeouts, %llu failed points, %.2f s",
+             (unsigned long long) stats.requests, (unsigned long long) stats.restarts,
+             (unsigned long long) stats.timeouts, (unsigned long long) stats.failed_points, seconds);
+    return text;
+}
+
+static void check(const std::string& name, workers::WorkerPoolConfig config,
+                  bool (*passes)(const workers::WorkerStats& stats, bool same)) {
+    Batch batch;
+    workers::WorkerPool pool;
+    std::string error;
+    if (!pool.start(config, &error)) {
+        expect(name, false, "could not start workers: " + error);
+        return;
+    }
+    auto start = std::chrono::steady_clock::now();
+    bool same = batch.run(pool, 4);
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    workers::WorkerStats stats = pool.get_stats();
+    expect(name, passes(stats, same), describe(stats, seconds) + (same ? "" : ", fitness differs"));
+}
+
+int main(int argc, char** argv) {
+    if (argc != 2) {
+        printf("Usage: %s <sample worker executable>\n", argv[0]);
+        return 2;
+    }
+    workers::WorkerPoolConfig config;
+    config.n_workers = 3;
+    config.batch_size = 50;
+
+    config.command = {argv[1]};
+    check("normal run matches in-process", config, [](const workers::WorkerStats& stats, bool same) {
+        return same && stats.restarts == 0 && stats.failed_points == 0;
+    });
+
+    // Each process aborts on its third request, so most requests outlive a worker or two.
+    config.command = {argv[1], "--crash-after", "3"};
+    config.max_attempts = 20;
+    check("crashed workers restarted, nothing lost", config, [](const workers::WorkerStats& stats, bool same) {
+        return same && stats.restarts > 0 && stats.retries > 0 && stats.failed_points == 0;
+    });
+
+    // Each process stops answering at its second request and has to be killed.
+    config.command = {argv[1], "--hang-after", "2"};
+    config.timeout_seconds = 0.5;
+    config.batch_size = 200;
+    check("hung workers timed out, evaluate returns", config, [](const workers::WorkerStats& stats, bool same) {
+        return stats.timeouts > 0 && (stats.failed_points > 0 || same);
+    });
+
+    if (failures > 0) {
+        printf("%d check(s) failed\n", failures);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,64 @@
+/*
+ * Sample objective worker: serves the sample plugin's shifted Rastrigin from a
+ * process of its own. Build it with the pso_sample_worker target and start a pool
+ * of them with pso_headless --workers 4 --worker-command ./pso_sample_worker.
+ *
+ * Options to try out the pool's recovery:
+ *   --delay-us <n>     Sleep n microseconds per request
+ *   --crash-after <n>  Abort while answering request n, counted per process
+ *   --hang-after <n>   Stop answering at request n, until the timeout kills it
+ */
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "pso_worker.h"
+
+/* From plugins/sample_objective.c, linked in rather than loaded. */
+const PsoObjectivePlugin* pso_objective_plugin(void);
+
+static long delay_us = 0;
+static long crash_after = 0;
+static long hang_after = 0;
+static long requests = 0;
+
+static void evaluate(const double* positions, size_t stride, size_t count, int dimensions, double* fitness,
+                     const PsoPluginContext* context) {
+    requests++;
+    if (crash_after > 0 && requests == crash_after) {
+        abort();
+    }
+    if (hang_after > 0 && requests == hang_after) {
+        while (1) {
+            pause();
+        }
+    }
+    if (delay_us > 0) {
+        struct timespec delay;
+        delay.tv_sec = delay_us / 1000000;
+        delay.tv_nsec = (delay_us % 1000000) * 1000;
+        nanosleep(&delay, NULL);
+    }
+    pso_objective_plugin()->evaluate(positions, stride, count, dimensions, fitness, context);
+}
+
+int main(int argc, char** argv) {
+    int i;
+    for (i = 1; i < argc; i++) {
+        int has_value = i + 1 < argc;
+        if (strcmp(argv[i], "--delay-us") == 0 && has_value) {
+            delay_us = atol(argv[++i]);
+        } else if (strcmp(argv[i], "--crash-after") == 0 && has_value) {
+            crash_after = atol(argv[++i]);
+        } else if (strcmp(argv[i], "--hang-after") == 0 && has_value) {
+            hang_after = atol(argv[++i]);
+        } else {
+            fprintf(stderr, "Unknown or incomplete option: %s\n", argv[i]);
+            return 1;
+        }
+    }
+    return pso_worker_serve(evaluate);
+}